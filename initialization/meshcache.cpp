@@ -0,0 +1,335 @@
+#include "meshcache.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <cstring>
+#include <utility>
+
+// Increment whenever the layout of the file or the way meshes are constructed
+// changes, so that stale caches are rebuilt.
+#define MESH_CACHE_VERSION 2
+#define MESH_CACHE_MAGIC 0x48534d43  // "CMSH"
+#define MESH_CACHE_BYTE_ORDER 0x01020304
+#define MESH_CACHE_SUFFIX ".meshcache"
+
+/**
+ * @brief The header at the start of every cache file. The arrays follow
+ * directly after it, in this order: vertex x, y and z coordinates (one array
+ * each, matching the layout of VertexPositions), vertex valences, vertex out
+ * half-edges, half-edge origins, half-edge nexts, half-edge twins, half-edge
+ * faces, half-edge edge indices, face sides and face valences. All indices are
+ * 32-bit and -1 encodes a missing twin.
+ */
+struct MeshCacheHeader {
+  quint32 magic;
+  quint32 byteOrder;
+  quint32 version;
+  qint32 numVertices;
+  qint32 numHalfEdges;
+  qint32 numFaces;
+  qint32 numEdges;
+  qint32 reserved;
+  qint64 sourceSize;
+  qint64 sourceModified;
+  quint64 checksum;
+};
+
+/**
+ * @brief payloadSize Calculates the number of bytes following the header.
+ * @param header The header of the cache file.
+ * @return The size of the arrays in bytes.
+ */
+static qint64 payloadSize(const MeshCacheHeader& header) {
+    return 4 * (5 * qint64(header.numVertices) +
+                5 * qint64(header.numHalfEdges) + 2 * qint64(header.numFaces));
+}
+
+/**
+ * @brief The Checksum struct computes a 64-bit checksum over a sequence of
+ * 32-bit words. It is a word-wise variant of FNV-1a, which is fast enough to
+ * not noticeably slow down loading.
+ */
+struct Checksum {
+  quint64 state = 14695981039346656037ULL;
+
+  void add(const void* data, qint64 numBytes) {
+    const uchar* bytes = static_cast<const uchar*>(data);
+    for (qint64 i = 0; i < numBytes; i += 4) {
+      quint32 word;
+      memcpy(&word, bytes + i, 4);
+      state = (state ^ word) * 1099511628211ULL;
+    }
+  }
+};
+
+/**
+ * @brief sourceStamp Retrieves the size and modification time of the source
+ * file. Qt resources do not have a modification time, so the modification time
+ * of the application is used for them instead.
+ * @param sourceFile Path of the model file.
+ * @param size Is set to the size of the source file.
+ * @param modified Is set to the modification time in milliseconds.
+ */
+static void sourceStamp(const QString& sourceFile, qint64& size,
+                        qint64& modified) {
+    QFileInfo sourceInfo(sourceFile);
+    size = sourceInfo.size();
+    if (sourceFile.startsWith(":")) {
+        QFileInfo appInfo(QCoreApplication::applicationFilePath());
+        modified = appInfo.lastModified().toMSecsSinceEpoch();
+    } else {
+        modified = sourceInfo.lastModified().toMSecsSinceEpoch();
+    }
+}
+
+/**
+ * @brief MeshCache::cachePath Determines where the cache of a model is stored.
+ * This is next to the model itself, or in the cache directory of the
+ * application for models compiled into the resources.
+ * @param sourceFile Path of the model file.
+ * @return Path of the cache file.
+ */
+QString MeshCache::cachePath(const QString& sourceFile) {
+    if (sourceFile.startsWith(":")) {
+        QString cacheDir =
+            QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+        QDir().mkpath(cacheDir);
+        QString name = QFileInfo(sourceFile).fileName();
+        return QDir(cacheDir).filePath(name + MESH_CACHE_SUFFIX);
+    }
+    return sourceFile + MESH_CACHE_SUFFIX;
+}
+
+/**
+ * @brief MeshCache::load Loads the cached mesh of a model. The cache file is
+ * memory-mapped and only used when its checksum is valid and the model has not
+ * changed since the cache was written.
+ * @param sourceFile Path of the model file.
+ * @param mesh The mesh to load into. Only modified on success.
+ * @return True if a valid cache was found and loaded; false otherwise.
+ */
+bool MeshCache::load(const QString& sourceFile, Mesh& mesh) {
+    QFile cacheFile(cachePath(sourceFile));
+    if (!cacheFile.open(QIODevice::ReadOnly) ||
+        cacheFile.size() < qint64(sizeof(MeshCacheHeader))) {
+        return false;
+    }
+    QElapsedTimer timer;
+    timer.start();
+
+    const uchar* data = cacheFile.map(0, cacheFile.size());
+    if (data == nullptr) {
+        return false;
+    }
+    MeshCacheHeader header;
+    memcpy(&header, data, sizeof(MeshCacheHeader));
+
+    qint64 sourceSize;
+    qint64 sourceModified;
+    sourceStamp(sourceFile, sourceSize, sourceModified);
+    if (header.magic != MESH_CACHE_MAGIC ||
+        header.byteOrder != MESH_CACHE_BYTE_ORDER ||
+        header.version != MESH_CACHE_VERSION ||
+        header.sourceSize != sourceSize ||
+        header.sourceModified != sourceModified || header.numVertices < 0 ||
+        header.numHalfEdges < 0 || header.numFaces < 0 ||
+        header.numEdges < 0 ||
+        cacheFile.size() !=
+            qint64(sizeof(MeshCacheHeader)) + payloadSize(header)) {
+        return false;
+    }
+
+    const uchar* payload = data + sizeof(MeshCacheHeader);
+    Checksum checksum;
+    checksum.add(payload, payloadSize(header));
+    if (checksum.state != header.checksum) {
+        qDebug() << " * Ignoring corrupt mesh cache" << cacheFile.fileName();
+        return false;
+    }
+
+    int numVertices = header.numVertices;
+    int numHalfEdges = header.numHalfEdges;
+    int numFaces = header.numFaces;
+    const float* x = reinterpret_cast<const float*>(payload);
+    const float* y = x + numVertices;
+    const float* z = y + numVertices;
+    const qint32* valences = reinterpret_cast<const qint32*>(z + numVertices);
+    const qint32* outs = valences + numVertices;
+    const qint32* origins = outs + numVertices;
+    const qint32* nexts = origins + numHalfEdges;
+    const qint32* twins = nexts + numHalfEdges;
+    const qint32* faces = twins + numHalfEdges;
+    const qint32* edgeIndices = faces + numHalfEdges;
+    const qint32* sides = edgeIndices + numHalfEdges;
+    const qint32* faceValences = sides + numFaces;
+
+    // Validate all indices, so that a well-formed but inconsistent file cannot
+    // produce out-of-bounds accesses.
+    auto inRange = [](const qint32* indices, int count, int size,
+                      bool allowNone) {
+        for (int i = 0; i < count; i++) {
+            if (indices[i] >= size || indices[i] < (allowNone ? -1 : 0)) {
+                return false;
+            }
+        }
+        return true;
+    };
+    if (!inRange(outs, numVertices, numHalfEdges, true) ||
+        !inRange(origins, numHalfEdges, numVertices, false) ||
+        !inRange(nexts, numHalfEdges, numHalfEdges, false) ||
+        !inRange(twins, numHalfEdges, numHalfEdges, true) ||
+        !inRange(faces, numHalfEdges, numFaces, false) ||
+        !inRange(edgeIndices, numHalfEdges, header.numEdges, false) ||
+        !inRange(sides, numFaces, numHalfEdges, false)) {
+        return false;
+    }
+    // Valences are used as loop bounds, and the faces together must own
+    // exactly all half-edges
+    for (int v = 0; v < numVertices; v++) {
+        if (valences[v] < 0) {
+            return false;
+        }
+    }
+    qint64 numFaceHalfEdges = 0;
+    for (int f = 0; f < numFaces; f++) {
+        if (faceValences[f] < 3) {
+            return false;
+        }
+        numFaceHalfEdges += faceValences[f];
+    }
+    if (numFaceHalfEdges != numHalfEdges) {
+        return false;
+    }
+
+    Mesh newMesh;
+    newMesh.vertices.resize(numVertices);
+    newMesh.positions.resize(numVertices);
+    newMesh.halfEdges.resize(numHalfEdges);
+    newMesh.halfEdgeNexts.resize(numHalfEdges);
+    newMesh.halfEdgeFaces.resize(numHalfEdges);
+    newMesh.faces.resize(numFaces);
+    newMesh.edgeCount = header.numEdges;
+
+    memcpy(newMesh.positions.x(), x, sizeof(float) * numVertices);
+    memcpy(newMesh.positions.y(), y, sizeof(float) * numVertices);
+    memcpy(newMesh.positions.z(), z, sizeof(float) * numVertices);
+    memcpy(newMesh.halfEdgeNexts.data(), nexts, sizeof(qint32) * numHalfEdges);
+    memcpy(newMesh.halfEdgeFaces.data(), faces, sizeof(qint32) * numHalfEdges);
+    for (int v = 0; v < numVertices; v++) {
+        Vertex* vertex = &newMesh.vertices[v];
+        vertex->out = outs[v];
+        vertex->valence = valences[v];
+    }
+    for (int h = 0; h < numHalfEdges; h++) {
+        HalfEdge* halfEdge = &newMesh.halfEdges[h];
+        halfEdge->origin = origins[h];
+        halfEdge->twin = twins[h];
+        halfEdge->edgeIndex = edgeIndices[h];
+    }
+    for (int f = 0; f < numFaces; f++) {
+        Face* face = &newMesh.faces[f];
+        face->side = sides[f];
+        face->valence = faceValences[f];
+    }
+
+    mesh = std::move(newMesh);
+    qDebug() << ":: Loaded cached mesh" << cacheFile.fileName() << "in"
+             << timer.elapsed() << "ms";
+    return true;
+}
+
+/**
+ * @brief MeshCache::save Writes the mesh to the cache file of the provided
+ * model. Failing to write the cache is not an error; the model will simply be
+ * parsed again next time.
+ * @param sourceFile Path of the model file the mesh was constructed from.
+ * @param mesh The mesh to store.
+ * @return True if the cache was written; false otherwise.
+ */
+bool MeshCache::save(const QString& sourceFile, const Mesh& mesh) {
+    int numVertices = mesh.vertices.size();
+    int numHalfEdges = mesh.halfEdges.size();
+    int numFaces = mesh.numFaces();
+
+    QVector<qint32> valences(numVertices);
+    QVector<qint32> outs(numVertices);
+    for (int v = 0; v < numVertices; v++) {
+        const Vertex& vertex = mesh.vertices[v];
+        valences[v] = vertex.valence;
+        outs[v] = vertex.out;
+    }
+    QVector<qint32> origins(numHalfEdges);
+    QVector<qint32> nexts(numHalfEdges);
+    QVector<qint32> twins(numHalfEdges);
+    QVector<qint32> faces(numHalfEdges);
+    QVector<qint32> edgeIndices(numHalfEdges);
+    for (int h = 0; h < numHalfEdges; h++) {
+        origins[h] = mesh.originIdx(h);
+        nexts[h] = mesh.nextIdx(h);
+        twins[h] = mesh.twinIdx(h);
+        faces[h] = mesh.faceIdx(h);
+        edgeIndices[h] = mesh.edgeIdx(h);
+    }
+    QVector<qint32> sides(numFaces);
+    QVector<qint32> faceValences(numFaces);
+    for (int f = 0; f < numFaces; f++) {
+        sides[f] = mesh.sideIdx(f);
+        faceValences[f] = mesh.faceValence(f);
+    }
+
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(MeshCacheHeader));
+    header.magic = MESH_CACHE_MAGIC;
+    header.byteOrder = MESH_CACHE_BYTE_ORDER;
+    header.version = MESH_CACHE_VERSION;
+    header.numVertices = numVertices;
+    header.numHalfEdges = numHalfEdges;
+    header.numFaces = numFaces;
+    header.numEdges = mesh.edgeCount;
+    sourceStamp(sourceFile, header.sourceSize, header.sourceModified);
+
+    QVector<QPair<const void*, qint64>> arrays = {
+        {mesh.positions.x(), 4 * qint64(numVertices)},
+        {mesh.positions.y(), 4 * qint64(numVertices)},
+        {mesh.positions.z(), 4 * qint64(numVertices)},
+        {valences.constData(), 4 * qint64(numVertices)},
+        {outs.constData(), 4 * qint64(numVertices)},
+        {origins.constData(), 4 * qint64(numHalfEdges)},
+        {nexts.constData(), 4 * qint64(numHalfEdges)},
+        {twins.constData(), 4 * qint64(numHalfEdges)},
+        {faces.constData(), 4 * qint64(numHalfEdges)},
+        {edgeIndices.constData(), 4 * qint64(numHalfEdges)},
+        {sides.constData(), 4 * qint64(numFaces)},
+        {faceValences.constData(), 4 * qint64(numFaces)}};
+    Checksum checksum;
+    for (const QPair<const void*, qint64>& array : arrays) {
+        checksum.add(array.first, array.second);
+    }
+    header.checksum = checksum.state;
+
+    QSaveFile cacheFile(cachePath(sourceFile));
+    if (!cacheFile.open(QIODevice::WriteOnly)) {
+        qDebug() << " * Could not write mesh cache" << cacheFile.fileName();
+        return false;
+    }
+    bool written = cacheFile.write(reinterpret_cast<const char*>(&header),
+                                   sizeof(MeshCacheHeader)) ==
+                   qint64(sizeof(MeshCacheHeader));
+    for (const QPair<const void*, qint64>& array : arrays) {
+        written = written &&
+                  cacheFile.write(static_cast<const char*>(array.first),
+                                  array.second) == array.second;
+    }
+    if (!written) {
+        cacheFile.cancelWriting();
+        return false;
+    }
+    return cacheFile.commit();
+}
@@ -0,0 +1,20 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <QString>
+
+#include "../mesh/mesh.h"
+
+/**
+ * @brief The MeshCache class stores fully constructed half-edge meshes in a
+ * binary file next to the model they were loaded from. Loading a cached mesh
+ * skips parsing, normalization and twin matching altogether.
+ */
+class MeshCache {
+ public:
+  static QString cachePath(const QString& sourceFile);
+  static bool load(const QString& sourceFile, Mesh& mesh);
+  static bool save(const QString& sourceFile, const Mesh& mesh);
+};
+
+#endif  // MESH_CACHE_H
@@ -0,0 +1,258 @@
+#include "meshimporter.h"
+
+#include <QDebug>
+#include <QFileInfo>
+#include <utility>
+
+#include "meshcache.h"
+#include "meshinitializer.h"
+#include "objfile.h"
+#include "plyfile.h"
+
+/**
+ * @brief loadModel Parses a model file and constructs its half-edge mesh. The
+ * parsed file is released as soon as the half-edge mesh is built.
+ * @param fileName Path of the model file.
+ * @param mesh The mesh to construct.
+ * @param cancelled Set when the import has been cancelled.
+ * @param progress Function invoked when a new stage of the import starts.
+ * @return True if the mesh was constructed; false if the file could not be
+ * loaded or the import was cancelled.
+ */
+template <typename ModelFile>
+static bool loadModel(const QString& fileName, Mesh& mesh,
+                      const std::atomic<bool>& cancelled,
+                      const std::function<void(int, const QString&)>& progress) {
+    int numThreads = QThread::idealThreadCount();
+    ModelFile model(fileName, numThreads);
+    if (!model.loadedSuccessfully() || cancelled) {
+        return false;
+    }
+    progress(50, "Building half-edge mesh");
+    MeshInitializer meshInitializer(numThreads);
+    mesh = meshInitializer.constructHalfEdgeMesh(model);
+    return true;
+}
+
+/**
+ * @brief MeshImporter::MeshImporter Creates an importer that is not importing
+ * anything yet.
+ * @param parent Qt parent object.
+ */
+MeshImporter::MeshImporter(QObject* parent)
+    : QObject(parent), worker(nullptr), numJobs(0), reorderForLocality(false) {}
+
+/**
+ * @brief MeshImporter::~MeshImporter Cancels the current import and waits for
+ * the worker thread to stop.
+ */
+MeshImporter::~MeshImporter() {
+    cancel();
+    if (worker != nullptr) {
+        worker->wait();
+        delete worker;
+    }
+}
+
+/**
+ * @brief MeshImporter::import Starts importing the provided .obj or binary .ply
+ * file on a worker thread. Any import that is still running is cancelled, and
+ * the new import starts once its worker has stopped. Progress is reported
+ * through progressChanged, and finished is emitted once the mesh can be
+ * retrieved with takeMesh.
+ * @param fileName Path of the model file.
+ */
+void MeshImporter::import(const QString& fileName) {
+    cancel();
+
+    std::shared_ptr<ImportJob> job = std::make_shared<ImportJob>();
+    job->id = ++numJobs;
+    job->fileName = fileName;
+    job->reorder = reorderForLocality;
+    currentJob = job;
+    if (worker != nullptr) {
+        pendingJob = job;
+    } else {
+        start(job);
+    }
+}
+
+/**
+ * @brief MeshImporter::start Starts the worker thread of an import. Once the
+ * worker has stopped, the import that was waiting for it is started, if any.
+ * @param job The import to perform.
+ */
+void MeshImporter::start(const std::shared_ptr<ImportJob>& job) {
+    worker = QThread::create([this, job] {
+        int jobId = job->id;
+        // The worker thread only touches the importer through queued calls,
+        // which are dropped when the importer is destroyed.
+        bool success = run(*job, [this, jobId](int percentage,
+                                               const QString& stage) {
+            QMetaObject::invokeMethod(
+                this,
+                [this, jobId, percentage, stage] {
+                    reportProgress(jobId, percentage, stage);
+                },
+                Qt::QueuedConnection);
+        });
+        QMetaObject::invokeMethod(
+            this, [this, job, success] { finishJob(job, success); },
+            Qt::QueuedConnection);
+    });
+    connect(worker, &QThread::finished, this, [this] {
+        worker->deleteLater();
+        worker = nullptr;
+        if (pendingJob != nullptr) {
+            std::shared_ptr<ImportJob> job = std::move(pendingJob);
+            pendingJob.reset();
+            start(job);
+        }
+    });
+    worker->start();
+}
+
+/**
+ * @brief MeshImporter::cancel Cancels the current import, if any. The worker
+ * thread stops at the next stage of the import and its result is discarded.
+ * An import that has not started yet is dropped.
+ */
+void MeshImporter::cancel() {
+    if (currentJob != nullptr) {
+        currentJob->cancelled = true;
+        currentJob.reset();
+    }
+    pendingJob.reset();
+}
+
+/**
+ * @brief MeshImporter::isImporting Checks whether an import is in progress.
+ * @return True if an import is in progress, false otherwise.
+ */
+bool MeshImporter::isImporting() const { return currentJob != nullptr; }
+
+/**
+ * @brief MeshImporter::takeMesh Retrieves the mesh of the last successful
+ * import. The importer releases its reference to the mesh, so that the caller
+ * is its only owner.
+ * @return The imported mesh.
+ */
+Mesh MeshImporter::takeMesh() {
+    Mesh mesh = std::move(importedMesh);
+    importedMesh = Mesh();
+    return mesh;
+}
+
+/**
+ * @brief MeshImporter::takePermutation Retrieves how the mesh of the last
+ * successful import was reordered. Empty if reordering was disabled.
+ * @return For every vertex, face and half-edge of the imported mesh, its index
+ * in the model file.
+ */
+MeshPermutation MeshImporter::takePermutation() {
+    MeshPermutation permutation = std::move(importedPermutation);
+    importedPermutation = MeshPermutation();
+    return permutation;
+}
+
+/**
+ * @brief MeshImporter::setReorderForLocality Sets whether imported meshes are
+ * reordered for cache locality. Applies to imports started afterwards.
+ * @param reorder True to reorder imported meshes; false to keep the order of
+ * the model file.
+ */
+void MeshImporter::setReorderForLocality(bool reorder) {
+    reorderForLocality = reorder;
+}
+
+/**
+ * @brief MeshImporter::run Performs the import. Invoked on the worker thread.
+ * Previously constructed meshes are taken from the mesh cache; otherwise the
+ * file is parsed and the constructed mesh is added to the cache. The cache
+ * always holds the mesh in file order, so that the permutation of a reordered
+ * mesh is available either way. Finally, the attributes used by the renderers
+ * are extracted, so the GUI thread only has to upload them.
+ * @param job The import to perform.
+ * @param progress Function invoked when a new stage of the import starts.
+ * @return True if the mesh was imported; false if the file could not be loaded
+ * or the import was cancelled.
+ */
+bool MeshImporter::run(ImportJob& job, const ProgressCallback& progress) {
+    const QString& fileName = job.fileName;
+    Mesh& mesh = job.mesh;
+
+    progress(0, "Reading mesh cache");
+    if (!MeshCache::load(fileName, mesh)) {
+        if (job.cancelled) {
+            return false;
+        }
+        progress(10, "Parsing file");
+        bool loaded = false;
+        if (QFileInfo(fileName).suffix().toLower() == "ply") {
+            loaded = loadModel<PLYFile>(fileName, mesh, job.cancelled, progress);
+        } else {
+            loaded = loadModel<OBJFile>(fileName, mesh, job.cancelled, progress);
+        }
+        if (!loaded || job.cancelled) {
+            return false;
+        }
+        progress(80, "Writing mesh cache");
+        MeshCache::save(fileName, mesh);
+    }
+
+    if (job.cancelled) {
+        return false;
+    }
+    if (job.reorder) {
+        progress(85, "Reordering mesh");
+        MeshReorderer meshReorderer(QThread::idealThreadCount());
+        mesh = meshReorderer.reorder(mesh, job.permutation);
+        if (job.cancelled) {
+            return false;
+        }
+    }
+    progress(90, "Extracting attributes");
+    mesh.extractAttributes();
+    return !job.cancelled;
+}
+
+/**
+ * @brief MeshImporter::reportProgress Emits progressChanged, unless the import
+ * has been cancelled in the meantime.
+ * @param jobId The import that made progress.
+ * @param percentage Estimate of how far along the import is.
+ * @param stage Description of the stage the import is in.
+ */
+void MeshImporter::reportProgress(int jobId, int percentage,
+                                  const QString& stage) {
+    if (currentJob != nullptr && currentJob->id == jobId) {
+        emit progressChanged(percentage, stage);
+    }
+}
+
+/**
+ * @brief MeshImporter::finishJob Hands the result of a finished import over to
+ * the GUI thread and emits finished, unless the import has been cancelled in
+ * the meantime.
+ * @param job The import that finished.
+ * @param success Whether the mesh was imported successfully.
+ */
+void MeshImporter::finishJob(const std::shared_ptr<ImportJob>& job,
+                             bool success) {
+    if (currentJob != job) {
+        return;
+    }
+    currentJob.reset();
+    if (success) {
+        importedMesh = std::move(job->mesh);
+        importedPermutation = std::move(job->permutation);
+        emit progressChanged(100, "Done");
+    } else {
+        qDebug() << " * Could not import" << job->fileName;
+    }
+    // The worker no longer uses the mesh; releasing it leaves importedMesh as
+    // the only owner.
+    job->mesh = Mesh();
+    job->permutation = MeshPermutation();
+    emit finished(success);
+}
@@ -0,0 +1,76 @@
+#ifndef MESH_IMPORTER_H
+#define MESH_IMPORTER_H
+
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "../mesh/mesh.h"
+#include "meshreorderer.h"
+
+/**
+ * @brief The MeshImporter class loads models on a worker thread, so that the
+ * UI stays responsive while large files are parsed. Only one import is active
+ * at a time: starting a new import cancels the one in flight, and results of
+ * cancelled imports are never reported.
+ *
+ * A cancelled import stops at its next stage, so a single worker thread is
+ * kept running at most. An import started while a cancelled one is still
+ * finishing its stage waits for it, and only the newest of those is kept.
+ */
+class MeshImporter : public QObject {
+  Q_OBJECT
+
+ public:
+  explicit MeshImporter(QObject* parent = nullptr);
+  ~MeshImporter() override;
+
+  void import(const QString& fileName);
+  void cancel();
+  bool isImporting() const;
+  Mesh takeMesh();
+  MeshPermutation takePermutation();
+
+  void setReorderForLocality(bool reorder);
+
+ signals:
+  void progressChanged(int percentage, const QString& stage);
+  void finished(bool success);
+
+ private:
+  /**
+   * @brief The state shared between an import and its worker thread.
+   */
+  struct ImportJob {
+    int id;
+    QString fileName;
+    bool reorder;
+    std::atomic<bool> cancelled{false};
+    // Only accessed by the GUI thread once the worker has finished
+    Mesh mesh;
+    MeshPermutation permutation;
+  };
+
+  using ProgressCallback = std::function<void(int, const QString&)>;
+
+  void start(const std::shared_ptr<ImportJob>& job);
+  static bool run(ImportJob& job, const ProgressCallback& progress);
+  void reportProgress(int jobId, int percentage, const QString& stage);
+  void finishJob(const std::shared_ptr<ImportJob>& job, bool success);
+
+  std::shared_ptr<ImportJob> currentJob;
+  // The import waiting for the worker of a cancelled import to stop
+  std::shared_ptr<ImportJob> pendingJob;
+  QThread* worker;
+  int numJobs;
+  bool reorderForLocality;
+  Mesh importedMesh;
+  // Maps the imported mesh back to the model file if it was reordered
+  MeshPermutation importedPermutation;
+};
+
+#endif  // MESH_IMPORTER_H
@@ -2,85 +2,324 @@
 
 #include <QDebug>
 
+#include "util/parallel.h"
+
+// Below this many half-edges, the serial construction is faster
+#define MIN_PARALLEL_HALF_EDGES 65536
+
+/**
+ * @brief The HalfEdgeKey struct pairs the undirected edge key of a half-edge
+ * with the index of that half-edge. Sorting these brings twins together.
+ */
+struct HalfEdgeKey {
+  quint64 edge;
+  int halfEdge;
+};
+
+/**
+ * @brief createUndirectedEdge Creates an undirected edge key from two vertex
+ * indices.
+ * @param v1 First vertex index.
+ * @param v2 Second vertex index.
+ * @return A key with the lower index in the upper 32 bits and the higher index
+ * in the lower 32 bits. Two indices always produce the same key, regardless of
+ * their ordering.
+ */
+quint64 createUndirectedEdge(int v1, int v2) {
+    // to ensure that edges are consistent, always put the lower index first
+    if (v1 > v2) {
+        std::swap(v1, v2);
+    }
+    return (quint64(quint32(v1)) << 32) | quint32(v2);
+}
+
 /**
  * @brief MeshInitializer::MeshInitializer Initializes an empty mesh
  * initializer.
+ * @param numThreads The number of threads used to construct the topology. The
+ * constructed mesh does not depend on the number of threads.
  */
-MeshInitializer::MeshInitializer() {}
+MeshInitializer::MeshInitializer(int numThreads) : numThreads(numThreads) {}
 
 /**
  * @brief MeshInitializer::constructHalfEdgeMesh Constructs a half-edge mesh
- * from the provided obj file. The half-edge data structure uses smart indexing
- * to do the initialization in a clean manner. This indexing is based on the
- * following paper:
- * https://diglib.eg.org/bitstream/handle/10.1111/cgf14381/v40i8pp057-070.pdf?sequence=1&isAllowed=y
+ * from the provided obj file.
  * @param loadedOBJFile The OBJFile containing all the data of the mesh to
  * construct.
  * @return A half-edge representation of the provided mesh.
  */
 Mesh MeshInitializer::constructHalfEdgeMesh(const OBJFile& loadedOBJFile) {
-    int numVertices = loadedOBJFile.vertexCoords.size();
-    int numFaces = loadedOBJFile.faceValences.size();
-    int numHalfEdges = 0;
-    for (int f = 0; f < numFaces; f++) {
-        numHalfEdges += loadedOBJFile.faceValences[f];
+    return constructHalfEdgeMesh(loadedOBJFile.vertexCoords,
+                                 loadedOBJFile.faceOffsets,
+                                 loadedOBJFile.faceCoordInd);
+}
+
+/**
+ * @brief MeshInitializer::constructHalfEdgeMesh Constructs a half-edge mesh
+ * from the provided ply file.
+ * @param loadedPLYFile The PLYFile containing all the data of the mesh to
+ * construct.
+ * @return A half-edge representation of the provided mesh.
+ */
+Mesh MeshInitializer::constructHalfEdgeMesh(const PLYFile& loadedPLYFile) {
+    return constructHalfEdgeMesh(loadedPLYFile.vertexCoords,
+                                 loadedPLYFile.faceOffsets,
+                                 loadedPLYFile.faceCoordInd);
+}
+
+/**
+ * @brief MeshInitializer::constructHalfEdgeMesh Constructs a half-edge mesh
+ * from a flat face table. The half-edge data structure uses smart indexing
+ * to do the initialization in a clean manner. This indexing is based on the
+ * following paper:
+ * https://diglib.eg.org/bitstream/handle/10.1111/cgf14381/v40i8pp057-070.pdf?sequence=1&isAllowed=y
+ * @param vertexCoords The vertex coordinates.
+ * @param faceOffsets For each face, the position of its first vertex index in
+ * faceCoordInd. Contains one additional entry marking the end of the last face.
+ * @param faceCoordInd The vertex indices of all faces, one face after the
+ * other.
+ * @return A half-edge representation of the provided mesh.
+ */
+Mesh MeshInitializer::constructHalfEdgeMesh(
+    const QVector<QVector3D>& vertexCoords, const QVector<int>& faceOffsets,
+    const QVector<int>& faceCoordInd) {
+    int numVertices = vertexCoords.size();
+    int numFaces = faceOffsets.size() - 1;
+    int numHalfEdges = faceCoordInd.size();
+
+    // The edge map is expected to hold about one entry per two half-edges, but
+    // reserving for all of them avoids rehashing on meshes with long boundaries.
+    // The parallel construction does not use it.
+    bool parallel = numThreads > 1 && numHalfEdges >= MIN_PARALLEL_HALF_EDGES;
+    edgeMap.clear();
+    if (!parallel) {
+        edgeMap.reserve(numHalfEdges);
     }
+    edgeCount = 0;
 
     Mesh mesh;
     mesh.vertices.resize(numVertices);
     mesh.faces.resize(numFaces);
     mesh.halfEdges.resize(numHalfEdges);
-    mesh.halfEdges.reserve(2 * numHalfEdges);
+    mesh.halfEdgeNexts.resize(numHalfEdges);
+    mesh.halfEdgeFaces.resize(numHalfEdges);
+
+    initGeometry(mesh, numVertices, vertexCoords);
+    if (parallel) {
+        initTopologyParallel(mesh, numFaces, faceOffsets, faceCoordInd);
+    } else {
+        initTopology(mesh, numFaces, faceOffsets, faceCoordInd);
+    }
 
-    initGeometry(mesh, numVertices, loadedOBJFile.vertexCoords);
-    initTopology(mesh, numFaces, loadedOBJFile.faceCoordInd);
+    // The edge map is only needed during construction
+    edgeMap.clear();
     return mesh;
 }
 
 /**
- * @brief MeshInitializer::initGeometry Initializes the vertex coordinates and
- * their indices.
+ * @brief MeshInitializer::initGeometry Initializes the vertex coordinates by
+ * splitting them into the x, y and z arrays of the mesh.
  * @param mesh The mesh to initialize.
  * @param numVertices The number of vertices to initialize.
  * @param vertexCoords The vertex coordinates.
  */
 void MeshInitializer::initGeometry(Mesh& mesh, int numVertices,
                                    const QVector<QVector3D>& vertexCoords) {
-    for (int v = 0; v < numVertices; v++) {
-        Vertex* vertex = &mesh.vertices[v];
-        vertex->coords = vertexCoords[v];
-        vertex->index = v;
-    }
+    mesh.positions.resize(numVertices);
+    float* x = mesh.positions.x();
+    float* y = mesh.positions.y();
+    float* z = mesh.positions.z();
+    const QVector3D* coords = vertexCoords.constData();
+    parallelFor(
+        0, numVertices,
+        [&](int first, int last) {
+            for (int v = first; v < last; v++) {
+                x[v] = coords[v].x();
+                y[v] = coords[v].y();
+                z[v] = coords[v].z();
+            }
+        },
+        numThreads);
 }
 
 /**
  * @brief MeshInitializer::initTopology Initializes the half-edges and face
- * data. Makes sure that all the connections are set up correctly.
+ * data. Makes sure that all the connections are set up correctly. The faces
+ * are read directly from the flat face table, without copying them.
  * @param mesh The mesh to initialize.
  * @param numFaces The number of faces the mesh will have.
- * @param faceCoordInd A vector containing, for each face, the indices of the
- * vertices.
+ * @param faceOffsets For each face, the position of its first vertex index in
+ * faceCoordInd. Contains one additional entry marking the end of the last face.
+ * @param faceCoordInd The vertex indices of all faces, one face after the
+ * other.
  */
 void MeshInitializer::initTopology(Mesh& mesh, int numFaces,
-                                   const QVector<QVector<int>>& faceCoordInd) {
-    int h = 0;
+                                   const QVector<int>& faceOffsets,
+                                   const QVector<int>& faceCoordInd) {
+    // Since each face ends up with a number of half edges equal to its number
+    // of vertices, the half-edges of a face start at the offset of the face.
     for (int f = 0; f < numFaces; ++f) {
-        QVector<int> faceIndices = faceCoordInd[f];
-        // Each face ends up with a number of half edges equal to its number of
-        // vertices.
+        int h = faceOffsets[f];
+        const int* faceIndices = faceCoordInd.constData() + h;
         Face* face = &mesh.faces[f];
-        face->index = f;
-        face->valence = faceIndices.size();
-        face->side = &mesh.halfEdges[h];
+        face->valence = faceOffsets[f + 1] - h;
+        face->side = h;
         for (int i = 0; i < face->valence; ++i) {
-            addHalfEdge(mesh, h, face, faceIndices, i);
+            addHalfEdge(mesh, h, f, faceIndices, i);
             // The valence of a vertex is equal to the number of faces it belongs to,
             // so for every face, increment the valence of all its vertices by 1.
             mesh.vertices[faceIndices[i]].valence++;
             h++;
         }
     }
-    mesh.edgeCount = edgeList.size();
+    mesh.edgeCount = edgeCount;
+}
+
+/**
+ * @brief forEachGroup Invokes the body for every run of consecutive items with
+ * equal keys, in parallel. Every run is handled by the block it starts in.
+ * @param items The sorted items.
+ * @param count The number of items.
+ * @param key Function retrieving the key of an item.
+ * @param body Function invoked with the start and end of every run.
+ * @param numThreads The maximum number of threads to use.
+ */
+template <typename T, typename Key, typename Body>
+static void forEachGroup(const T* items, int count, Key key, Body body,
+                         int numThreads) {
+    parallelFor(
+        0, count,
+        [&](int first, int last) {
+            int p = first;
+            // The run containing the first item is handled by the block before
+            while (p > 0 && p < last && key(items[p]) == key(items[p - 1])) {
+                p++;
+            }
+            while (p < last) {
+                int q = p + 1;
+                while (q < count && key(items[q]) == key(items[p])) {
+                    q++;
+                }
+                body(p, q);
+                p = q;
+            }
+        },
+        numThreads);
+}
+
+/**
+ * @brief MeshInitializer::initTopologyParallel Initializes the half-edges and
+ * face data using multiple threads. Produces exactly the same mesh as
+ * initTopology.
+ *
+ * The half-edges of every face are set up in parallel, as the face offsets
+ * already tell where the half-edges of each face start. Twins are found by
+ * sorting the half-edges on their undirected edge. Within every run of equal
+ * edges, the half-edge with the lowest index comes first; an exclusive prefix
+ * sum over these first half-edges numbers the edges in the order in which
+ * initTopology encounters them. Finally, sorting the half-edges on their
+ * origin gives the valence and outgoing half-edge of every vertex without
+ * requiring atomic counters.
+ * @param mesh The mesh to initialize.
+ * @param numFaces The number of faces the mesh will have.
+ * @param faceOffsets For each face, the position of its first vertex index in
+ * faceCoordInd. Contains one additional entry marking the end of the last face.
+ * @param faceCoordInd The vertex indices of all faces, one face after the
+ * other.
+ */
+void MeshInitializer::initTopologyParallel(Mesh& mesh, int numFaces,
+                                           const QVector<int>& faceOffsets,
+                                           const QVector<int>& faceCoordInd) {
+    int numHalfEdges = mesh.halfEdges.size();
+    Vertex* vertices = mesh.vertices.data();
+    HalfEdge* halfEdges = mesh.halfEdges.data();
+    int* halfEdgeNexts = mesh.halfEdgeNexts.data();
+    int* halfEdgeFaces = mesh.halfEdgeFaces.data();
+    Face* faces = mesh.faces.data();
+    const int* offsets = faceOffsets.constData();
+    const int* indices = faceCoordInd.constData();
+
+    QVector<HalfEdgeKey> edgeKeys(numHalfEdges);
+    // Origin in the upper 32 bits, half-edge index in the lower 32 bits
+    QVector<quint64> originKeys(numHalfEdges);
+    HalfEdgeKey* edgeKeyData = edgeKeys.data();
+    quint64* originKeyData = originKeys.data();
+
+    parallelFor(
+        0, numFaces,
+        [&](int first, int last) {
+            for (int f = first; f < last; f++) {
+                int start = offsets[f];
+                int valence = offsets[f + 1] - start;
+                Face* face = &faces[f];
+                face->valence = valence;
+                face->side = start;
+                for (int i = 0; i < valence; i++) {
+                    int h = start + i;
+                    int next = start + (i + 1) % valence;
+                    halfEdges[h].origin = indices[h];
+                    halfEdgeNexts[h] = next;
+                    halfEdgeFaces[h] = f;
+                    edgeKeyData[h] = {
+                        createUndirectedEdge(indices[h], indices[next]), h};
+                    originKeyData[h] =
+                        (quint64(quint32(indices[h])) << 32) | quint32(h);
+                }
+            }
+        },
+        numThreads);
+
+    // Twins and edge indices
+    parallelSort(
+        edgeKeys,
+        [](const HalfEdgeKey& a, const HalfEdgeKey& b) {
+            return a.edge < b.edge ||
+                   (a.edge == b.edge && a.halfEdge < b.halfEdge);
+        },
+        numThreads);
+    const HalfEdgeKey* sortedEdges = edgeKeys.constData();
+    auto edgeKey = [](const HalfEdgeKey& key) { return key.edge; };
+
+    QVector<int> edgeIndices(numHalfEdges, 0);
+    int* edgeIndexData = edgeIndices.data();
+    forEachGroup(
+        sortedEdges, numHalfEdges, edgeKey,
+        [&](int p, int q) {
+            Q_UNUSED(q);
+            edgeIndexData[sortedEdges[p].halfEdge] = 1;
+        },
+        numThreads);
+    edgeCount = parallelExclusiveScan(edgeIndexData, numHalfEdges, numThreads);
+    forEachGroup(
+        sortedEdges, numHalfEdges, edgeKey,
+        [&](int p, int q) {
+            int first = sortedEdges[p].halfEdge;
+            int edgeIndex = edgeIndexData[first];
+            halfEdges[first].edgeIndex = edgeIndex;
+            for (int i = p + 1; i < q; i++) {
+                int h = sortedEdges[i].halfEdge;
+                halfEdges[h].edgeIndex = edgeIndex;
+                halfEdges[h].twin = first;
+                halfEdges[first].twin = h;
+            }
+        },
+        numThreads);
+
+    // Valences and outgoing half-edges
+    parallelSort(originKeys, std::less<quint64>(), numThreads);
+    const quint64* sortedOrigins = originKeys.constData();
+    forEachGroup(
+        sortedOrigins, numHalfEdges, [](quint64 key) { return key >> 32; },
+        [&](int p, int q) {
+            Vertex* vertex = &vertices[sortedOrigins[p] >> 32];
+            // The valence of a vertex is equal to the number of faces it belongs
+            // to, which is the number of half-edges originating from it.
+            vertex->valence = q - p;
+            vertex->out = int(quint32(sortedOrigins[q - 1]));
+        },
+        numThreads);
+
+    mesh.edgeCount = edgeCount;
 }
 
 /**
@@ -88,57 +327,36 @@ void MeshInitializer::initTopology(Mesh& mesh, int numFaces,
  * in the mesh.
  * @param mesh The mesh to initialize the half-edge in.
  * @param h Index of the half-edge.
- * @param face Face that the half-edge belongs to.
+ * @param f Index of the face that the half-edge belongs to.
  * @param vertIndices Indices of the vertices that belong to the face this
- * half-edge belongs to.
- * @param i Index within vertIndices vector.
+ * half-edge belongs to. Contains face->valence indices.
+ * @param i Index within vertIndices.
  */
-void MeshInitializer::addHalfEdge(Mesh& mesh, int h, Face* face,
-                                  const QVector<int>& vertIndices, int i) {
-    int faceValence = vertIndices.size();
+void MeshInitializer::addHalfEdge(Mesh& mesh, int h, int f,
+                                  const int* vertIndices, int i) {
+    int faceValence = mesh.faces[f].valence;
     int vertIdx = vertIndices[i];
     int nextVertIdx = vertIndices[(i + 1) % faceValence];
-    // prev and next
-    int prev = h - 1;
     int next = h + 1;
-    if (i == 0) {
-        // prev = h - 1 + faceValency
-        prev += faceValence;
-    } else if (i == faceValence - 1) {
+    if (i == faceValence - 1) {
         // next = h + 1 - faceValency
         next -= faceValence;
     }
-    HalfEdge* halfEdge = &mesh.halfEdges[h];
-    halfEdge->index = h;
-    halfEdge->origin = &mesh.vertices[vertIdx];
-    halfEdge->prev = &mesh.halfEdges[prev];
-    halfEdge->next = &mesh.halfEdges[next];
-    halfEdge->face = face;
-    mesh.vertices[vertIdx].out = halfEdge;
+    mesh.halfEdges[h].origin = vertIdx;
+    mesh.halfEdgeNexts[h] = next;
+    mesh.halfEdgeFaces[h] = f;
+    mesh.vertices[vertIdx].out = h;
 
     setTwins(mesh, h, vertIdx, nextVertIdx);
 }
 
-/**
- * @brief createUndirectedEdge Creates an undirected edge from two vertex
- * indices.
- * @param v1 First vertex index.
- * @param v2 Second vertex index.
- * @return A pair of v1-v2. Two indices always produce the same pair, regardless
- * of their ordering.
- */
-QPair<int, int> createUndirectedEdge(int v1, int v2) {
-  // to ensure that edges are consistent, always put the lower index first
-    if (v1 > v2) {
-        return QPair<int, int>(v2, v1);
-    }
-    return QPair<int, int>(v1, v2);
-}
-
 /**
  * @brief MeshInitializer::setTwins Set the twin properties of the half-edge.
  * Simultaneously updates the edge indices by keeping track of all the edges
- * that have been (partially) covered.
+ * that have been (partially) covered. Edges are numbered in the order in which
+ * their first half-edge is encountered, which is what the indexing rules of
+ * the subdivider rely on. Every lookup is a single hash map query, so matching
+ * all twins takes linear time in the number of half-edges.
  * @param mesh The mesh the half-edge belongs to.
  * @param h Index of the half-edge.
  * @param vertIdx1 Index of the first vertex of the edge the half-edge belongs
@@ -147,22 +365,20 @@ QPair<int, int> createUndirectedEdge(int v1, int v2) {
  * to.
  */
 void MeshInitializer::setTwins(Mesh& mesh, int h, int vertIdx1, int vertIdx2) {
-    QPair<int, int> currentEdge = createUndirectedEdge(vertIdx1, vertIdx2);
+    quint64 currentEdge = createUndirectedEdge(vertIdx1, vertIdx2);
 
-    int edgeIdx = edgeList.indexOf(currentEdge);
+    int twinIdx = edgeMap.value(currentEdge, -1);
     // edge does not exist yet
-    if (edgeIdx == -1) {
-        // same as doing this after appending and adding -1
-        edgeIndices.append(edgeList.size());
-        mesh.halfEdges[h].edgeIndex = edgeList.size();
-        edgeList.append(currentEdge);
+    if (twinIdx == -1) {
+        mesh.halfEdges[h].edgeIndex = edgeCount;
+        edgeMap.insert(currentEdge, h);
+        edgeCount++;
     } else {
-        edgeIndices.append(edgeIdx);
-        mesh.halfEdges[h].edgeIndex = edgeIdx;
         // edge already existed, meaning there is a twin somewhere earlier in the
-        // list of edges
-        HalfEdge* twinEdge = &mesh.halfEdges[edgeIndices.indexOf(edgeIdx)];
-        mesh.halfEdges[h].twin = twinEdge;
-        twinEdge->twin = &mesh.halfEdges[h];
+        // list of half-edges
+        HalfEdge* twinEdge = &mesh.halfEdges[twinIdx];
+        mesh.halfEdges[h].edgeIndex = twinEdge->edgeIndex;
+        mesh.halfEdges[h].twin = twinIdx;
+        twinEdge->twin = h;
     }
 }
@@ -1,28 +1,45 @@
 #ifndef MESH_INITIALIZER_H
 #define MESH_INITIALIZER_H
 
+#include <QHash>
+
 #include "../mesh/mesh.h"
 #include "objfile.h"
+#include "plyfile.h"
 
 /**
- * @brief The MeshInitializer class initializes half-edge meshes from OBJFiles.
+ * @brief The MeshInitializer class initializes half-edge meshes from OBJFiles
+ * and PLYFiles.
  */
 class MeshInitializer {
  public:
-  MeshInitializer();
+  MeshInitializer(int numThreads = 1);
   Mesh constructHalfEdgeMesh(const OBJFile& loadedOBJFile);
+  Mesh constructHalfEdgeMesh(const PLYFile& loadedPLYFile);
 
  private:
+  Mesh constructHalfEdgeMesh(const QVector<QVector3D>& vertexCoords,
+                             const QVector<int>& faceOffsets,
+                             const QVector<int>& faceCoordInd);
   void initGeometry(Mesh& mesh, int numVertices,
                     const QVector<QVector3D>& vertexCoords);
-  void initTopology(Mesh& mesh, int numFaces,
-                     const QVector<QVector<int>>& faceCoordInd);
-  void addHalfEdge(Mesh& mesh, int h, Face* face,
-                   const QVector<int>& faceIndices, int i);
+  void initTopology(Mesh& mesh, int numFaces, const QVector<int>& faceOffsets,
+                    const QVector<int>& faceCoordInd);
+  void initTopologyParallel(Mesh& mesh, int numFaces,
+                            const QVector<int>& faceOffsets,
+                            const QVector<int>& faceCoordInd);
+  void addHalfEdge(Mesh& mesh, int h, int f, const int* faceIndices,
+                   int i);
   void setTwins(Mesh& mesh, int h, int vertIdx1, int vertIdx2);
 
-  QList<QPair<int, int>> edgeList;
-  QVector<int> edgeIndices;
+  // Maps an undirected edge key to the first half-edge that lives on it.
+  QHash<quint64, int> edgeMap;
+  int edgeCount;
+  int numThreads;
+
+  // Rebuild reordered meshes and sub-meshes from a flat face table
+  friend class MeshReorderer;
+  friend class AdaptiveSubdivider;
 };
 
 #endif  // MESH_INITIALIZER_H
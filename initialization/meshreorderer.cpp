@@ -0,0 +1,194 @@
+#include "meshreorderer.h"
+
+#include <cfloat>
+
+#include "meshinitializer.h"
+#include "util/parallel.h"
+
+// Number of bits per coordinate of the Morton code
+#define MORTON_BITS 21
+
+/**
+ * @brief The MortonKey struct pairs the Morton code of a vertex with the index
+ * of that vertex.
+ */
+struct MortonKey {
+  quint64 code;
+  int vertex;
+};
+
+/**
+ * @brief expandBits Spreads the lowest 21 bits of a value over 63 bits, so that
+ * two zero bits follow every bit.
+ * @param value The value to spread.
+ * @return The spread value.
+ */
+static quint64 expandBits(quint64 value) {
+    value &= 0x1fffff;
+    value = (value | value << 32) & 0x1f00000000ffffULL;
+    value = (value | value << 16) & 0x1f0000ff0000ffULL;
+    value = (value | value << 8) & 0x100f00f00f00f00fULL;
+    value = (value | value << 4) & 0x10c30c30c30c30c3ULL;
+    value = (value | value << 2) & 0x1249249249249249ULL;
+    return value;
+}
+
+/**
+ * @brief quantize Maps a coordinate to an integer grid coordinate.
+ * @param value The coordinate.
+ * @param min The lowest coordinate along this axis.
+ * @param scale Factor mapping the extent along this axis to the grid.
+ * @return The grid coordinate.
+ */
+static quint64 quantize(float value, float min, float scale) {
+    const float maxCoord = float((1 << MORTON_BITS) - 1);
+    return quint64(qBound(0.0f, (value - min) * scale, maxCoord));
+}
+
+/**
+ * @brief MeshReorderer::MeshReorderer Initializes a mesh reorderer.
+ * @param numThreads The number of threads used to sort the vertices and to
+ * construct the reordered mesh. The result does not depend on the number of
+ * threads.
+ */
+MeshReorderer::MeshReorderer(int numThreads) : numThreads(numThreads) {}
+
+/**
+ * @brief MeshReorderer::reorder Creates a copy of the mesh of which the
+ * vertices, faces and half-edges are ordered for cache locality. The edges are
+ * numbered anew by the mesh initializer.
+ * @param mesh The mesh to reorder.
+ * @param permutation Is set to the indices in the original mesh of the
+ * elements of the reordered mesh, for instance to map exported data back to
+ * the original model.
+ * @return The reordered mesh.
+ */
+Mesh MeshReorderer::reorder(const Mesh& mesh,
+                            MeshPermutation& permutation) const {
+    int numVerts = mesh.numVerts();
+    int numFaces = mesh.numFaces();
+
+    permutation.vertices = sortVertices(mesh);
+    QVector<int> newVertexIndices(numVerts);
+    QVector<QVector3D> vertexCoords(numVerts);
+    for (int v = 0; v < numVerts; v++) {
+        int oldIdx = permutation.vertices[v];
+        newVertexIndices[oldIdx] = v;
+        vertexCoords[v] = mesh.position(oldIdx);
+    }
+
+    permutation.faces = sortFaces(mesh, newVertexIndices);
+
+    // The faces are listed starting at their side, so corner i of a reordered
+    // face corresponds to the i-th half-edge of the original face.
+    QVector<int> faceOffsets(numFaces + 1);
+    QVector<int> faceCoordInd(mesh.numHalfEdges());
+    permutation.halfEdges.resize(mesh.numHalfEdges());
+    int h = 0;
+    for (int f = 0; f < numFaces; f++) {
+        faceOffsets[f] = h;
+        int oldFace = permutation.faces[f];
+        int oldHalfEdge = mesh.sideIdx(oldFace);
+        for (int i = 0; i < mesh.faceValence(oldFace); i++) {
+            faceCoordInd[h] = newVertexIndices[mesh.originIdx(oldHalfEdge)];
+            permutation.halfEdges[h] = oldHalfEdge;
+            oldHalfEdge = mesh.nextIdx(oldHalfEdge);
+            h++;
+        }
+    }
+    faceOffsets[numFaces] = h;
+
+    MeshInitializer meshInitializer(numThreads);
+    return meshInitializer.constructHalfEdgeMesh(vertexCoords, faceOffsets,
+                                                 faceCoordInd);
+}
+
+/**
+ * @brief MeshReorderer::sortVertices Sorts the vertices along a Morton curve
+ * through the bounding box of the mesh. Vertices with the same Morton code
+ * keep their original order.
+ * @param mesh The mesh to sort the vertices of.
+ * @return For every new vertex index, the original index of the vertex.
+ */
+QVector<int> MeshReorderer::sortVertices(const Mesh& mesh) const {
+    int numVerts = mesh.numVerts();
+    const VertexPositions& positions = mesh.getPositions();
+    const float* coords[3] = {positions.x(), positions.y(), positions.z()};
+
+    float min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    float max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (int axis = 0; axis < 3; axis++) {
+        for (int v = 0; v < numVerts; v++) {
+            min[axis] = qMin(min[axis], coords[axis][v]);
+            max[axis] = qMax(max[axis], coords[axis][v]);
+        }
+    }
+    // A single scale for all axes keeps the cells of the curve cubes
+    float extent = qMax(max[0] - min[0], qMax(max[1] - min[1], max[2] - min[2]));
+    float scale = extent > 0.0f ? float((1 << MORTON_BITS) - 1) / extent : 0.0f;
+
+    QVector<MortonKey> keys(numVerts);
+    MortonKey* keyData = keys.data();
+    parallelFor(
+        0, numVerts,
+        [&](int first, int last) {
+            for (int v = first; v < last; v++) {
+                quint64 x = quantize(coords[0][v], min[0], scale);
+                quint64 y = quantize(coords[1][v], min[1], scale);
+                quint64 z = quantize(coords[2][v], min[2], scale);
+                keyData[v].code =
+                    expandBits(x) | expandBits(y) << 1 | expandBits(z) << 2;
+                keyData[v].vertex = v;
+            }
+        },
+        numThreads);
+
+    parallelSort(
+        keys,
+        [](const MortonKey& a, const MortonKey& b) {
+            return a.code < b.code || (a.code == b.code && a.vertex < b.vertex);
+        },
+        numThreads);
+
+    QVector<int> order(numVerts);
+    for (int v = 0; v < numVerts; v++) {
+        order[v] = keys[v].vertex;
+    }
+    return order;
+}
+
+/**
+ * @brief MeshReorderer::sortFaces Sorts the faces by the lowest new index of
+ * their vertices, so that faces are visited in roughly the same order as their
+ * vertices. Faces with the same lowest vertex keep their original order. Since
+ * the keys are vertex indices, a counting sort suffices.
+ * @param mesh The mesh to sort the faces of.
+ * @param newVertexIndices For every original vertex index, the new index of
+ * the vertex.
+ * @return For every new face index, the original index of the face.
+ */
+QVector<int> MeshReorderer::sortFaces(
+    const Mesh& mesh, const QVector<int>& newVertexIndices) const {
+    int numFaces = mesh.numFaces();
+    QVector<int> faceKeys(numFaces);
+    QVector<int> counts(mesh.numVerts() + 1, 0);
+    for (int f = 0; f < numFaces; f++) {
+        int h = mesh.sideIdx(f);
+        int key = newVertexIndices[mesh.originIdx(h)];
+        for (int i = 1; i < mesh.faceValence(f); i++) {
+            h = mesh.nextIdx(h);
+            key = qMin(key, newVertexIndices[mesh.originIdx(h)]);
+        }
+        faceKeys[f] = key;
+        counts[key + 1]++;
+    }
+    for (int v = 0; v < mesh.numVerts(); v++) {
+        counts[v + 1] += counts[v];
+    }
+
+    QVector<int> order(numFaces);
+    for (int f = 0; f < numFaces; f++) {
+        order[counts[faceKeys[f]]++] = f;
+    }
+    return order;
+}
@@ -3,45 +3,195 @@
 #include <QDebug>
 #include <QFile>
 #include <QMatrix4x4>
+#include <charconv>
+#include <cstring>
 
+#include "util/parallel.h"
 #include "util/util.h"
 
 #define DESIRED_SCALE 2.0
+// Files are only split into chunks of at least this many bytes, since smaller
+// chunks are not worth starting a thread for.
+#define MIN_CHUNK_SIZE (1 << 20)
+
+/**
+ * @brief Identifies the kind of record stored on a line of an .obj file.
+ */
+enum class OBJRecord { Vertex, TexCoords, Normal, Face, Other };
+
+/**
+ * @brief isSpace Checks whether the provided character separates tokens.
+ * @param c The character to check.
+ * @return True if the character is whitespace; false otherwise.
+ */
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/**
+ * @brief skipSpaces Advances the cursor past any whitespace.
+ * @param p The cursor.
+ * @param end End of the line.
+ * @return The first non-whitespace position, or end.
+ */
+static inline const char* skipSpaces(const char* p, const char* end) {
+    while (p < end && isSpace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+/**
+ * @brief skipToken Advances the cursor to the end of the current token.
+ * @param p The cursor.
+ * @param end End of the line.
+ * @return The first whitespace position after the token, or end.
+ */
+static inline const char* skipToken(const char* p, const char* end) {
+    while (p < end && !isSpace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+/**
+ * @brief lineEnd Finds the end of the line starting at the cursor.
+ * @param p The cursor.
+ * @param end End of the file.
+ * @return The position of the line break, or end.
+ */
+static inline const char* lineEnd(const char* p, const char* end) {
+    const char* newline =
+        static_cast<const char*>(memchr(p, '\n', size_t(end - p)));
+    return newline == nullptr ? end : newline;
+}
+
+/**
+ * @brief recordType Reads the descriptor of a line and determines the record
+ * type.
+ * @param p The cursor. Is moved past the descriptor.
+ * @param end End of the line.
+ * @return The type of the record on this line.
+ */
+static inline OBJRecord recordType(const char*& p, const char* end) {
+    p = skipSpaces(p, end);
+    const char* tokenEnd = skipToken(p, end);
+    size_t length = size_t(tokenEnd - p);
+    OBJRecord type = OBJRecord::Other;
+    if (length == 1 && p[0] == 'v') {
+        type = OBJRecord::Vertex;
+    } else if (length == 1 && p[0] == 'f') {
+        type = OBJRecord::Face;
+    } else if (length == 2 && p[0] == 'v' && p[1] == 't') {
+        type = OBJRecord::TexCoords;
+    } else if (length == 2 && p[0] == 'v' && p[1] == 'n') {
+        type = OBJRecord::Normal;
+    }
+    p = tokenEnd;
+    return type;
+}
+
+/**
+ * @brief parseFloat Parses the next whitespace separated number on the line.
+ * Mirrors QString::toFloat: the number is parsed in double precision and then
+ * rounded to float, and invalid or missing numbers become 0.
+ * @param p The cursor. Is moved past the number.
+ * @param end End of the line.
+ * @return The parsed number.
+ */
+static inline float parseFloat(const char*& p, const char* end) {
+    p = skipSpaces(p, end);
+    const char* tokenEnd = skipToken(p, end);
+    const char* first = p;
+    // from_chars does not accept an explicit plus sign
+    if (first < tokenEnd && *first == '+') {
+        first++;
+    }
+    double value = 0.0;
+    std::from_chars_result result = std::from_chars(first, tokenEnd, value);
+    p = tokenEnd;
+    if (result.ec != std::errc() || result.ptr != tokenEnd) {
+        return 0.0f;
+    }
+    return float(value);
+}
+
+/**
+ * @brief countCorners Counts the whitespace separated corners of a face.
+ * @param p Line contents after the descriptor.
+ * @param end End of the line.
+ * @return The number of corners.
+ */
+static inline int countCorners(const char* p, const char* end) {
+    int corners = 0;
+    for (p = skipSpaces(p, end); p < end; p = skipSpaces(skipToken(p, end), end)) {
+        corners++;
+    }
+    return corners;
+}
+
+/**
+ * @brief parseIndex Parses a single index of a face corner, for example the
+ * "2" in "1/2/3". Empty indices are returned as -1.
+ * @param p The cursor. Is moved past the index and its trailing slash.
+ * @param end End of the face corner.
+ * @return The zero-based index, or -1 if the index is absent.
+ */
+static inline int parseIndex(const char*& p, const char* end) {
+    int value = 0;
+    std::from_chars_result result = std::from_chars(p, end, value);
+    bool present = result.ec == std::errc();
+    p = present ? result.ptr : p;
+    // Skip to just past the next slash, or to the end of the corner
+    while (p < end && *p != '/') {
+        p++;
+    }
+    if (p < end) {
+        p++;
+    }
+    // Note -1, OBJ starts indexing from 1.
+    return present ? value - 1 : -1;
+}
 
 /**
  * @brief OBJFile::OBJFile Reads information from the provided .obj file and
- * stores it in this class.
+ * stores it in this class. The file is memory-mapped and tokenized in place,
+ * so no intermediate strings are created. Files that cannot be mapped (such as
+ * compressed Qt resources) are read into memory first.
  * @param fileName The path of the .obj file
+ * @param numThreads The number of threads to parse large files with. The
+ * result does not depend on the number of threads.
  */
-OBJFile::OBJFile(const QString& fileName) {
+OBJFile::OBJFile(const QString& fileName, int numThreads) {
     qDebug() << ":: Loading" << fileName;
     QFile newModel(fileName);
+    numIgnoredLines = 0;
+    loadSuccess = false;
 
     if (newModel.open(QIODevice::ReadOnly)) {
-        QTextStream fileContents(&newModel);
-
-        while (!fileContents.atEnd()) {
-            QString currentLine = fileContents.readLine();
-            QStringList values = currentLine.split(" ");
-
-            const QString descriptor = values[0];
-            if (descriptor == "v") {
-                handleVertex(values);
-            } else if (descriptor == "vt") {
-                handleVertexTexCoords(values);
-            } else if (descriptor == "vn") {
-                handleVertexNormal(values);
-            } else if (descriptor == "f") {
-                handleFace(values);
-            } else {
-                qDebug() << " * Line contents ignored," << currentLine;
-            }
+        QByteArray buffer;
+        qint64 size = newModel.size();
+        const char* begin =
+            reinterpret_cast<const char*>(newModel.map(0, size));
+        if (begin == nullptr) {
+            buffer = newModel.readAll();
+            begin = buffer.constData();
+            size = buffer.size();
         }
+        // Only offset begin once it points into the buffer actually parsed
+        const char* end = begin + size;
+
+        parse(begin, end, numThreads);
         newModel.close();
-        normalizeMesh(DESIRED_SCALE);
-        loadSuccess = true;
-    } else {
-        loadSuccess = false;
+
+        if (numIgnoredLines > 0) {
+            qDebug() << " * Line contents ignored on" << numIgnoredLines
+                     << "lines";
+        }
+        if (!vertexCoords.isEmpty()) {
+            normalizeMesh(DESIRED_SCALE);
+            loadSuccess = true;
+        }
     }
 }
 
@@ -50,70 +200,241 @@ OBJFile::OBJFile(const QString& fileName) {
  */
 OBJFile::~OBJFile() {}
 
+/**
+ * @brief OBJFile::parse Parses the contents of the file. Large files are split
+ * into line-aligned chunks that are parsed in parallel. Every chunk is first
+ * counted, after which a prefix sum over the counts tells each chunk where its
+ * records go in the arrays. This way the records end up in the same order as
+ * when parsing the file front to back.
+ * @param begin Start of the file contents.
+ * @param end End of the file contents.
+ * @param numThreads The maximum number of threads to use.
+ */
+void OBJFile::parse(const char* begin, const char* end, int numThreads) {
+    int numChunks =
+        qBound(1, int((end - begin) / MIN_CHUNK_SIZE), qMax(numThreads, 1));
+
+    QVector<const char*> chunkBounds(numChunks + 1);
+    chunkBounds[0] = begin;
+    chunkBounds[numChunks] = end;
+    for (int c = 1; c < numChunks; c++) {
+        // Move every boundary to the start of the next line
+        const char* bound = begin + (end - begin) * c / numChunks;
+        bound = qMax(bound, chunkBounds[c - 1]);
+        bound = lineEnd(bound, end);
+        chunkBounds[c] = bound < end ? bound + 1 : end;
+    }
+
+    QVector<RecordCounts> chunkOffsets(numChunks + 1);
+    parallelFor(
+        0, numChunks,
+        [&](int first, int last) {
+            for (int c = first; c < last; c++) {
+                chunkOffsets[c + 1] =
+                    countRecords(chunkBounds[c], chunkBounds[c + 1]);
+            }
+        },
+        numChunks);
+
+    // Prefix sum to find the first record of every chunk
+    for (int c = 1; c <= numChunks; c++) {
+        chunkOffsets[c].vertices += chunkOffsets[c - 1].vertices;
+        chunkOffsets[c].texCoords += chunkOffsets[c - 1].texCoords;
+        chunkOffsets[c].normals += chunkOffsets[c - 1].normals;
+        chunkOffsets[c].faces += chunkOffsets[c - 1].faces;
+        chunkOffsets[c].corners += chunkOffsets[c - 1].corners;
+    }
+    allocateRecords(chunkOffsets[numChunks]);
+
+    QVector<int> chunkIgnoredLines(numChunks);
+    parallelFor(
+        0, numChunks,
+        [&](int first, int last) {
+            for (int c = first; c < last; c++) {
+                chunkIgnoredLines[c] = parseRecords(
+                    chunkBounds[c], chunkBounds[c + 1], chunkOffsets[c]);
+            }
+        },
+        numChunks);
+    for (int c = 0; c < numChunks; c++) {
+        numIgnoredLines += chunkIgnoredLines[c];
+    }
+}
+
+/**
+ * @brief OBJFile::countRecords Counts the vertex, texture, normal and face
+ * records as well as the face corners, so that all the arrays can be allocated
+ * up front.
+ * @param begin Start of the (partial) file contents.
+ * @param end End of the (partial) file contents.
+ * @return The number of records of every type.
+ */
+OBJFile::RecordCounts OBJFile::countRecords(const char* begin,
+                                            const char* end) const {
+    RecordCounts counts;
+    for (const char* p = begin; p < end; p++) {
+        const char* eol = lineEnd(p, end);
+        switch (recordType(p, eol)) {
+            case OBJRecord::Vertex:
+                counts.vertices++;
+                break;
+            case OBJRecord::TexCoords:
+                counts.texCoords++;
+                break;
+            case OBJRecord::Normal:
+                counts.normals++;
+                break;
+            case OBJRecord::Face:
+                counts.faces++;
+                counts.corners += countCorners(p, eol);
+                break;
+            case OBJRecord::Other:
+                break;
+        }
+        p = eol;
+    }
+    return counts;
+}
+
+/**
+ * @brief OBJFile::allocateRecords Allocates the arrays for all records.
+ * @param counts The number of records of every type in the file.
+ */
+void OBJFile::allocateRecords(const RecordCounts& counts) {
+    vertexCoords.resize(counts.vertices);
+    textureCoords.resize(counts.texCoords);
+    vertexNormals.resize(counts.normals);
+    faceOffsets.resize(counts.faces + 1);
+    faceOffsets[counts.faces] = counts.corners;
+    faceCoordInd.resize(counts.corners);
+    if (counts.texCoords > 0) {
+        faceTexInd.resize(counts.corners);
+    }
+    if (counts.normals > 0) {
+        faceNormalInd.resize(counts.corners);
+    }
+}
+
+/**
+ * @brief OBJFile::parseRecords Parses all records and writes them into the
+ * arrays allocated by allocateRecords. Different chunks of the file can be
+ * parsed concurrently, as they write to disjoint parts of the arrays.
+ * @param begin Start of the (partial) file contents.
+ * @param end End of the (partial) file contents.
+ * @param offsets Index of the first record of every type within this chunk.
+ * @return The number of lines that were ignored.
+ */
+int OBJFile::parseRecords(const char* begin, const char* end,
+                          const RecordCounts& offsets) {
+    int v = offsets.vertices;
+    int vt = offsets.texCoords;
+    int vn = offsets.normals;
+    int f = offsets.faces;
+    int c = offsets.corners;
+    int ignoredLines = 0;
+    for (const char* p = begin; p < end; p++) {
+        const char* eol = lineEnd(p, end);
+        const char* lineStart = p;
+        switch (recordType(p, eol)) {
+            case OBJRecord::Vertex:
+                handleVertex(p, eol, v++);
+                break;
+            case OBJRecord::TexCoords:
+                handleVertexTexCoords(p, eol, vt++);
+                break;
+            case OBJRecord::Normal:
+                handleVertexNormal(p, eol, vn++);
+                break;
+            case OBJRecord::Face:
+                c += handleFace(p, eol, f++, c);
+                break;
+            case OBJRecord::Other:
+                // Blank lines are not worth mentioning
+                if (skipSpaces(lineStart, eol) != eol) {
+                    ignoredLines++;
+                }
+                break;
+        }
+        p = eol;
+    }
+    return ignoredLines;
+}
+
 /**
  * @brief OBJFile::handleVertex Handles vertex coordinate data. Invoked when the
  * line starts with "v".
- * @param values Line contents split by whitespace.
+ * @param begin Line contents after the descriptor.
+ * @param end End of the line.
+ * @param v Index of the vertex.
  */
-void OBJFile::handleVertex(const QStringList& values) {
+void OBJFile::handleVertex(const char* begin, const char* end, int v) {
     // Only x, y and z. If there's a w value (homogenous coordinates),
     // ignore it.
-    vertexCoords.append(
-      QVector3D(values[1].toFloat(), values[2].toFloat(), values[3].toFloat()));
+    float x = parseFloat(begin, end);
+    float y = parseFloat(begin, end);
+    float z = parseFloat(begin, end);
+    vertexCoords[v] = QVector3D(x, y, z);
 }
 
 /**
  * @brief OBJFile::handleVertexTexCoords Handles vertex texture data. Invoked
  * when the line starts with "vt".
- * @param values Line contents split by whitespace.
+ * @param begin Line contents after the descriptor.
+ * @param end End of the line.
+ * @param vt Index of the texture coordinates.
  */
-void OBJFile::handleVertexTexCoords(const QStringList& values) {
+void OBJFile::handleVertexTexCoords(const char* begin, const char* end,
+                                    int vt) {
     // Only u and v. If there's a w value (barycentric coordinates), ignore
     // it, it can be retrieved from 1-u-v.
-    textureCoords.append(QVector2D(values[1].toFloat(), values[2].toFloat()));
+    float u = parseFloat(begin, end);
+    float v = parseFloat(begin, end);
+    textureCoords[vt] = QVector2D(u, v);
 }
 
 /**
  * @brief OBJFile::handleVertexNormal Handles vertex normal data. Invoked
  * when the line starts with "vn".
- * @param values Line contents split by whitespace.
+ * @param begin Line contents after the descriptor.
+ * @param end End of the line.
+ * @param vn Index of the normal.
  */
-void OBJFile::handleVertexNormal(const QStringList& values) {
-    vertexNormals.append(
-      QVector3D(values[1].toFloat(), values[2].toFloat(), values[3].toFloat()));
+void OBJFile::handleVertexNormal(const char* begin, const char* end, int vn) {
+    float x = parseFloat(begin, end);
+    float y = parseFloat(begin, end);
+    float z = parseFloat(begin, end);
+    vertexNormals[vn] = QVector3D(x, y, z);
 }
 
 /**
  * @brief OBJFile::handleFace Handles face index data. Invoked
- * when the line starts with "f".
- * @param values Line contents split by whitespace.
- */
-void OBJFile::handleFace(const QStringList& values) {
-    QVector<int> faceCoordsIndices;
-    QVector<int> faceTexIndices;
-    QVector<int> faceNormalIndices;
-    for (int k = 1; k < values.size(); k++) {
-        QStringList indices = values[k].split("/");
-
-        // Note -1, OBJ starts indexing from 1.
-        faceCoordsIndices.append(indices[0].toInt() - 1);
-
-        if (indices.size() > 1) {
-            if (!indices[1].isEmpty()) {
-                faceTexIndices.append(indices[1].toInt() - 1);
-            }
-
-            if (indices.size() > 2) {
-                if (!indices[2].isEmpty()) {
-                    faceNormalIndices.append(indices[2].toInt() - 1);
-                }
-            }
+ * when the line starts with "f". Every face corner has the form v, v/vt,
+ * v//vn or v/vt/vn.
+ * @param begin Line contents after the descriptor.
+ * @param end End of the line.
+ * @param f Index of the face.
+ * @param c Index of the first corner of the face in the flat index arrays.
+ * @return The number of corners of the face.
+ */
+int OBJFile::handleFace(const char* begin, const char* end, int f, int c) {
+    faceOffsets[f] = c;
+    int k = c;
+    for (const char* p = skipSpaces(begin, end); p < end;
+         p = skipSpaces(p, end)) {
+        const char* cornerEnd = skipToken(p, end);
+        faceCoordInd[k] = parseIndex(p, cornerEnd);
+        int texIdx = parseIndex(p, cornerEnd);
+        int normalIdx = parseIndex(p, cornerEnd);
+        if (!faceTexInd.isEmpty()) {
+            faceTexInd[k] = texIdx;
+        }
+        if (!faceNormalInd.isEmpty()) {
+            faceNormalInd[k] = normalIdx;
         }
+        p = cornerEnd;
+        k++;
     }
-    faceCoordInd.append(faceCoordsIndices);
-    faceTexIndices.append(faceTexIndices);
-    faceNormalIndices.append(faceNormalIndices);
-    faceValences.append(values.size() - 1);
+    return k - c;
 }
 
 /**
@@ -11,26 +11,48 @@
  */
 class OBJFile {
  public:
-  OBJFile(const QString& fileName);
+  OBJFile(const QString& fileName, int numThreads = 1);
   ~OBJFile();
 
   bool loadedSuccessfully() const;
   void normalizeMesh(float desiredScale);
 
  private:
-  void handleVertex(const QStringList& values);
-  void handleVertexTexCoords(const QStringList& values);
-  void handleVertexNormal(const QStringList& values);
-  void handleFace(const QStringList& values);
+  /**
+   * @brief The number of records of every type within (part of) a file. Also
+   * used to describe where the records of a chunk start in the arrays.
+   */
+  struct RecordCounts {
+    int vertices = 0;
+    int texCoords = 0;
+    int normals = 0;
+    int faces = 0;
+    int corners = 0;
+  };
+
+  void parse(const char* begin, const char* end, int numThreads);
+  RecordCounts countRecords(const char* begin, const char* end) const;
+  void allocateRecords(const RecordCounts& counts);
+  int parseRecords(const char* begin, const char* end,
+                   const RecordCounts& offsets);
+  void handleVertex(const char* begin, const char* end, int v);
+  void handleVertexTexCoords(const char* begin, const char* end, int vt);
+  void handleVertexNormal(const char* begin, const char* end, int vn);
+  int handleFace(const char* begin, const char* end, int f, int c);
 
   QVector<QVector3D> vertexCoords;
   QVector<QVector2D> textureCoords;
   QVector<QVector3D> vertexNormals;
-  QVector<int> faceValences;
-  QVector<QVector<int>> faceCoordInd;
-  QVector<QVector<int>> faceTexInd;
-  QVector<QVector<int>> faceNormalInd;
-
+  // Faces are stored as a flat table: the corners of face f are found at
+  // positions faceOffsets[f] up to faceOffsets[f + 1] of the index arrays.
+  QVector<int> faceOffsets;
+  QVector<int> faceCoordInd;
+  // Only filled when the file has texture coordinates and normals
+  // respectively. Corners without such an index hold -1.
+  QVector<int> faceTexInd;
+  QVector<int> faceNormalInd;
+
+  int numIgnoredLines;
   bool loadSuccess;
 
   friend class MeshInitializer;
@@ -0,0 +1,515 @@
+#include "plyfile.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QMatrix4x4>
+#include <QSysInfo>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "util/parallel.h"
+#include "util/util.h"
+
+#define DESIRED_SCALE 2.0
+
+static_assert(sizeof(QVector3D) == 3 * sizeof(float),
+              "Vertex coordinates are copied straight into QVector3Ds");
+
+/**
+ * @brief typeSize Retrieves the number of bytes a value of the type occupies.
+ * @param type The type.
+ * @return The size in bytes.
+ */
+static inline int typeSize(PLYType type) {
+    static const int sizes[] = {1, 1, 2, 2, 4, 4, 4, 8, 0};
+    return sizes[int(type)];
+}
+
+/**
+ * @brief readScalar Reads a single value, converting it from the byte order of
+ * the file.
+ * @param p Start of the value.
+ * @param swapBytes Whether the byte order of the file differs from that of
+ * this machine.
+ * @return The value.
+ */
+template <typename T>
+static inline double readScalar(const char* p, bool swapBytes) {
+    char bytes[sizeof(T)];
+    memcpy(bytes, p, sizeof(T));
+    if (swapBytes) {
+        std::reverse(bytes, bytes + sizeof(T));
+    }
+    T value;
+    memcpy(&value, bytes, sizeof(T));
+    return double(value);
+}
+
+/**
+ * @brief readValue Reads a single value of the provided type.
+ * @param p Start of the value.
+ * @param type The type of the value.
+ * @param swapBytes Whether the byte order of the file differs from that of
+ * this machine.
+ * @return The value.
+ */
+static inline double readValue(const char* p, PLYType type, bool swapBytes) {
+    switch (type) {
+        case PLYType::Int8:
+            return readScalar<qint8>(p, swapBytes);
+        case PLYType::UInt8:
+            return readScalar<quint8>(p, swapBytes);
+        case PLYType::Int16:
+            return readScalar<qint16>(p, swapBytes);
+        case PLYType::UInt16:
+            return readScalar<quint16>(p, swapBytes);
+        case PLYType::Int32:
+            return readScalar<qint32>(p, swapBytes);
+        case PLYType::UInt32:
+            return readScalar<quint32>(p, swapBytes);
+        case PLYType::Float32:
+            return readScalar<float>(p, swapBytes);
+        case PLYType::Float64:
+            return readScalar<double>(p, swapBytes);
+        case PLYType::Invalid:
+            break;
+    }
+    return 0.0;
+}
+
+/**
+ * @brief PLYFile::PLYFile Reads information from the provided binary .ply file
+ * and stores it in this class. The file is memory-mapped; vertex data is read
+ * with a fixed stride, or copied in bulk when it consists of just the float
+ * coordinates in the byte order of this machine. Files that cannot be mapped
+ * (such as compressed Qt resources) are read into memory first.
+ * @param fileName The path of the .ply file
+ * @param numThreads The number of threads to read large files with. The result
+ * does not depend on the number of threads.
+ */
+PLYFile::PLYFile(const QString& fileName, int numThreads) {
+    qDebug() << ":: Loading" << fileName;
+    QFile newModel(fileName);
+    swapBytes = false;
+    loadSuccess = false;
+
+    if (newModel.open(QIODevice::ReadOnly)) {
+        QByteArray buffer;
+        qint64 size = newModel.size();
+        const char* begin =
+            reinterpret_cast<const char*>(newModel.map(0, size));
+        if (begin == nullptr) {
+            buffer = newModel.readAll();
+            begin = buffer.constData();
+            size = buffer.size();
+        }
+        const char* end = begin + size;
+
+        const char* p = begin;
+        bool valid = parseHeader(p, end);
+        bool hasFaces = false;
+        for (int e = 0; valid && e < elements.size(); e++) {
+            if (elements[e].name == "vertex") {
+                valid = readVertices(p, end, elements[e], numThreads);
+            } else if (elements[e].name == "face") {
+                valid = readFaces(p, end, elements[e], numThreads);
+                hasFaces = true;
+            } else {
+                valid = skipElement(p, end, elements[e]);
+            }
+        }
+        newModel.close();
+
+        // Faces may be declared before the vertices, so the indices can only
+        // be checked once everything has been read.
+        for (int c = 0; valid && c < faceCoordInd.size(); c++) {
+            if (faceCoordInd[c] < 0 || faceCoordInd[c] >= vertexCoords.size()) {
+                qDebug() << " * Face refers to non-existent vertex"
+                         << faceCoordInd[c];
+                valid = false;
+            }
+        }
+        if (!hasFaces) {
+            faceOffsets = {0};
+        }
+        if (valid && !vertexCoords.isEmpty()) {
+            normalizeMesh(DESIRED_SCALE);
+            loadSuccess = true;
+        }
+    }
+}
+
+/**
+ * @brief PLYFile::~PLYFile Deconstructor.
+ */
+PLYFile::~PLYFile() {}
+
+/**
+ * @brief PLYFile::parseHeader Parses the text header describing the elements
+ * in the file.
+ * @param p The cursor. Is moved to the start of the binary data.
+ * @param end End of the file contents.
+ * @return True if the header describes a binary file that can be read; false
+ * otherwise.
+ */
+bool PLYFile::parseHeader(const char*& p, const char* end) {
+    static const char* typeNames[][2] = {
+        {"char", "int8"},   {"uchar", "uint8"},   {"short", "int16"},
+        {"ushort", "uint16"}, {"int", "int32"},   {"uint", "uint32"},
+        {"float", "float32"}, {"double", "float64"}};
+    auto parseType = [&](const QByteArray& name) {
+        for (int t = 0; t < 8; t++) {
+            if (name == typeNames[t][0] || name == typeNames[t][1]) {
+                return PLYType(t);
+            }
+        }
+        return PLYType::Invalid;
+    };
+
+    bool isPLY = false;
+    bool hasFormat = false;
+    while (p < end) {
+        const char* newline =
+            static_cast<const char*>(memchr(p, '\n', size_t(end - p)));
+        const char* eol = newline == nullptr ? end : newline;
+        QList<QByteArray> tokens =
+            QByteArray(p, eol - p).simplified().split(' ');
+        p = eol < end ? eol + 1 : end;
+        const QByteArray& keyword = tokens[0];
+
+        if (!isPLY) {
+            if (keyword != "ply") {
+                qDebug() << " * Not a PLY file";
+                return false;
+            }
+            isPLY = true;
+        } else if (keyword == "format" && tokens.size() >= 2) {
+            if (tokens[1] == "binary_little_endian") {
+                swapBytes = QSysInfo::ByteOrder != QSysInfo::LittleEndian;
+            } else if (tokens[1] == "binary_big_endian") {
+                swapBytes = QSysInfo::ByteOrder != QSysInfo::BigEndian;
+            } else {
+                qDebug() << " * Unsupported PLY format"
+                         << tokens[1].constData();
+                return false;
+            }
+            hasFormat = true;
+        } else if (keyword == "element" && tokens.size() == 3) {
+            PLYElement element;
+            element.name = tokens[1];
+            bool ok = false;
+            element.count = tokens[2].toLongLong(&ok);
+            if (!ok || element.count < 0) {
+                qDebug() << " * Invalid element count" << tokens[2].constData();
+                return false;
+            }
+            elements.append(element);
+        } else if (keyword == "property" && !elements.isEmpty()) {
+            PLYProperty property;
+            if (tokens.size() == 5 && tokens[1] == "list") {
+                property.isList = true;
+                property.countType = parseType(tokens[2]);
+                property.type = parseType(tokens[3]);
+                property.name = tokens[4];
+            } else if (tokens.size() == 3) {
+                property.type = parseType(tokens[1]);
+                property.name = tokens[2];
+            }
+            if (property.type == PLYType::Invalid ||
+                (property.isList && (property.countType == PLYType::Invalid ||
+                                     property.countType == PLYType::Float32 ||
+                                     property.countType == PLYType::Float64))) {
+                qDebug() << " * Invalid property declaration";
+                return false;
+            }
+            elements.last().properties.append(property);
+        } else if (keyword == "end_header") {
+            if (!hasFormat) {
+                qDebug() << " * PLY format not specified";
+            }
+            return hasFormat;
+        }
+        // Comments and obj_info lines are skipped
+    }
+    qDebug() << " * PLY header is not terminated";
+    return false;
+}
+
+/**
+ * @brief PLYFile::readVertices Reads the coordinates of all vertices. Other
+ * vertex properties, such as normals or colours, are skipped.
+ * @param p The cursor. Is moved past the vertex data.
+ * @param end End of the file contents.
+ * @param element The vertex element.
+ * @param numThreads The maximum number of threads to use.
+ * @return True if the vertices were read successfully; false otherwise.
+ */
+bool PLYFile::readVertices(const char*& p, const char* end,
+                           const PLYElement& element, int numThreads) {
+    int coordOffsets[3] = {-1, -1, -1};
+    PLYType coordTypes[3] = {PLYType::Invalid, PLYType::Invalid,
+                             PLYType::Invalid};
+    const char* coordNames[3] = {"x", "y", "z"};
+    int stride = 0;
+    bool fixedSize = true;
+    for (const PLYProperty& property : element.properties) {
+        for (int i = 0; i < 3; i++) {
+            if (!property.isList && property.name == coordNames[i]) {
+                coordOffsets[i] = stride;
+                coordTypes[i] = property.type;
+            }
+        }
+        fixedSize = fixedSize && !property.isList;
+        stride += typeSize((property.type));
+    }
+    if (coordOffsets[0] < 0 || coordOffsets[1] < 0 || coordOffsets[2] < 0) {
+        qDebug() << " * Vertices do not have x, y and z coordinates";
+        return false;
+    }
+    if (element.count > std::numeric_limits<int>::max()) {
+        qDebug() << " * Too many vertices";
+        return false;
+    }
+    int numVertices = int(element.count);
+    vertexCoords.resize(numVertices);
+    QVector3D* coords = vertexCoords.data();
+    auto readCoords = [&](const char* record) {
+        return QVector3D(
+            readValue(record + coordOffsets[0], coordTypes[0], swapBytes),
+            readValue(record + coordOffsets[1], coordTypes[1], swapBytes),
+            readValue(record + coordOffsets[2], coordTypes[2], swapBytes));
+    };
+
+    if (!fixedSize) {
+        // Lists in the vertex data are unusual, so these are simply walked
+        for (int v = 0; v < numVertices; v++) {
+            const char* recordEnd = skipRecord(p, end, element);
+            if (recordEnd == nullptr) {
+                qDebug() << " * Unexpected end of vertex data";
+                return false;
+            }
+            coords[v] = readCoords(p);
+            p = recordEnd;
+        }
+        return true;
+    }
+
+    if (qint64(numVertices) * stride > end - p) {
+        qDebug() << " * Unexpected end of vertex data";
+        return false;
+    }
+    const PLYType floatType = PLYType::Float32;
+    if (!swapBytes && stride == 3 * int(sizeof(float)) &&
+        coordOffsets[0] == 0 && coordOffsets[1] == 4 && coordOffsets[2] == 8 &&
+        coordTypes[0] == floatType && coordTypes[1] == floatType &&
+        coordTypes[2] == floatType) {
+        memcpy(coords, p, size_t(numVertices) * stride);
+    } else {
+        const char* data = p;
+        parallelFor(
+            0, numVertices,
+            [&](int first, int last) {
+                for (int v = first; v < last; v++) {
+                    coords[v] = readCoords(data + qint64(v) * stride);
+                }
+            },
+            numThreads);
+    }
+    p += qint64(numVertices) * stride;
+    return true;
+}
+
+/**
+ * @brief PLYFile::readFaces Reads the vertex indices of all faces. Faces can
+ * have any number of vertices. The records are walked once to find the number
+ * of corners of every face. If the vertex indices are the only list of a face,
+ * the position of every record follows from these counts and the indices are
+ * read in parallel; otherwise they are read during a second walk.
+ * @param p The cursor. Is moved past the face data.
+ * @param end End of the file contents.
+ * @param element The face element.
+ * @param numThreads The maximum number of threads to use.
+ * @return True if the faces were read successfully; false otherwise.
+ */
+bool PLYFile::readFaces(const char*& p, const char* end,
+                        const PLYElement& element, int numThreads) {
+    int indexProperty = -1;
+    int numLists = 0;
+    int fixedBytes = 0;
+    for (int i = 0; i < element.properties.size(); i++) {
+        const PLYProperty& property = element.properties[i];
+        if (property.isList) {
+            numLists++;
+            fixedBytes += typeSize((property.countType));
+            if (property.name == "vertex_indices" ||
+                property.name == "vertex_index") {
+                indexProperty = i;
+            }
+        } else {
+            fixedBytes += typeSize((property.type));
+        }
+    }
+    if (indexProperty < 0) {
+        qDebug() << " * Faces do not have a vertex index list";
+        return false;
+    }
+    if (element.count >= std::numeric_limits<int>::max()) {
+        qDebug() << " * Too many faces";
+        return false;
+    }
+    int numFaces = int(element.count);
+    const PLYProperty& indices = element.properties[indexProperty];
+    PLYType countType = indices.countType;
+    PLYType indexType = indices.type;
+    int indexSize = typeSize(indexType);
+
+    // The offset of the vertex index count within a record
+    int countOffset = 0;
+    for (int i = 0; i < indexProperty; i++) {
+        countOffset += typeSize((element.properties[i].type));
+    }
+
+    // First walk: count the corners of every face
+    faceOffsets.resize(numFaces + 1);
+    const char* data = p;
+    qint64 numCorners = 0;
+    for (int f = 0; f < numFaces; f++) {
+        const char* recordEnd = skipRecord(p, end, element);
+        if (recordEnd == nullptr) {
+            qDebug() << " * Unexpected end of face data";
+            return false;
+        }
+        int valence = int(readValue(p + countOffset, countType, swapBytes));
+        if (valence < 3) {
+            qDebug() << " * Face" << f << "has fewer than three vertices";
+            return false;
+        }
+        faceOffsets[f] = int(numCorners);
+        numCorners += valence;
+        if (numCorners > std::numeric_limits<int>::max()) {
+            qDebug() << " * Too many face corners";
+            return false;
+        }
+        p = recordEnd;
+    }
+    faceOffsets[numFaces] = int(numCorners);
+    faceCoordInd.resize(int(numCorners));
+
+    int* corners = faceCoordInd.data();
+    const int* offsets = faceOffsets.constData();
+    auto readIndices = [&](const char* record, int f) {
+        const char* first = record + countOffset + typeSize(countType);
+        int valence = offsets[f + 1] - offsets[f];
+        int* target = corners + offsets[f];
+        if (!swapBytes && indexSize == int(sizeof(int)) &&
+            indices.type != PLYType::Float32) {
+            memcpy(target, first, size_t(valence) * sizeof(int));
+        } else {
+            for (int i = 0; i < valence; i++) {
+                target[i] = int(readValue(first + i * indexSize, indexType,
+                                          swapBytes));
+            }
+        }
+    };
+
+    if (numLists == 1) {
+        parallelFor(
+            0, numFaces,
+            [&](int first, int last) {
+                for (int f = first; f < last; f++) {
+                    readIndices(data + qint64(f) * fixedBytes +
+                                    qint64(offsets[f]) * indexSize,
+                                f);
+                }
+            },
+            numThreads);
+    } else {
+        // Second walk: the other lists make the record positions unknown
+        const char* record = data;
+        for (int f = 0; f < numFaces; f++) {
+            readIndices(record, f);
+            record = skipRecord(record, end, element);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief PLYFile::skipElement Skips all records of an element that is not
+ * used, such as edges or materials.
+ * @param p The cursor. Is moved past the element data.
+ * @param end End of the file contents.
+ * @param element The element to skip.
+ * @return True if the element data is complete; false otherwise.
+ */
+bool PLYFile::skipElement(const char*& p, const char* end,
+                          const PLYElement& element) {
+    for (qint64 i = 0; i < element.count; i++) {
+        p = skipRecord(p, end, element);
+        if (p == nullptr) {
+            qDebug() << " * Unexpected end of" << element.name.constData()
+                     << "data";
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief PLYFile::skipRecord Finds the end of a single record of an element.
+ * @param p Start of the record.
+ * @param end End of the file contents.
+ * @param element The element the record belongs to.
+ * @return The end of the record, or nullptr if the record does not fit in the
+ * file.
+ */
+const char* PLYFile::skipRecord(const char* p, const char* end,
+                                const PLYElement& element) const {
+    for (const PLYProperty& property : element.properties) {
+        if (property.isList) {
+            int countSize = typeSize((property.countType));
+            if (countSize > end - p) {
+                return nullptr;
+            }
+            qint64 count =
+                qint64(readValue(p, property.countType, swapBytes));
+            p += countSize;
+            if (count < 0 || count * typeSize((property.type)) > end - p) {
+                return nullptr;
+            }
+            p += count * typeSize((property.type));
+        } else {
+            int size = typeSize((property.type));
+            if (size > end - p) {
+                return nullptr;
+            }
+            p += size;
+        }
+    }
+    return p;
+}
+
+/**
+ * @brief PLYFile::loadedSuccessfully Checks whether the model was loaded from
+ * the .ply successfully.
+ * @return True if the load was successful, false otherwise.
+ */
+bool PLYFile::loadedSuccessfully() const { return loadSuccess; }
+
+/**
+ * @brief PLYFile::normalizeMesh Scales the information in the ply file in such
+ * a way that the mesh fits inside a bounding box of desiredScale.
+ * @param desiredScale The desired scale.
+ */
+void PLYFile::normalizeMesh(float desiredScale) {
+    float scale = calcBoundingBoxScale(vertexCoords, desiredScale);
+    QMatrix4x4 transformMatrix;
+    transformMatrix.setToIdentity();
+    transformMatrix.scale(scale);
+    for (int i = 0; i < vertexCoords.size(); ++i) {
+        QVector3D coord =
+            QVector3D(transformMatrix * QVector4D(vertexCoords[i], 1));
+        vertexCoords[i] = coord;
+    }
+}
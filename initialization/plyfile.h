@@ -0,0 +1,82 @@
+#ifndef PLYFILE_H
+#define PLYFILE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector3D>
+#include <QVector>
+
+/**
+ * @brief The scalar types a property of a .ply file can have.
+ */
+enum class PLYType {
+  Int8,
+  UInt8,
+  Int16,
+  UInt16,
+  Int32,
+  UInt32,
+  Float32,
+  Float64,
+  Invalid
+};
+
+/**
+ * @brief The PLYFile class is used for storing info from binary .ply files.
+ * Faces are stored in the same flat table as in OBJFile, so both can be
+ * handed to the MeshInitializer.
+ */
+class PLYFile {
+ public:
+  PLYFile(const QString& fileName, int numThreads = 1);
+  ~PLYFile();
+
+  bool loadedSuccessfully() const;
+  void normalizeMesh(float desiredScale);
+
+ private:
+  /**
+   * @brief A property of an element. List properties store a count followed
+   * by that many items.
+   */
+  struct PLYProperty {
+    QByteArray name;
+    PLYType type = PLYType::Invalid;
+    // Only used by list properties
+    PLYType countType = PLYType::Invalid;
+    bool isList = false;
+  };
+
+  /**
+   * @brief An element declared in the header, such as "vertex" or "face".
+   */
+  struct PLYElement {
+    QByteArray name;
+    qint64 count = 0;
+    QVector<PLYProperty> properties;
+  };
+
+  bool parseHeader(const char*& p, const char* end);
+  bool readVertices(const char*& p, const char* end, const PLYElement& element,
+                    int numThreads);
+  bool readFaces(const char*& p, const char* end, const PLYElement& element,
+                 int numThreads);
+  bool skipElement(const char*& p, const char* end, const PLYElement& element);
+  const char* skipRecord(const char* p, const char* end,
+                         const PLYElement& element) const;
+
+  QVector<QVector3D> vertexCoords;
+  // Faces are stored as a flat table: the corners of face f are found at
+  // positions faceOffsets[f] up to faceOffsets[f + 1] of faceCoordInd.
+  QVector<int> faceOffsets;
+  QVector<int> faceCoordInd;
+
+  QVector<PLYElement> elements;
+  // Whether the byte order of the file differs from that of this machine
+  bool swapBytes;
+  bool loadSuccess;
+
+  friend class MeshInitializer;
+};
+
+#endif  // PLYFILE_H
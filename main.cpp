@@ -2,14 +2,24 @@
 #include <QSurfaceFormat>
 
 #include "mainwindow.h"
+#include "util/benchmark.h"
 
 /**
- * @brief main Starts up the QT application and UI.
+ * @brief main Starts up the QT application and UI. Runs the benchmarks instead
+ * when started with the --benchmark argument.
  * @param argc Argument count.
  * @param argv Arguments.
  * @return Exit code.
  */
 int main(int argc, char *argv[]) {
+    // Running the benchmarks does not require a window.
+    for (int i = 1; i < argc; i++) {
+        if (QString(argv[i]) == "--benchmark") {
+            runBenchmarks();
+            return 0;
+        }
+    }
+
     QApplication a(argc, argv);
 
     QSurfaceFormat glFormat;
@@ -100,6 +100,15 @@ void MainView::updateMatrices() {
  */
 void MainView::updateBuffers(Mesh& mesh) {
     mesh.extractAttributes();
+    uploadBuffers(mesh);
+}
+
+/**
+ * @brief MainView::uploadBuffers Updates the buffers of the renderers with
+ * attributes that have already been extracted from the mesh.
+ * @param mesh The mesh used to update the buffer content with.
+ */
+void MainView::uploadBuffers(Mesh& mesh) {
     meshRenderer.updateBuffers(mesh);
     tessellationRenderer.updateBuffers(mesh);
     regularPatchTessellationRenderer.updateBuffers(mesh);
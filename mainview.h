@@ -27,6 +27,7 @@ class MainView : public QOpenGLWidget, protected QOpenGLFunctions_4_1_Core {
   void updateMatrices();
   void updateUniforms();
   void updateBuffers(Mesh& currentMesh);
+  void uploadBuffers(Mesh& currentMesh);
   void updateRegularMesh(Mesh currentMesh);
 
 
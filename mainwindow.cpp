@@ -1,7 +1,9 @@
 #include "mainwindow.h"
 
-#include "initialization/meshinitializer.h"
-#include "initialization/objfile.h"
+#include <QDebug>
+#include <QStatusBar>
+#include <QThread>
+
 #include "subdivision/catmullclarksubdivider.h"
 #include "subdivision/subdivider.h"
 #include "ui_mainwindow.h"
@@ -14,6 +16,10 @@ MainWindow::MainWindow(QWidget* parent)
     : QMainWindow(parent), ui(new Ui::MainWindow) {
 
     ui->setupUi(this);
+    connect(&meshImporter, &MeshImporter::progressChanged, this,
+            &MainWindow::onImportProgress);
+    connect(&meshImporter, &MeshImporter::finished, this,
+            &MainWindow::onImportFinished);
     ui->MeshGroupBox->setEnabled(ui->MainDisplay->settings.modelLoaded);
     ui->renderSettingsGroupBox->setEnabled(ui->MainDisplay->settings.modelLoaded);
     ui->tessSettingsGB->setVisible(
@@ -30,19 +36,58 @@ MainWindow::~MainWindow() {
 }
 
 /**
- * @brief MainWindow::importOBJ Imports an obj file and adds the constructed
- * half-edge to the collection of meshes.
- * @param fileName Path of the .obj file.
+ * @brief MainWindow::importOBJ Starts importing an obj or binary ply file in
+ * the background. The loader is picked based on the file extension. Any import
+ * that is still running is cancelled. Once the import has finished, the
+ * constructed half-edge mesh is added to the collection of meshes by
+ * onImportFinished.
+ * @param fileName Path of the .obj or .ply file.
  */
 void MainWindow::importOBJ(const QString& fileName) {
-    OBJFile newModel = OBJFile(fileName);
-    meshes.clear();
-    meshes.squeeze();
+    // Release the previous control mesh before loading, so it does not add to
+    // the peak memory usage. The subdivided levels go back to the level pool,
+    // so subdividing the new model can reuse their buffers.
+    limitProjectionMesh = Mesh();
+    levelPool.recycleLevels(meshes);
+    qDebug() << ":: Subdivision level pool holds"
+             << levelPool.memoryUsage() / (1024.0 * 1024.0) << "MB";
+
+    ui->MainDisplay->settings.modelLoaded = false;
+    ui->MeshGroupBox->setEnabled(false);
+    ui->renderSettingsGroupBox->setEnabled(false);
+    ui->SubdivSteps->setValue(0);
+    ui->MainDisplay->update();
+
+    meshImporter.import(fileName);
+}
 
-    if (newModel.loadedSuccessfully()) {
-        MeshInitializer meshInitializer;
-        meshes.append(meshInitializer.constructHalfEdgeMesh(newModel));
-        ui->MainDisplay->updateBuffers(meshes[0]);
+/**
+ * @brief MainWindow::onImportProgress Shows the progress of the current import
+ * in the status bar.
+ * @param percentage Estimate of how far along the import is.
+ * @param stage Description of the stage the import is in.
+ */
+void MainWindow::onImportProgress(int percentage, const QString& stage) {
+    statusBar()->showMessage(QString("%1 (%2%)").arg(stage).arg(percentage));
+}
+
+/**
+ * @brief MainWindow::onImportFinished Adds the imported mesh to the collection
+ * of meshes and uploads it to the renderers.
+ * @param success Whether the import was successful.
+ */
+void MainWindow::onImportFinished(bool success) {
+    if (success) {
+        meshes.append(meshImporter.takeMesh());
+        // The cached topologies are only of use to a model with the same
+        // connectivity, such as a reloaded one
+        quint64 fingerprint = meshes[0].topologyFingerprint();
+        if (fingerprint != cachedFingerprint) {
+            topologyCache.clear();
+            cachedFingerprint = fingerprint;
+        }
+        // The attributes were already extracted by the importer
+        ui->MainDisplay->uploadBuffers(meshes[0]);
         ui->TessellationCheckBox->setChecked(false);
         ui->limitProjectioncheckBox->setChecked(false);
         ui->HideMeshCheckBox->setChecked(false);
@@ -51,11 +96,11 @@ void MainWindow::importOBJ(const QString& fileName) {
         ui->MainDisplay->settings.modelLoaded = true;
     } else {
         ui->MainDisplay->settings.modelLoaded = false;
+        statusBar()->showMessage("Import failed");
     }
 
     ui->MeshGroupBox->setEnabled(ui->MainDisplay->settings.modelLoaded);
     ui->renderSettingsGroupBox->setEnabled(ui->MainDisplay->settings.modelLoaded);
-    ui->SubdivSteps->setValue(0);
 
     ui->outerTessLevel0->setValue(4);
     ui->outerTessLevel1->setValue(4);
@@ -72,7 +117,7 @@ void MainWindow::importOBJ(const QString& fileName) {
 
 void MainWindow::on_LoadOBJ_pressed() {
     QString filename = QFileDialog::getOpenFileName(
-      this, "Import OBJ File", "../", tr("Obj Files (*.obj)"));
+      this, "Import Mesh File", "../", tr("Mesh Files (*.obj *.ply)"));
     importOBJ(filename);
 }
 
@@ -82,12 +127,29 @@ void MainWindow::on_MeshPresetComboBox_currentTextChanged(
 }
 
 void MainWindow::on_SubdivSteps_valueChanged(int value) {
-    Subdivider* subdivider = new CatmullClarkSubdivider();
+    if (meshes.isEmpty()) {
+        return;
+    }
+    CatmullClarkSubdivider subdivider(
+        CatmullClarkSubdivider::VertexLayout::Canonical,
+        QThread::idealThreadCount());
+    // Models with the same connectivity as one subdivided before, such as a
+    // reloaded model, only need their positions computed
+    subdivider.setTopologyCache(&topologyCache);
     for (int k = meshes.size() - 1; k < value; k++) {
-        meshes.append(subdivider->subdivide(meshes[k]));
+        // The one-rings of the level are also used by the limit projection
+        meshes[k].buildAdjacency();
+        // Reuses the buffers of this level if it was subdivided before
+        Mesh newMesh = levelPool.acquire(k + 1);
+        subdivider.subdivide(meshes[k], newMesh);
+        meshes.append(std::move(newMesh));
     }
+    qDebug() << ":: Topology cache hit rate" << topologyCache.hitRate() << "("
+             << topologyCache.numHits() << "hits," << topologyCache.numMisses()
+             << "misses)";
+    qDebug() << " * Topology cache holds"
+             << topologyCache.memoryUsage() / (1024.0 * 1024.0) << "MB";
     ui->MainDisplay->updateBuffers(meshes[value]);
-    delete subdivider;
     if(ui->MainDisplay->settings.showLimitProjection){
         on_limitProjectioncheckBox_toggled(true);
     }
@@ -173,6 +235,7 @@ void MainWindow::on_limitProjectioncheckBox_toggled(bool checked)
     ui->MainDisplay->settings.showLimitProjection = checked;
     if (checked){
         Subdivider* subdivider = new LimitPositionSubdivider();
+        meshes[ui->SubdivSteps->value()].buildAdjacency();
         limitProjectionMesh = subdivider->subdivide(meshes[ui->SubdivSteps->value()]);
         ui->MainDisplay->updateBuffers(limitProjectionMesh);
         delete subdivider;
@@ -4,9 +4,12 @@
 #include <QFileDialog>
 #include <QMainWindow>
 
+#include "initialization/meshimporter.h"
 #include "mesh/mesh.h"
-#include "subdivision/subdivider.h"
 #include "subdivision/limitprojectionsubdivider.h"
+#include "subdivision/meshlevelpool.h"
+#include "subdivision/subdivider.h"
+#include "subdivision/topologycache.h"
 
 
 namespace Ui {
@@ -51,12 +54,20 @@ class MainWindow : public QMainWindow {
 
   void on_limitProjectioncheckBox_toggled(bool checked);
 
+  void onImportProgress(int percentage, const QString &stage);
+  void onImportFinished(bool success);
+
 private:
   void importOBJ(const QString &fileName);
 
   Ui::MainWindow *ui;
+  MeshImporter meshImporter;
   Subdivider *subdivider;
   QVector<Mesh> meshes;
+  MeshLevelPool levelPool;
+  TopologyCache topologyCache;
+  // The topology fingerprint of the control mesh the cache was filled for
+  quint64 cachedFingerprint = 0;
   Mesh limitProjectionMesh;
 };
 
@@ -1,26 +1,24 @@
 #ifndef FACE
 #define FACE
 
-#include <QVector3D>
-
-// Forward declaration
-class HalfEdge;
+#include <QtGlobal>
 
 /**
- * @brief The Face class represent the face data in the half-edge mesh.
+ * @brief The Face class represent the face data in the half-edge mesh. The
+ * side is stored as an index into the half-edges of the mesh. Only polygonal
+ * meshes store their faces; the faces of quad meshes follow from the half-edges
+ * (see Mesh::isQuadMesh).
  */
 class Face {
  public:
   Face();
-  Face(HalfEdge* side, int valence, int index);
-  void recalculateNormal();
-  QVector3D computeNormal() const;
+  Face(int side, int valence);
   void debugInfo() const;
 
-  HalfEdge* side;
+  int side;
   int valence;
-  int index;
-  QVector3D normal;
 };
 
+Q_DECLARE_TYPEINFO(Face, Q_RELOCATABLE_TYPE);
+
 #endif  // FACE
@@ -1,39 +1,43 @@
 #ifndef HALFEDGE
 #define HALFEDGE
 
-// Forward declarations
-class Vertex;
-class Face;
+#include <QtGlobal>
+#include <cstddef>
 
 /**
  * @brief The HalfEdge class represents a directed edge. Each non-boundary edge
- * consists of two half-edges. If the half-edge belongs to a boundary edge, the
- * twin will be a nullpointer.
+ * consists of two half-edges. All connections are stored as 32-bit indices
+ * into the vectors of the mesh, so half-edges can be copied and moved around
+ * freely. If the half-edge belongs to a boundary edge, the twin will be -1.
+ * Only the connections that cannot be derived from the layout of the mesh are
+ * stored here; the next, previous and face of a half-edge are retrieved with
+ * Mesh::nextIdx, Mesh::prevIdx and Mesh::faceIdx.
  */
 class HalfEdge {
  public:
   HalfEdge();
-  HalfEdge(int index);
-  HalfEdge(Vertex* origin, HalfEdge* next, HalfEdge* prev, HalfEdge* twin,
-           Face* polygon, int index);
+  HalfEdge(int origin, int twin, int edgeIndex);
 
   void debugInfo() const;
-  int nextIdx() const;
-  int prevIdx() const;
-  int twinIdx() const;
-  int faceIdx() const;
-  int edgeIdx() const;
+  inline int originIdx() const { return origin; }
+  inline int twinIdx() const { return twin; }
+  inline int edgeIdx() const { return edgeIndex; }
 
-  bool isBoundaryEdge() const;
-
-  Vertex* origin;
-  HalfEdge* next;
-  HalfEdge* prev;
-  HalfEdge* twin;
-  Face* face;
-  int index;
+  inline bool isBoundaryEdge() const { return twin < 0; }
 
+  int origin;
+  int twin;
   int edgeIndex;
 };
 
+Q_DECLARE_TYPEINFO(HalfEdge, Q_RELOCATABLE_TYPE);
+
+// The refinement kernels read the half-edges as an array of three ints each
+static_assert(sizeof(HalfEdge) == 3 * sizeof(int),
+              "HalfEdge must consist of exactly three ints");
+static_assert(offsetof(HalfEdge, origin) == 0 &&
+                  offsetof(HalfEdge, twin) == sizeof(int) &&
+                  offsetof(HalfEdge, edgeIndex) == 2 * sizeof(int),
+              "HalfEdge must store its origin, twin and edge index in order");
+
 #endif  // HALFEDGE
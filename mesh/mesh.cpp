@@ -16,18 +16,207 @@ Mesh::Mesh() {}
 Mesh::~Mesh() {
     vertices.clear();
     vertices.squeeze();
+    positions.clear();
     halfEdges.clear();
     halfEdges.squeeze();
+    halfEdgeNexts.clear();
+    halfEdgeNexts.squeeze();
+    halfEdgeFaces.clear();
+    halfEdgeFaces.squeeze();
     faces.clear();
     faces.squeeze();
 }
 
 /**
- * @brief Mesh::recalculateNormals Recalculates the face and vertex normals.
+ * @brief Mesh::polygonPrevIdx Retrieves the index of the previous half-edge in
+ * a polygonal mesh by walking around the face of the half-edge.
+ * @param h Index of the half-edge.
+ * @return The index of the previous half-edge.
+ */
+int Mesh::polygonPrevIdx(int h) const {
+    int prev = h;
+    int next = halfEdgeNexts[h];
+    while (next != h) {
+        prev = next;
+        next = halfEdgeNexts[next];
+    }
+    return prev;
+}
+
+/**
+ * @brief Mesh::nextBoundaryHalfEdge Every boundary vertex should have two
+ * connecting boundary half-edges (provided the mesh is manifold). One of those
+ * originates from this vertex, the other one points to this vertex. This
+ * function retrieves the one that originates from this vertex. It does so by
+ * following the twin->next loop. Only works if this vertex is a boundary
+ * vertex.
+ * @param v Index of the vertex.
+ * @return Index of a boundary half-edge that originates from this vertex.
+ */
+int Mesh::nextBoundaryHalfEdge(int v) const {
+    int h = vertices[v].out;
+    while (!isBoundaryEdge(h)) {
+        h = nextIdx(twinIdx(h));
+    }
+    return h;
+}
+
+/**
+ * @brief Mesh::prevBoundaryHalfEdge Every boundary vertex should have two
+ * connecting boundary half-edges (provided the mesh is manifold). One of those
+ * originates from this vertex, the other one points to this vertex. This
+ * function retrieves the boundary half-edge that points to this vertex. It does
+ * so by following the prev->twin loop. Only works if this vertex is a boundary
+ * vertex.
+ * @param v Index of the vertex.
+ * @return Index of a boundary half-edge that points to this vertex.
+ */
+int Mesh::prevBoundaryHalfEdge(int v) const {
+    int h = prevIdx(vertices[v].out);
+    while (!isBoundaryEdge(h)) {
+        h = prevIdx(twinIdx(h));
+    }
+    return h;
+}
+
+/**
+ * @brief Mesh::isBoundaryVertex Determines whether a vertex lies on a boundary
+ * or not. Uses the adjacency cache if it has been built.
+ * @param v Index of the vertex.
+ * @return True if the vertex lies on a boundary; false otherwise.
+ */
+bool Mesh::isBoundaryVertex(int v) const {
+    if (adjacency.isValid()) {
+        return adjacency.isBoundary(v);
+    }
+    int h = vertices[v].out;
+    if (isBoundaryEdge(h)) {
+        return true;
+    }
+    int hNext = nextIdx(twinIdx(h));
+    while (hNext != h) {
+        if (isBoundaryEdge(hNext)) {
+            return true;
+        }
+        hNext = nextIdx(twinIdx(hNext));
+    }
+    return false;
+}
+
+/**
+ * @brief Mesh::recalculateValence Recalculates the valence of a vertex, which
+ * is the number of edges connected to it. Uses the adjacency cache if it has
+ * been built.
+ * @param v Index of the vertex.
+ */
+void Mesh::recalculateValence(int v) {
+    topologyHash = 0;
+    if (adjacency.isValid()) {
+        vertices[v].valence = adjacency.numNeighbors(v);
+        return;
+    }
+    // A walk around a boundary vertex starts at its outgoing boundary half-edge
+    // and ends at the incoming one, which adds one more edge.
+    int start = isBoundaryVertex(v) ? nextBoundaryHalfEdge(v) : vertices[v].out;
+    int h = start;
+    int n = 0;
+    while (h >= 0) {
+        n++;
+        int prev = prevIdx(h);
+        if (isBoundaryEdge(prev)) {
+            n++;
+            break;
+        }
+        h = twinIdx(prev);
+        if (h == start) {
+            break;
+        }
+    }
+    vertices[v].valence = n;
+}
+
+/**
+ * @brief Mesh::buildAdjacency Builds the adjacency cache, unless it is still
+ * valid. Traversals of the one-rings of vertices use the cache from then on,
+ * until the topology of the mesh is modified.
+ */
+void Mesh::buildAdjacency() {
+    if (!adjacency.isValid()) {
+        adjacency.build(*this);
+    }
+}
+
+/**
+ * @brief hashWords Adds a sequence of integers to an FNV-1a hash.
+ * @param hash The hash so far.
+ * @param words The integers to add.
+ * @param count The number of integers.
+ * @return The updated hash.
+ */
+static quint64 hashWords(quint64 hash, const int* words, int count) {
+    for (int i = 0; i < count; i++) {
+        hash = (hash ^ quint32(words[i])) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Mesh::topologyFingerprint Retrieves a hash of the topology of the
+ * mesh, which is the same for meshes with the same connectivity regardless of
+ * their positions. The hash is computed once and kept until the topology is
+ * modified, so it takes linear time only the first time.
+ * @return The fingerprint, which is never zero.
+ */
+quint64 Mesh::topologyFingerprint() {
+    if (topologyHash != 0) {
+        return topologyHash;
+    }
+    // The vertices, half-edges and faces consist of ints only
+    int sizes[] = {numVerts(), numHalfEdges(), numFaces(), edgeCount,
+                   quadTopology ? 1 : 0};
+    quint64 hash = hashWords(0xcbf29ce484222325ULL, sizes, 5);
+    hash = hashWords(hash, reinterpret_cast<const int*>(vertices.constData()),
+                     2 * vertices.size());
+    hash = hashWords(hash, reinterpret_cast<const int*>(halfEdges.constData()),
+                     3 * halfEdges.size());
+    hash = hashWords(hash, halfEdgeNexts.constData(), halfEdgeNexts.size());
+    hash = hashWords(hash, halfEdgeFaces.constData(), halfEdgeFaces.size());
+    hash = hashWords(hash, reinterpret_cast<const int*>(faces.constData()),
+                     2 * faces.size());
+    hash = hashWords(hash, canonicalVertices.constData(),
+                     canonicalVertices.size());
+    topologyHash = hash == 0 ? 1 : hash;
+    return topologyHash;
+}
+
+/**
+ * @brief Mesh::computeFaceNormal Computes the normal of a face. Note that this
+ * will not give the most accurate normal for non-planar faces.
+ * @param f Index of the face.
+ * @return The normal of the face.
+ */
+QVector3D Mesh::computeFaceNormal(int f) const {
+    int side = sideIdx(f);
+    QVector3D pPrev = positions.at(originIdx(prevIdx(side)));
+    QVector3D pCur = positions.at(originIdx(side));
+    QVector3D pNext = positions.at(originIdx(nextIdx(side)));
+
+    QVector3D edgeA = pPrev - pCur;
+    QVector3D edgeB = pNext - pCur;
+
+    QVector3D faceNormal = QVector3D::crossProduct(edgeB, edgeA);
+    // don't use normalized, since this presents issues with small numbers
+    return faceNormal / faceNormal.length();
+}
+
+/**
+ * @brief Mesh::recalculateNormals Recalculates the vertex normals. The face
+ * normals are only needed while doing so.
  */
 void Mesh::recalculateNormals() {
+    QVector<QVector3D> faceNormals(numFaces());
     for (int f = 0; f < numFaces(); f++) {
-        faces[f].recalculateNormal();
+        faceNormals[f] = computeFaceNormal(f);
     }
 
     vertexNormals.clear();
@@ -35,10 +224,10 @@ void Mesh::recalculateNormals() {
 
     // normal computation
     for (int h = 0; h < numHalfEdges(); ++h) {
-        HalfEdge* edge = &halfEdges[h];
-        QVector3D pPrev = edge->prev->origin->coords;
-        QVector3D pCur = edge->origin->coords;
-        QVector3D pNext = edge->next->origin->coords;
+        int origin = originIdx(h);
+        QVector3D pPrev = positions.at(originIdx(prevIdx(h)));
+        QVector3D pCur = positions.at(origin);
+        QVector3D pNext = positions.at(originIdx(nextIdx(h)));
 
         QVector3D edgeA = (pPrev - pCur);
         QVector3D edgeB = (pNext - pCur);
@@ -47,8 +236,8 @@ void Mesh::recalculateNormals() {
         float edgeDot = QVector3D::dotProduct(edgeA, edgeB) / edgeLengths;
         float angle = sqrt(1 - edgeDot * edgeDot);
 
-        vertexNormals[edge->origin->index] +=
-            (angle * edge->face->normal) / edgeLengths;
+        vertexNormals[origin] +=
+            (angle * faceNormals[faceIdx(h)]) / edgeLengths;
     }
 
     for (int v = 0; v < numVerts(); ++v) {
@@ -63,19 +252,23 @@ void Mesh::recalculateNormals() {
 void Mesh::extractAttributes() {
     recalculateNormals();
 
-    vertexCoords.clear();
-    vertexCoords.reserve(vertices.size());
-    for (int v = 0; v < vertices.size(); v++) {
-        vertexCoords.append(vertices[v].coords);
+    // Interleave the coordinate arrays for the vertex buffer
+    vertexCoords.resize(numVerts());
+    QVector3D* coords = vertexCoords.data();
+    const float* x = positions.x();
+    const float* y = positions.y();
+    const float* z = positions.z();
+    for (int v = 0; v < numVerts(); v++) {
+        coords[v] = QVector3D(x[v], y[v], z[v]);
     }
 
     polyIndices.clear();
-    polyIndices.reserve(halfEdges.size());
-    for (int f = 0; f < faces.size(); f++) {
-        HalfEdge* currentEdge = faces[f].side;
-        for (int m = 0; m < faces[f].valence; m++) {
-            polyIndices.append(currentEdge->origin->index);
-            currentEdge = currentEdge->next;
+    polyIndices.reserve(numHalfEdges() + numFaces());
+    for (int f = 0; f < numFaces(); f++) {
+        int currentEdge = sideIdx(f);
+        for (int m = 0; m < faceValence(f); m++) {
+            polyIndices.append(originIdx(currentEdge));
+            currentEdge = nextIdx(currentEdge);
         }
         // append MAX_INT to signify end of face
         polyIndices.append(INT_MAX);
@@ -83,15 +276,14 @@ void Mesh::extractAttributes() {
     polyIndices.squeeze();
 
     quadIndices.clear();
-    quadIndices.reserve(halfEdges.size() + faces.size());
-    for (int k = 0; k < faces.size(); k++) {
-        Face* face = &faces[k];
-        HalfEdge* currentEdge = face->side;
+    quadIndices.reserve(numHalfEdges());
+    for (int k = 0; k < numFaces(); k++) {
+        int currentEdge = sideIdx(k);
         // Checks if it is a quad with valency 4
-        if (face->valence == 4) {
-            for (int m = 0; m < face->valence; m++) {
-                quadIndices.append(currentEdge->origin->index);
-                currentEdge = currentEdge->next;
+        if (faceValence(k) == 4) {
+            for (int m = 0; m < 4; m++) {
+                quadIndices.append(originIdx(currentEdge));
+                currentEdge = nextIdx(currentEdge);
             }
         }
     }
@@ -105,54 +297,53 @@ void Mesh::extractAttributes() {
  */
 void Mesh::updateRegularQuadIndices(){
     regularQuadIndices.clear();
-    for (int k = 0; k < faces.size(); k++)
+    for (int k = 0; k < numFaces(); k++)
     {
-        Face* face = &faces[k];
-        HalfEdge* currentEdge = face->side;
+        int currentEdge = sideIdx(k);
 
         // Checks if it is a quad with valency 4
-        if (face->valence == 4 && !currentEdge->isBoundaryEdge())
+        if (faceValence(k) == 4 && !isBoundaryEdge(currentEdge))
         {
              QVector<unsigned int> subsetQuadIndices;
              subsetQuadIndices.reserve(16);
              bool saveIndices = true;
-             for (int m = 0; m < face->valence; m++)
+             for (int m = 0; m < 4; m++)
              {
                 if (!isEdgeRegularCandidate(currentEdge)){
                     saveIndices = false;
                     break;
                 }
                 // Append the index of vertex
-                subsetQuadIndices.append(currentEdge->origin->index);
+                subsetQuadIndices.append(originIdx(currentEdge));
 
                 // Extracting patch boundary vertex index
-                HalfEdge* intermEdge = currentEdge->twin->next->next;
+                int intermEdge = nextIdx(nextIdx(twinIdx(currentEdge)));
 
                 if (!isEdgeRegularCandidate(intermEdge)){
                     saveIndices = false;
                     break;
                 }
                 // Append the index of vertex
-                subsetQuadIndices.append(intermEdge->origin->index);
+                subsetQuadIndices.append(originIdx(intermEdge));
 
-                intermEdge = intermEdge->next;
+                intermEdge = nextIdx(intermEdge);
                 if (!isEdgeRegularCandidate(intermEdge)){
                     saveIndices = false;
                     break;
                 }
                 // Append the index of vertex
-                subsetQuadIndices.append(intermEdge->origin->index);
+                subsetQuadIndices.append(originIdx(intermEdge));
 
-                intermEdge = intermEdge->twin->next->next;
+                intermEdge = nextIdx(nextIdx(twinIdx(intermEdge)));
                 if (!isEdgeRegularCandidate(intermEdge)){
                     saveIndices = false;
                     break;
                 }
                 // Append the index of vertex
-                subsetQuadIndices.append(intermEdge->origin->index);
+                subsetQuadIndices.append(originIdx(intermEdge));
 
                 // Update the currentEdge
-                currentEdge = currentEdge->next;
+                currentEdge = nextIdx(currentEdge);
              }
              if (saveIndices){
                 QVector<unsigned int> newSubsetQuadIndices = orderQuadIndices(subsetQuadIndices);
@@ -167,11 +358,12 @@ void Mesh::updateRegularQuadIndices(){
  * @brief Mesh::isEdgeRegularCandidate Checks if the given edge
  * is a candidate to be part of regularQuadIndices by making sure
  * valence of it's vertex is 4 and it is not a boundary edge.
+ * @param h Index of the half-edge.
  * @return True or False.
  */
-bool Mesh::isEdgeRegularCandidate(HalfEdge* intermEdge){
+bool Mesh::isEdgeRegularCandidate(int h) const {
 
-    if (intermEdge->origin->valence !=4 || intermEdge->isBoundaryEdge())
+    if (vertices[originIdx(h)].valence != 4 || isBoundaryEdge(h))
         return false;
     else
         return true;
@@ -204,26 +396,76 @@ QVector<unsigned int> Mesh::orderQuadIndices(QVector<unsigned int> oldQuadIndice
 
     return newQuadIndices;
 }
+/**
+ * @brief Mesh::clear Removes all elements and attributes from the mesh. Unlike
+ * the destructor, the allocated memory is kept, so the mesh can be filled again
+ * without allocating.
+ */
+void Mesh::clear() {
+    vertices.clear();
+    positions.resize(0);
+    halfEdges.clear();
+    halfEdgeNexts.clear();
+    halfEdgeFaces.clear();
+    faces.clear();
+    quadTopology = false;
+    canonicalVertices.clear();
+    layoutVertices.clear();
+    edgeCount = 0;
+    adjacency.invalidate();
+    edgeHalfEdges.clear();
+    topologyHash = 0;
+
+    vertexCoords.clear();
+    vertexNormals.clear();
+    polyIndices.clear();
+    quadIndices.clear();
+    regularQuadIndices.clear();
+}
+
+/**
+ * @brief Mesh::memoryUsage Retrieves the amount of memory allocated by the
+ * mesh, including unused capacity.
+ * @return The number of bytes allocated by the mesh.
+ */
+qint64 Mesh::memoryUsage() const {
+    return vertices.capacity() * qint64(sizeof(Vertex)) +
+           positions.memoryUsage() +
+           halfEdges.capacity() * qint64(sizeof(HalfEdge)) +
+           (halfEdgeNexts.capacity() + halfEdgeFaces.capacity() +
+            canonicalVertices.capacity() + layoutVertices.capacity() +
+            edgeHalfEdges.capacity()) *
+               qint64(sizeof(int)) +
+           faces.capacity() * qint64(sizeof(Face)) + adjacency.memoryUsage() +
+           (vertexCoords.capacity() + vertexNormals.capacity()) *
+               qint64(sizeof(QVector3D)) +
+           (polyIndices.capacity() + quadIndices.capacity() +
+            regularQuadIndices.capacity()) *
+               qint64(sizeof(unsigned int));
+}
+
 /**
  * @brief Mesh::numVerts Retrieves the number of vertices.
  * @return The number of vertices.
  */
-int Mesh::numVerts() { return vertices.size(); }
+int Mesh::numVerts() const { return vertices.size(); }
 
 /**
  * @brief Mesh::numHalfEdges Retrieves the number of half-edges.
  * @return The number of half-edges.
  */
-int Mesh::numHalfEdges() { return halfEdges.size(); }
+int Mesh::numHalfEdges() const { return halfEdges.size(); }
 
 /**
  * @brief Mesh::numFaces Retrieves the number of faces.
  * @return The number of faces.
  */
-int Mesh::numFaces() { return faces.size(); }
+int Mesh::numFaces() const {
+    return quadTopology ? halfEdges.size() / 4 : faces.size();
+}
 
 /**
  * @brief Mesh::numEdges Retrieves the number of edges.
  * @return The number of edges.
  */
-int Mesh::numEdges() { return edgeCount; }
+int Mesh::numEdges() const { return edgeCount; }
@@ -6,19 +6,59 @@
 #include "face.h"
 #include "halfedge.h"
 #include "vertex.h"
+#include "vertexadjacency.h"
+#include "vertexpositions.h"
 
 /**
  * @brief The Mesh class Representation of a mesh using the half-edge data
- * structure.
+ * structure. Vertices, half-edges and faces refer to each other by their index,
+ * so meshes can be copied like any other value. The vertex positions are kept
+ * apart from the topology in separate x, y and z arrays.
+ *
+ * A mesh is either polygonal or a quad mesh. Polygonal meshes store the next
+ * half-edge and face of every half-edge, and the side and valence of every
+ * face. Quad meshes, such as those produced by subdivision, store their
+ * half-edges face by face: the half-edges of face f are 4f up to 4f + 3. The
+ * next, previous and face of a half-edge then follow from its index, so only
+ * the origin, twin and edge index are stored.
  */
 class Mesh {
  public:
   Mesh();
+  Mesh(const Mesh& other) = default;
+  Mesh(Mesh&& other) = default;
   ~Mesh();
 
-  inline QVector<Vertex>& getVertices() { return vertices; }
-  inline QVector<HalfEdge>& getHalfEdges() { return halfEdges; }
-  inline QVector<Face>& getFaces() { return faces; }
+  Mesh& operator=(const Mesh& other) = default;
+  Mesh& operator=(Mesh&& other) = default;
+
+  // Non-const access to the topology invalidates the adjacency cache and the
+  // topology fingerprint
+  inline QVector<Vertex>& getVertices() {
+    adjacency.invalidate();
+    topologyHash = 0;
+    return vertices;
+  }
+  inline QVector<HalfEdge>& getHalfEdges() {
+    adjacency.invalidate();
+    topologyHash = 0;
+    return halfEdges;
+  }
+  inline QVector<Face>& getFaces() {
+    adjacency.invalidate();
+    topologyHash = 0;
+    return faces;
+  }
+  inline VertexPositions& getPositions() { return positions; }
+  inline const VertexPositions& getPositions() const { return positions; }
+  inline QVector3D position(int v) const { return positions.at(v); }
+
+  void buildAdjacency();
+  quint64 topologyFingerprint();
+  // Retrieves the one-ring cache, or nullptr if it has not been built
+  inline const VertexAdjacency* getAdjacency() const {
+    return adjacency.isValid() ? &adjacency : nullptr;
+  }
 
   inline QVector<QVector3D>& getVertexCoords() { return vertexCoords; }
   inline QVector<QVector3D>& getVertexNorms() { return vertexNormals; }
@@ -27,17 +67,68 @@ class Mesh {
   inline QVector<unsigned int>& getRegularQuadIndices() { return regularQuadIndices; }
 
 
+  inline bool isQuadMesh() const { return quadTopology; }
+
+  // Maps a vertex to its index in the canonical vertex layout of subdivided
+  // levels, which differs from its own index in face-major levels
+  inline int canonicalVertexIdx(int v) const {
+    return canonicalVertices.isEmpty() ? v : canonicalVertices[v];
+  }
+  inline const QVector<int>& getCanonicalVertexIndices() const {
+    return canonicalVertices;
+  }
+
+  // Traversal helpers. All elements are referred to by their index.
+  inline int originIdx(int h) const { return halfEdges[h].origin; }
+  inline int nextIdx(int h) const {
+    if (quadTopology) {
+      return (h & 3) == 3 ? h - 3 : h + 1;
+    }
+    return halfEdgeNexts[h];
+  }
+  inline int prevIdx(int h) const {
+    if (quadTopology) {
+      return (h & 3) == 0 ? h + 3 : h - 1;
+    }
+    return polygonPrevIdx(h);
+  }
+  inline int twinIdx(int h) const { return halfEdges[h].twin; }
+  inline int faceIdx(int h) const {
+    return quadTopology ? h >> 2 : halfEdgeFaces[h];
+  }
+  inline int edgeIdx(int h) const { return halfEdges[h].edgeIndex; }
+  inline bool isBoundaryEdge(int h) const { return halfEdges[h].twin < 0; }
+  inline int outIdx(int v) const { return vertices[v].out; }
+  // The side of a quad is its last half-edge, which is the corner that the
+  // face normals have always been computed at.
+  inline int sideIdx(int f) const {
+    return quadTopology ? 4 * f + 3 : faces[f].side;
+  }
+  inline int faceValence(int f) const {
+    return quadTopology ? 4 : faces[f].valence;
+  }
+
+  int nextBoundaryHalfEdge(int v) const;
+  int prevBoundaryHalfEdge(int v) const;
+  bool isBoundaryVertex(int v) const;
+  void recalculateValence(int v);
+  QVector3D computeFaceNormal(int f) const;
+
   void extractAttributes();
   void recalculateNormals();
   void updateRegularQuadIndices();
-  bool isEdgeRegularCandidate(HalfEdge* intermEdge);
+  bool isEdgeRegularCandidate(int h) const;
 
-  QVector<unsigned int> orderQuadIndices(QVector<unsigned int> oldQuadIndices);
+  static QVector<unsigned int> orderQuadIndices(
+      QVector<unsigned int> oldQuadIndices);
 
-  int numVerts();
-  int numHalfEdges();
-  int numFaces();
-  int numEdges();
+  void clear();
+  qint64 memoryUsage() const;
+
+  int numVerts() const;
+  int numHalfEdges() const;
+  int numFaces() const;
+  int numEdges() const;
 
  private:
   QVector<QVector3D> vertexCoords;
@@ -49,18 +140,39 @@ class Mesh {
   QVector<unsigned int> regularQuadIndices;
 
 
+  int polygonPrevIdx(int h) const;
+
   QVector<Vertex> vertices;
-  QVector<Face> faces;
+  VertexPositions positions;
   QVector<HalfEdge> halfEdges;
+  // Only used by polygonal meshes
+  QVector<int> halfEdgeNexts;
+  QVector<int> halfEdgeFaces;
+  QVector<Face> faces;
+  bool quadTopology = false;
+  // Only used by levels in face-major layout: the canonical index of every
+  // vertex, and the index of the vertex at every canonical index
+  QVector<int> canonicalVertices;
+  QVector<int> layoutVertices;
+
+  VertexAdjacency adjacency;
+  // One half-edge of every edge, used by the refinement kernels when this mesh
+  // is subdivided. Kept with the mesh so that pooled levels reuse it.
+  QVector<int> edgeHalfEdges;
+  // A hash of the topology, or 0 if it has not been computed since the
+  // topology last changed
+  quint64 topologyHash = 0;
 
-  int edgeCount;
+  int edgeCount = 0;
 
   // These classes require access to the private fields to prevent a bunch of
   // function calls.
   friend class MeshInitializer;
+  friend class MeshCache;
   friend class Subdivider;
   friend class CatmullClarkSubdivider;
   friend class LimitPositionSubdivider;
+  friend class LevelRefiner;
 };
 
 #endif  // MESH_H
@@ -1,29 +1,27 @@
 #ifndef VERTEX
 #define VERTEX
 
-#include <QVector3D>
-
-// Forward declaration
-class HalfEdge;
+#include <QtGlobal>
 
 /**
- * @brief The Vertex class represents a vertex within a half-edge mesh.
+ * @brief The Vertex class represents a vertex within a half-edge mesh. The
+ * outgoing half-edge is stored as an index into the half-edges of the mesh.
+ * The position is not stored here, but in the VertexPositions of the mesh, so
+ * that geometry passes do not have to stride over the topology.
+ * Traversals around a vertex are provided by the Mesh, such as
+ * Mesh::isBoundaryVertex.
  */
 class Vertex {
  public:
   Vertex();
-  Vertex(QVector3D coords, HalfEdge* out, int valence, int index);
+  Vertex(int out, int valence);
 
-  HalfEdge* nextBoundaryHalfEdge() const;
-  HalfEdge* prevBoundaryHalfEdge() const;
-  bool isBoundaryVertex() const;
-  void recalculateValence();
   void debugInfo() const;
 
-  QVector3D coords;
-  HalfEdge* out;
+  int out;
   int valence = 0;
-  int index;
 };
 
+Q_DECLARE_TYPEINFO(Vertex, Q_RELOCATABLE_TYPE);
+
 #endif  // VERTEX
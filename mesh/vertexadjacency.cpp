@@ -0,0 +1,91 @@
+#include "vertexadjacency.h"
+
+#include "mesh.h"
+
+/**
+ * @brief VertexAdjacency::VertexAdjacency Creates an empty, invalid cache.
+ */
+VertexAdjacency::VertexAdjacency() : valid(false) {}
+
+/**
+ * @brief VertexAdjacency::build Builds the one-rings of all vertices of the
+ * mesh in a single pass over the vertices. The arrays of a previous build are
+ * reused.
+ * @param mesh The mesh to build the one-rings of.
+ */
+void VertexAdjacency::build(const Mesh& mesh) {
+    valid = false;
+    int numVerts = mesh.numVerts();
+    neighborOffsets.clear();
+    neighborIndices.clear();
+    faceOffsets.clear();
+    faceIndices.clear();
+    neighborOffsets.reserve(numVerts + 1);
+    faceOffsets.reserve(numVerts + 1);
+    // Every half-edge is the start of one ring edge, and every boundary vertex
+    // has one additional neighbour.
+    neighborIndices.reserve(mesh.numHalfEdges() + numVerts);
+    faceIndices.reserve(mesh.numHalfEdges());
+    boundaryBits.fill(0, (numVerts + 63) / 64);
+
+    for (int v = 0; v < numVerts; v++) {
+        int firstNeighbor = neighborIndices.size();
+        int firstFace = faceIndices.size();
+        neighborOffsets.append(firstNeighbor);
+        faceOffsets.append(firstFace);
+
+        // Walk around the vertex. Interior vertices are done once the walk is
+        // back at the start; boundary vertices are walked again starting from
+        // their outgoing boundary half-edge.
+        int h = mesh.outIdx(v);
+        int start = h;
+        bool boundary = false;
+        // Vertices that are not part of any face have an empty ring
+        while (h >= 0) {
+            neighborIndices.append(mesh.originIdx(mesh.nextIdx(h)));
+            faceIndices.append(mesh.faceIdx(h));
+            int prev = mesh.prevIdx(h);
+            if (mesh.isBoundaryEdge(prev)) {
+                if (boundary) {
+                    // The boundary half-edge pointing to this vertex
+                    neighborIndices.append(mesh.originIdx(prev));
+                    break;
+                }
+                boundary = true;
+                neighborIndices.resize(firstNeighbor);
+                faceIndices.resize(firstFace);
+                h = mesh.nextBoundaryHalfEdge(v);
+                start = h;
+                continue;
+            }
+            h = mesh.twinIdx(prev);
+            if (h == start) {
+                break;
+            }
+        }
+        if (boundary) {
+            boundaryBits[v >> 6] |= quint64(1) << (v & 63);
+        }
+    }
+    neighborOffsets.append(neighborIndices.size());
+    faceOffsets.append(faceIndices.size());
+    valid = true;
+}
+
+/**
+ * @brief VertexAdjacency::invalidate Marks the cache as outdated. The arrays
+ * are kept, so that the next build does not have to allocate them again.
+ */
+void VertexAdjacency::invalidate() { valid = false; }
+
+/**
+ * @brief VertexAdjacency::memoryUsage Retrieves the amount of memory allocated
+ * by the cache.
+ * @return The number of bytes allocated by the cache.
+ */
+qint64 VertexAdjacency::memoryUsage() const {
+    return (neighborOffsets.capacity() + neighborIndices.capacity() +
+            faceOffsets.capacity() + faceIndices.capacity()) *
+               qint64(sizeof(int)) +
+           boundaryBits.capacity() * qint64(sizeof(quint64));
+}
@@ -0,0 +1,77 @@
+#ifndef VERTEXADJACENCY_H
+#define VERTEXADJACENCY_H
+
+#include <QVector>
+
+class Mesh;
+
+/**
+ * @brief The VertexAdjacency class caches the one-ring of every vertex of a
+ * mesh, so that passes visiting the neighbourhood of every vertex do not have
+ * to walk the half-edges again. The neighbouring vertices and incident faces
+ * are stored as compressed rows: the ring of vertex v occupies positions
+ * offsets[v] up to offsets[v + 1] of one flat array.
+ *
+ * Rings are listed in the order in which Mesh traversals visit them. For an
+ * interior vertex, the ring starts at its outgoing half-edge and continues
+ * with the twin of the previous half-edge, so the i-th face is the face to the
+ * left of the edge towards the i-th neighbour. For a boundary vertex, the ring
+ * starts at its outgoing boundary half-edge and therefore has one more
+ * neighbour than faces: the first neighbour is the next vertex on the
+ * boundary and the last neighbour is the previous one.
+ */
+class VertexAdjacency {
+ public:
+  VertexAdjacency();
+
+  void build(const Mesh& mesh);
+  void invalidate();
+
+  inline bool isValid() const { return valid; }
+
+  inline int numNeighbors(int v) const {
+    return neighborOffsets[v + 1] - neighborOffsets[v];
+  }
+  inline const int* neighbors(int v) const {
+    return neighborIndices.constData() + neighborOffsets[v];
+  }
+  inline int numFaces(int v) const {
+    return faceOffsets[v + 1] - faceOffsets[v];
+  }
+  inline const int* faces(int v) const {
+    return faceIndices.constData() + faceOffsets[v];
+  }
+
+  // The compressed rows themselves, for passes that process many vertices at
+  // once
+  inline const int* neighborOffsetData() const {
+    return neighborOffsets.constData();
+  }
+  inline const int* neighborIndexData() const {
+    return neighborIndices.constData();
+  }
+  inline const int* faceOffsetData() const { return faceOffsets.constData(); }
+  inline const int* faceIndexData() const { return faceIndices.constData(); }
+
+  inline bool isBoundary(int v) const {
+    return (boundaryBits[v >> 6] >> (v & 63)) & 1;
+  }
+  // Only valid for boundary vertices
+  inline int nextBoundaryNeighbor(int v) const { return neighbors(v)[0]; }
+  inline int prevBoundaryNeighbor(int v) const {
+    return neighbors(v)[numNeighbors(v) - 1];
+  }
+
+  qint64 memoryUsage() const;
+
+ private:
+  QVector<int> neighborOffsets;
+  QVector<int> neighborIndices;
+  QVector<int> faceOffsets;
+  QVector<int> faceIndices;
+  // One bit per vertex, set for boundary vertices
+  QVector<quint64> boundaryBits;
+  bool valid;
+};
+
+#endif  // VERTEXADJACENCY_H
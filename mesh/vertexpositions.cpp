@@ -0,0 +1,122 @@
+#include "vertexpositions.h"
+
+#include <cstring>
+#include <new>
+#include <utility>
+
+/**
+ * @brief VertexPositions::VertexPositions Creates an empty set of positions.
+ */
+VertexPositions::VertexPositions() : data(nullptr), count(0), capacity(0) {}
+
+/**
+ * @brief VertexPositions::VertexPositions Copies the positions of another set.
+ * @param other The positions to copy.
+ */
+VertexPositions::VertexPositions(const VertexPositions& other)
+    : VertexPositions() {
+    *this = other;
+}
+
+/**
+ * @brief VertexPositions::VertexPositions Takes over the arrays of another set
+ * of positions, leaving it empty.
+ * @param other The positions to move.
+ */
+VertexPositions::VertexPositions(VertexPositions&& other) noexcept
+    : data(other.data), count(other.count), capacity(other.capacity) {
+    other.data = nullptr;
+    other.count = 0;
+    other.capacity = 0;
+}
+
+/**
+ * @brief VertexPositions::~VertexPositions Frees the coordinate arrays.
+ */
+VertexPositions::~VertexPositions() { qFreeAligned(data); }
+
+/**
+ * @brief VertexPositions::operator= Copies the positions of another set. The
+ * arrays are only reallocated if they are too small.
+ * @param other The positions to copy.
+ * @return This set of positions.
+ */
+VertexPositions& VertexPositions::operator=(const VertexPositions& other) {
+    if (this != &other) {
+        resize(other.count);
+        memcpy(x(), other.x(), sizeof(float) * count);
+        memcpy(y(), other.y(), sizeof(float) * count);
+        memcpy(z(), other.z(), sizeof(float) * count);
+    }
+    return *this;
+}
+
+/**
+ * @brief VertexPositions::operator= Takes over the arrays of another set of
+ * positions, leaving it empty.
+ * @param other The positions to move.
+ * @return This set of positions.
+ */
+VertexPositions& VertexPositions::operator=(VertexPositions&& other) noexcept {
+    std::swap(data, other.data);
+    std::swap(count, other.count);
+    std::swap(capacity, other.capacity);
+    other.clear();
+    return *this;
+}
+
+/**
+ * @brief VertexPositions::resize Changes the number of positions. Existing
+ * positions are kept and new positions are set to the origin. The arrays are
+ * only reallocated when they have to grow.
+ * @param newSize The new number of positions.
+ */
+void VertexPositions::resize(int newSize) {
+    int newCapacity =
+        (newSize + PaddingFloats - 1) / PaddingFloats * PaddingFloats;
+    if (newCapacity > capacity) {
+        float* newData = nullptr;
+        if (newCapacity > 0) {
+            size_t numBytes = 3 * sizeof(float) * size_t(newCapacity);
+            newData = static_cast<float*>(qMallocAligned(numBytes, Alignment));
+            if (newData == nullptr) {
+                throw std::bad_alloc();
+            }
+            memset(newData, 0, numBytes);
+            int numKept = qMin(count, newSize);
+            for (int c = 0; c < 3; c++) {
+                memcpy(newData + c * newCapacity, data + c * capacity,
+                       sizeof(float) * numKept);
+            }
+        }
+        qFreeAligned(data);
+        data = newData;
+        capacity = newCapacity;
+    } else if (newSize < count) {
+        // Everything past the last position is kept zero
+        for (int c = 0; c < 3; c++) {
+            memset(data + c * capacity + newSize, 0,
+                   sizeof(float) * (count - newSize));
+        }
+    }
+    count = newSize;
+}
+
+/**
+ * @brief VertexPositions::clear Removes all positions and frees the arrays.
+ */
+void VertexPositions::clear() {
+    qFreeAligned(data);
+    data = nullptr;
+    count = 0;
+    capacity = 0;
+}
+
+/**
+ * @brief VertexPositions::memoryUsage Retrieves the size of the coordinate
+ * arrays, including the padding and any unused capacity.
+ * @return The number of bytes allocated for the positions.
+ */
+qint64 VertexPositions::memoryUsage() const {
+    return 3 * qint64(sizeof(float)) * capacity;
+}
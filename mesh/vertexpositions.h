@@ -0,0 +1,64 @@
+#ifndef VERTEXPOSITIONS_H
+#define VERTEXPOSITIONS_H
+
+#include <QVector3D>
+#include <QtGlobal>
+
+/**
+ * @brief The VertexPositions class stores the positions of the vertices of a
+ * mesh as three separate arrays of x, y and z coordinates. Each array starts at
+ * a 64-byte boundary and is padded with zeros to a multiple of 16 floats, so
+ * geometry passes can stream through them with aligned vector loads without
+ * handling a remainder. Shrinking keeps the arrays allocated, so a set of
+ * positions can be refilled without allocating.
+ */
+class VertexPositions {
+ public:
+  // Alignment of the coordinate arrays in bytes. Covers AVX-512 registers
+  // and cache lines.
+  static const int Alignment = 64;
+  // Number of floats the arrays are padded to a multiple of
+  static const int PaddingFloats = Alignment / int(sizeof(float));
+
+  VertexPositions();
+  VertexPositions(const VertexPositions& other);
+  VertexPositions(VertexPositions&& other) noexcept;
+  ~VertexPositions();
+
+  VertexPositions& operator=(const VertexPositions& other);
+  VertexPositions& operator=(VertexPositions&& other) noexcept;
+
+  void resize(int newSize);
+  void clear();
+
+  inline int size() const { return count; }
+  inline int paddedSize() const {
+    return (count + PaddingFloats - 1) / PaddingFloats * PaddingFloats;
+  }
+
+  inline float* x() { return data; }
+  inline float* y() { return data + capacity; }
+  inline float* z() { return data + 2 * capacity; }
+  inline const float* x() const { return data; }
+  inline const float* y() const { return data + capacity; }
+  inline const float* z() const { return data + 2 * capacity; }
+
+  inline QVector3D at(int v) const {
+    return QVector3D(data[v], data[capacity + v], data[2 * capacity + v]);
+  }
+  inline void set(int v, const QVector3D& position) {
+    data[v] = position.x();
+    data[capacity + v] = position.y();
+    data[2 * capacity + v] = position.z();
+  }
+
+  qint64 memoryUsage() const;
+
+ private:
+  float* data;
+  int count;
+  // Number of floats allocated per coordinate array
+  int capacity;
+};
+
+#endif  // VERTEXPOSITIONS_H
@@ -0,0 +1,411 @@
+#include "adaptivesubdivider.h"
+
+#include "catmullclarksubdivider.h"
+#include "initialization/meshinitializer.h"
+#include "limitprojectionsubdivider.h"
+
+/**
+ * @brief AdaptiveSubdivider::AdaptiveSubdivider Creates a new adaptive
+ * subdivider.
+ * @param numThreads The number of threads used to subdivide the sub-meshes.
+ * The result does not depend on the number of threads.
+ */
+AdaptiveSubdivider::AdaptiveSubdivider(int numThreads)
+    : numThreads(numThreads) {}
+
+/**
+ * @brief AdaptiveSubdivider::subdivide Subdivides the irregular regions of a
+ * control mesh up to a maximum level, and collects the regular faces of every
+ * level as patches.
+ * @param controlMesh The control mesh.
+ * @param maxLevel The maximum number of subdivision steps. At least one step
+ * is taken, so the irregular faces that remain are all quads.
+ * @return The patches and irregular quads.
+ */
+AdaptivePatches AdaptiveSubdivider::subdivide(const Mesh& controlMesh,
+                                              int maxLevel) const {
+    AdaptivePatches patches;
+    maxLevel = qMax(maxLevel, 1);
+    CatmullClarkSubdivider subdivider(
+        CatmullClarkSubdivider::VertexLayout::Canonical, numThreads);
+
+    // The faces of the current level that still have to be classified
+    QVector<int> activeFaces(controlMesh.numFaces());
+    for (int f = 0; f < controlMesh.numFaces(); f++) {
+        activeFaces[f] = f;
+    }
+    const Mesh* mesh = &controlMesh;
+    Mesh levelMesh;
+    VertexAdjacency adjacency;
+    QVector<int> refineFaces;
+    for (int level = 0; level <= maxLevel; level++) {
+        adjacency.build(*mesh);
+        // The index in the points of every vertex of this level that has been
+        // emitted
+        QVector<int> pointIndices(mesh->numVerts(), -1);
+        refineFaces.clear();
+        for (int f : activeFaces) {
+            if (isRegularFace(*mesh, adjacency, f)) {
+                appendPatch(*mesh, f, level, pointIndices, patches);
+            } else if (level == maxLevel) {
+                appendIrregularQuad(*mesh, f, pointIndices, patches);
+            } else {
+                refineFaces.append(f);
+            }
+        }
+        if (refineFaces.isEmpty()) {
+            break;
+        }
+
+        QVector<int> subVertexIndices;
+        Mesh subMesh =
+            extractSubMesh(*mesh, adjacency, refineFaces, subVertexIndices);
+        subMesh.buildAdjacency();
+        Mesh newMesh;
+        subdivider.subdivide(subMesh, newMesh);
+
+        // The faces to refine come first in the sub-mesh. The children of a
+        // face are numbered by its half-edges.
+        activeFaces.clear();
+        for (int i = 0; i < refineFaces.size(); i++) {
+            int h = subMesh.sideIdx(i);
+            for (int k = 0; k < subMesh.faceValence(i); k++) {
+                activeFaces.append(h);
+                h = subMesh.nextIdx(h);
+            }
+        }
+        levelMesh = std::move(newMesh);
+        mesh = &levelMesh;
+    }
+    return patches;
+}
+
+/**
+ * @brief limitPosition Calculates the limit position of a vertex. Interior
+ * vertices use the stencil of the LimitPositionSubdivider. Boundaries are cubic
+ * B-splines, so boundary vertices use the limit stencil (1, 4, 1) / 6 of their
+ * boundary curve.
+ * @param mesh The mesh the vertex belongs to. Its adjacency has to be built.
+ * @param v Index of the vertex.
+ * @param limitSubdivider Computes the limit position of interior vertices.
+ * @return The limit position of the vertex.
+ */
+static QVector3D limitPosition(const Mesh& mesh, int v,
+                               const LimitPositionSubdivider& limitSubdivider) {
+    const VertexAdjacency* adjacency = mesh.getAdjacency();
+    if (!adjacency->isBoundary(v)) {
+        return limitSubdivider.limitPosition(mesh, v);
+    }
+    QVector3D next = mesh.position(adjacency->nextBoundaryNeighbor(v));
+    QVector3D prev = mesh.position(adjacency->prevBoundaryNeighbor(v));
+    return (2.0f / 3.0f) * mesh.position(v) + (1.0f / 6.0f) * (next + prev);
+}
+
+/**
+ * @brief refinedVertexIndex Retrieves the index in the refined mesh of a
+ * vertex, and appends the limit position of the vertex to the refined mesh if
+ * it has not been emitted yet.
+ * @param mesh The mesh the vertex belongs to. Its adjacency has to be built.
+ * @param v Index of the vertex.
+ * @param limitSubdivider Computes the limit position.
+ * @param vertexIndices The index in the refined mesh of every vertex of the
+ * mesh, or -1.
+ * @param vertexCoords The vertex coordinates of the refined mesh.
+ * @return The index in the refined mesh.
+ */
+static int refinedVertexIndex(const Mesh& mesh, int v,
+                              const LimitPositionSubdivider& limitSubdivider,
+                              QVector<int>& vertexIndices,
+                              QVector<QVector3D>& vertexCoords) {
+    if (vertexIndices[v] < 0) {
+        vertexIndices[v] = vertexCoords.size();
+        vertexCoords.append(limitPosition(mesh, v, limitSubdivider));
+    }
+    return vertexIndices[v];
+}
+
+/**
+ * @brief AdaptiveSubdivider::refine Refines every control face to a depth of
+ * its own. Faces that share an edge must differ by at most one in depth, which
+ * the RefinementDepthSelector guarantees. Faces are emitted as polygons once
+ * they reach their depth. The vertices of a face are projected to the limit
+ * surface, and the edge points of its edges are added as corners where the
+ * neighbour is refined further.
+ * @param controlMesh The control mesh.
+ * @param faceDepths The number of subdivision steps of every control face.
+ * @return The refined mesh, of which the faces are ordered by level.
+ */
+Mesh AdaptiveSubdivider::refine(const Mesh& controlMesh,
+                                const QVector<int>& faceDepths) const {
+    CatmullClarkSubdivider subdivider(
+        CatmullClarkSubdivider::VertexLayout::Canonical, numThreads);
+    LimitPositionSubdivider limitSubdivider;
+    QVector<QVector3D> vertexCoords;
+    QVector<int> faceOffsets;
+    QVector<int> faceCoordInd;
+
+    QVector<int> activeFaces(controlMesh.numFaces());
+    for (int f = 0; f < controlMesh.numFaces(); f++) {
+        activeFaces[f] = f;
+    }
+    QVector<int> activeDepths = faceDepths;
+    Mesh mesh = controlMesh;
+    mesh.buildAdjacency();
+    // The index in the refined mesh of every vertex of the current level that
+    // has been emitted
+    QVector<int> vertexIndices(mesh.numVerts(), -1);
+    QVector<int> refineFaces;
+    QVector<int> refineDepths;
+    QVector<int> emitFaces;
+    for (int level = 0; !activeFaces.isEmpty(); level++) {
+        // The index in the sub-mesh of every face to refine, or -1
+        QVector<int> subFaces(mesh.numFaces(), -1);
+        refineFaces.clear();
+        refineDepths.clear();
+        emitFaces.clear();
+        for (int i = 0; i < activeFaces.size(); i++) {
+            if (activeDepths[i] > level) {
+                subFaces[activeFaces[i]] = refineFaces.size();
+                refineFaces.append(activeFaces[i]);
+                refineDepths.append(activeDepths[i]);
+            } else {
+                emitFaces.append(activeFaces[i]);
+            }
+        }
+
+        Mesh subMesh;
+        Mesh newMesh;
+        QVector<int> subVertexIndices;
+        if (!refineFaces.isEmpty()) {
+            subMesh = extractSubMesh(mesh, *mesh.getAdjacency(), refineFaces,
+                                     subVertexIndices);
+            subMesh.buildAdjacency();
+            subdivider.subdivide(subMesh, newMesh);
+            newMesh.buildAdjacency();
+        }
+        QVector<int> newVertexIndices(newMesh.numVerts(), -1);
+
+        for (int f : emitFaces) {
+            faceOffsets.append(faceCoordInd.size());
+            int h = mesh.sideIdx(f);
+            for (int m = 0; m < mesh.faceValence(f); m++) {
+                faceCoordInd.append(refinedVertexIndex(
+                    mesh, mesh.originIdx(h), limitSubdivider, vertexIndices,
+                    vertexCoords));
+                int twin = mesh.twinIdx(h);
+                h = mesh.nextIdx(h);
+                if (twin < 0 || subFaces[mesh.faceIdx(twin)] < 0) {
+                    continue;
+                }
+                // Find the twin in the sub-mesh, where the refined neighbour
+                // is listed starting at its side as well
+                int neighbor = mesh.faceIdx(twin);
+                int subTwin = subMesh.sideIdx(subFaces[neighbor]);
+                for (int e = mesh.sideIdx(neighbor); e != twin;
+                     e = mesh.nextIdx(e)) {
+                    subTwin = subMesh.nextIdx(subTwin);
+                }
+                int edgePoint = subMesh.numVerts() + subMesh.numFaces() +
+                                subMesh.edgeIdx(subTwin);
+                faceCoordInd.append(refinedVertexIndex(newMesh, edgePoint,
+                                                       limitSubdivider,
+                                                       newVertexIndices,
+                                                       vertexCoords));
+            }
+        }
+        if (refineFaces.isEmpty()) {
+            break;
+        }
+
+        // The vertex point of a vertex lies at the same limit position
+        for (int v = 0; v < mesh.numVerts(); v++) {
+            if (vertexIndices[v] >= 0 && subVertexIndices[v] >= 0) {
+                newVertexIndices[subVertexIndices[v]] = vertexIndices[v];
+            }
+        }
+        activeFaces.clear();
+        activeDepths.clear();
+        for (int i = 0; i < refineFaces.size(); i++) {
+            int h = subMesh.sideIdx(i);
+            for (int k = 0; k < subMesh.faceValence(i); k++) {
+                activeFaces.append(h);
+                activeDepths.append(refineDepths[i]);
+                h = subMesh.nextIdx(h);
+            }
+        }
+        mesh = std::move(newMesh);
+        vertexIndices = std::move(newVertexIndices);
+    }
+    faceOffsets.append(faceCoordInd.size());
+
+    MeshInitializer meshInitializer(numThreads);
+    return meshInitializer.constructHalfEdgeMesh(vertexCoords, faceOffsets,
+                                                 faceCoordInd);
+}
+
+/**
+ * @brief AdaptiveSubdivider::isRegularFace Checks whether the limit surface of
+ * a face is a bicubic B-spline patch. That is the case for quads of which all
+ * corners are interior vertices that are surrounded by four quads.
+ * @param mesh The mesh the face belongs to.
+ * @param adjacency The one-rings of the mesh.
+ * @param f Index of the face.
+ * @return True if the face is regular; false otherwise.
+ */
+bool AdaptiveSubdivider::isRegularFace(const Mesh& mesh,
+                                       const VertexAdjacency& adjacency,
+                                       int f) const {
+    if (mesh.faceValence(f) != 4) {
+        return false;
+    }
+    int h = mesh.sideIdx(f);
+    for (int m = 0; m < 4; m++) {
+        int v = mesh.originIdx(h);
+        if (adjacency.isBoundary(v) || adjacency.numFaces(v) != 4) {
+            return false;
+        }
+        const int* faces = adjacency.faces(v);
+        for (int i = 0; i < 4; i++) {
+            if (mesh.faceValence(faces[i]) != 4) {
+                return false;
+            }
+        }
+        h = mesh.nextIdx(h);
+    }
+    return true;
+}
+
+/**
+ * @brief pointIndex Retrieves the index in the points of a vertex, and appends
+ * the vertex to the points if it has not been emitted yet.
+ * @param mesh The mesh the vertex belongs to.
+ * @param v Index of the vertex.
+ * @param pointIndices The point index of every vertex of the mesh, or -1.
+ * @param patches The patches to append the point to.
+ * @return The index of the point.
+ */
+static unsigned int pointIndex(const Mesh& mesh, int v,
+                               QVector<int>& pointIndices,
+                               AdaptivePatches& patches) {
+    if (pointIndices[v] < 0) {
+        pointIndices[v] = patches.points.size();
+        patches.points.append(mesh.position(v));
+    }
+    return pointIndices[v];
+}
+
+/**
+ * @brief AdaptiveSubdivider::appendPatch Appends the 16 control points of a
+ * regular face as a patch. The points are gathered in the same way as the
+ * regular quad indices of a mesh.
+ * @param mesh The mesh the face belongs to.
+ * @param f Index of the regular face.
+ * @param level The subdivision level of the mesh.
+ * @param pointIndices The point index of every vertex of the mesh, or -1.
+ * @param patches The patches to append the patch to.
+ */
+void AdaptiveSubdivider::appendPatch(const Mesh& mesh, int f, int level,
+                                     QVector<int>& pointIndices,
+                                     AdaptivePatches& patches) const {
+    QVector<unsigned int> vertexIndices;
+    vertexIndices.reserve(16);
+    int h = mesh.sideIdx(f);
+    for (int m = 0; m < 4; m++) {
+        vertexIndices.append(mesh.originIdx(h));
+        int e = mesh.nextIdx(mesh.nextIdx(mesh.twinIdx(h)));
+        vertexIndices.append(mesh.originIdx(e));
+        e = mesh.nextIdx(e);
+        vertexIndices.append(mesh.originIdx(e));
+        e = mesh.nextIdx(mesh.nextIdx(mesh.twinIdx(e)));
+        vertexIndices.append(mesh.originIdx(e));
+        h = mesh.nextIdx(h);
+    }
+    for (unsigned int v : Mesh::orderQuadIndices(vertexIndices)) {
+        patches.patchIndices.append(
+            pointIndex(mesh, v, pointIndices, patches));
+    }
+    patches.patchLevels.append(level);
+}
+
+/**
+ * @brief AdaptiveSubdivider::appendIrregularQuad Appends the corners of a
+ * quad that is not regular at the deepest level.
+ * @param mesh The mesh the face belongs to.
+ * @param f Index of the quad.
+ * @param pointIndices The point index of every vertex of the mesh, or -1.
+ * @param patches The patches to append the quad to.
+ */
+void AdaptiveSubdivider::appendIrregularQuad(const Mesh& mesh, int f,
+                                             QVector<int>& pointIndices,
+                                             AdaptivePatches& patches) const {
+    int h = mesh.sideIdx(f);
+    for (int m = 0; m < 4; m++) {
+        patches.irregularQuadIndices.append(
+            pointIndex(mesh, mesh.originIdx(h), pointIndices, patches));
+        h = mesh.nextIdx(h);
+    }
+}
+
+/**
+ * @brief AdaptiveSubdivider::extractSubMesh Creates a mesh of the faces to
+ * refine and all faces around their corners. The vertex and edge points of the
+ * faces to refine only depend on those faces, so their children are the same
+ * in the subdivided sub-mesh as in the subdivided mesh. So are the children of
+ * their corners, which is what the next level needs to find regular faces.
+ * @param mesh The mesh to take the faces from.
+ * @param adjacency The one-rings of the mesh.
+ * @param faces The faces to refine.
+ * @param newVertexIndices Is set to the index in the sub-mesh of every vertex
+ * of the mesh, or -1 if the vertex is not part of it.
+ * @return The sub-mesh. Face i of the sub-mesh is the i-th face to refine,
+ * listed starting at its side, and is followed by the faces around the
+ * corners.
+ */
+Mesh AdaptiveSubdivider::extractSubMesh(const Mesh& mesh,
+                                        const VertexAdjacency& adjacency,
+                                        const QVector<int>& faces,
+                                        QVector<int>& newVertexIndices) const {
+    QVector<int> subFaces = faces;
+    QVector<int> faceMarks(mesh.numFaces(), 0);
+    for (int f : faces) {
+        faceMarks[f] = 1;
+    }
+    for (int f : faces) {
+        int h = mesh.sideIdx(f);
+        for (int m = 0; m < mesh.faceValence(f); m++) {
+            int v = mesh.originIdx(h);
+            const int* ring = adjacency.faces(v);
+            for (int i = 0; i < adjacency.numFaces(v); i++) {
+                if (!faceMarks[ring[i]]) {
+                    faceMarks[ring[i]] = 1;
+                    subFaces.append(ring[i]);
+                }
+            }
+            h = mesh.nextIdx(h);
+        }
+    }
+
+    newVertexIndices.fill(-1, mesh.numVerts());
+    QVector<QVector3D> vertexCoords;
+    QVector<int> faceOffsets;
+    QVector<int> faceCoordInd;
+    faceOffsets.reserve(subFaces.size() + 1);
+    for (int f : subFaces) {
+        faceOffsets.append(faceCoordInd.size());
+        int h = mesh.sideIdx(f);
+        for (int m = 0; m < mesh.faceValence(f); m++) {
+            int v = mesh.originIdx(h);
+            if (newVertexIndices[v] < 0) {
+                newVertexIndices[v] = vertexCoords.size();
+                vertexCoords.append(mesh.position(v));
+            }
+            faceCoordInd.append(newVertexIndices[v]);
+            h = mesh.nextIdx(h);
+        }
+    }
+    faceOffsets.append(faceCoordInd.size());
+
+    MeshInitializer meshInitializer(numThreads);
+    return meshInitializer.constructHalfEdgeMesh(vertexCoords, faceOffsets,
+                                                 faceCoordInd);
+}
@@ -0,0 +1,73 @@
+#ifndef ADAPTIVE_SUBDIVIDER_H
+#define ADAPTIVE_SUBDIVIDER_H
+
+#include <QVector3D>
+#include <QVector>
+
+#include "mesh/mesh.h"
+
+/**
+ * @brief The AdaptivePatches struct holds the result of adaptive subdivision:
+ * a list of bicubic patches, each at the level it was found regular at, and
+ * the irregular quads that remain at the deepest level. All of them index into
+ * the same array of points.
+ */
+struct AdaptivePatches {
+  QVector<QVector3D> points;
+  // 16 control points per patch, in the order of the regular quad indices of
+  // a mesh
+  QVector<unsigned int> patchIndices;
+  // The subdivision level of every patch
+  QVector<int> patchLevels;
+  // 4 corners per quad, starting at the side of the quad
+  QVector<unsigned int> irregularQuadIndices;
+
+  inline int numPatches() const { return patchLevels.size(); }
+  inline int numIrregularQuads() const {
+    return irregularQuadIndices.size() / 4;
+  }
+};
+
+/**
+ * @brief The AdaptiveSubdivider class subdivides a control mesh only where
+ * that is needed to describe its limit surface. Regular faces are quads of
+ * which the four corners are interior vertices surrounded by four quads. The
+ * limit surface of such a face is a bicubic B-spline patch of the 16 points
+ * around it, so it is emitted as a patch at the level it is first found at.
+ * All other faces are subdivided once more, until the maximum level is
+ * reached. The faces that are still not regular at that level are emitted as
+ * irregular quads.
+ *
+ * Every level only subdivides a sub-mesh: the faces that are not regular, and
+ * the faces around their corners, which are needed to compute the positions of
+ * their children. Since the irregular faces are found around extraordinary
+ * vertices and boundaries, the sub-meshes shrink by about half every level.
+ *
+ * The same sub-meshes are used to refine every control face to a depth of its
+ * own, such as those of the RefinementDepthSelector. The result is a single
+ * mesh of which all vertices are projected to their limit positions, so that
+ * a vertex has the same position at every level it appears on. Faces next to a
+ * face that is refined once more also get the edge points of their shared
+ * edges as corners, so there are no cracks or T-junctions between them.
+ */
+class AdaptiveSubdivider {
+ public:
+  AdaptiveSubdivider(int numThreads = 1);
+  AdaptivePatches subdivide(const Mesh& controlMesh, int maxLevel) const;
+  Mesh refine(const Mesh& controlMesh, const QVector<int>& faceDepths) const;
+
+ private:
+  bool isRegularFace(const Mesh& mesh, const VertexAdjacency& adjacency,
+                     int f) const;
+  void appendPatch(const Mesh& mesh, int f, int level,
+                   QVector<int>& pointIndices, AdaptivePatches& patches) const;
+  void appendIrregularQuad(const Mesh& mesh, int f, QVector<int>& pointIndices,
+                           AdaptivePatches& patches) const;
+  Mesh extractSubMesh(const Mesh& mesh, const VertexAdjacency& adjacency,
+                      const QVector<int>& faces,
+                      QVector<int>& newVertexIndices) const;
+
+  int numThreads;
+};
+
+#endif  // ADAPTIVE_SUBDIVIDER_H
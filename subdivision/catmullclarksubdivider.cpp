@@ -1,12 +1,82 @@
 #include "catmullclarksubdivider.h"
 
 #include <QDebug>
+#include <algorithm>
+
+#include "util/parallel.h"
+
+// Below this many elements, a pass is run on a single thread
+#define MIN_PARALLEL_ELEMENTS 16384
+// The number of elements a thread processes at a time
+#define PARALLEL_GRAIN_SIZE 2048
+
+/**
+ * @brief layoutIdx Maps the canonical index of a new vertex to its index in
+ * the layout of the new mesh.
+ * @param vertexMap The layout index of every canonical index, or nullptr for
+ * the canonical layout.
+ * @param v The canonical index of the vertex.
+ * @return The index of the vertex in the new mesh.
+ */
+static inline int layoutIdx(const int *vertexMap, int v) {
+    return vertexMap == nullptr ? v : vertexMap[v];
+}
 
 /**
  * @brief CatmullClarkSubdivider::CatmullClarkSubdivider Creates a new empty
  * Catmull Clark subdivider.
+ * @param layout The order in which the vertices of subdivided meshes are
+ * stored.
+ * @param numThreads The number of threads used to refine large meshes. The
+ * subdivided mesh does not depend on the number of threads.
+ */
+CatmullClarkSubdivider::CatmullClarkSubdivider(VertexLayout layout,
+                                               int numThreads)
+    : layout(layout),
+      numThreads(numThreads),
+      kernels(&bestRefinementKernels()) {}
+
+/**
+ * @brief CatmullClarkSubdivider::setSimdIsa Selects the instruction set of the
+ * refinement kernels, for instance to compare them with each other.
+ * @param isa The instruction set.
+ * @return True if the instruction set is available, false otherwise. In the
+ * latter case the kernels are left unchanged.
+ */
+bool CatmullClarkSubdivider::setSimdIsa(SimdIsa isa) {
+    const RefinementKernels* selected = refinementKernels(isa);
+    if (selected == nullptr) {
+        return false;
+    }
+    kernels = selected;
+    return true;
+}
+
+/**
+ * @brief CatmullClarkSubdivider::runsInParallel Checks whether a pass over the
+ * provided number of elements is split over multiple threads.
+ * @param count The number of elements of the pass.
+ * @return True if the pass is run on multiple threads, false otherwise.
+ */
+bool CatmullClarkSubdivider::runsInParallel(int count) const {
+    return numThreads > 1 && count >= MIN_PARALLEL_ELEMENTS;
+}
+
+/**
+ * @brief CatmullClarkSubdivider::forEachBlock Invokes the body for blocks of
+ * the range [0, count). Large ranges are processed by multiple threads, which
+ * steal blocks from each other when they run out of work.
+ * @param count The number of elements.
+ * @param body Function invoked with the start and end of a block.
  */
-CatmullClarkSubdivider::CatmullClarkSubdivider() {}
+void CatmullClarkSubdivider::forEachBlock(
+    int count, const std::function<void(int, int)> &body) const {
+    if (runsInParallel(count)) {
+        parallelForStealing(0, count, PARALLEL_GRAIN_SIZE, body, numThreads);
+    } else {
+        body(0, count);
+    }
+}
 
 /**
  * @brief CatmullClarkSubdivider::subdivide Subdivides the provided control mesh
@@ -21,31 +91,262 @@ CatmullClarkSubdivider::CatmullClarkSubdivider() {}
  */
 Mesh CatmullClarkSubdivider::subdivide(Mesh &mesh) const {
     Mesh newMesh;
-    reserveSizes(mesh, newMesh);
-    geometryRefinement(mesh, newMesh);
-    topologyRefinement(mesh, newMesh);
+    subdivide(mesh, newMesh);
     return newMesh;
 }
 
 /**
- * @brief CatmullClarkSubdivider::reserveSizes Resizes the vertex, half-edge and
- * face vectors. Aslo recalculates the edge count.
+ * @brief copyVector Copies the elements of a vector into the buffer of another
+ * one, which is only reallocated if it is too small. Unlike assignment, this
+ * never makes the vectors share their data.
+ * @param from The vector to copy.
+ * @param to The vector to copy into.
+ */
+template <typename T>
+static void copyVector(const QVector<T> &from, QVector<T> &to) {
+    to.resize(from.size());
+    std::copy(from.constBegin(), from.constEnd(), to.begin());
+}
+
+/**
+ * @brief CatmullClarkSubdivider::subdivide Subdivides the provided control mesh
+ * into an existing mesh, replacing its contents. The buffers of the new mesh
+ * are reused, so no memory is allocated if they are large enough, for example
+ * when the mesh was taken from a MeshLevelPool.
+ * @param mesh The mesh to be subdivided.
+ * @param newMesh The mesh to store the result in. Should not share its data
+ * with any other mesh.
+ */
+void CatmullClarkSubdivider::subdivide(Mesh &mesh, Mesh &newMesh) const {
+    newMesh.clear();
+    quint64 key = 0;
+    const RefinedTopology *topology = nullptr;
+    if (topologyCache != nullptr) {
+        key = TopologyCache::refinementKey(mesh.topologyFingerprint(),
+                                           int(layout));
+        topology = topologyCache->find(key, mesh.numVerts(),
+                                       mesh.numHalfEdges(), mesh.numFaces());
+    }
+    reserveSizes(mesh, newMesh);
+    if (layout == VertexLayout::FaceMajor) {
+        if (topology != nullptr) {
+            copyVector(topology->layoutVertices, newMesh.layoutVertices);
+        } else {
+            faceMajorVertexMap(mesh, newMesh);
+        }
+    }
+    const QVector<int> &vertexMap = newMesh.layoutVertices;
+    const int *map = vertexMap.isEmpty() ? nullptr : vertexMap.constData();
+    if (map == nullptr && mesh.isQuadMesh() && mesh.getAdjacency() != nullptr) {
+        quadGeometryRefinement(mesh, newMesh);
+    } else {
+        geometryRefinement(mesh, newMesh, map);
+    }
+
+    if (topology != nullptr) {
+        // The geometry passes also set the valences, but not the outgoing
+        // half-edges, so the vertices are replaced as a whole. The topology is
+        // copied rather than shared, so that the new mesh keeps its own buffers
+        // and a MeshLevelPool can reuse them.
+        copyVector(topology->vertices, newMesh.vertices);
+        copyVector(topology->halfEdges, newMesh.halfEdges);
+        copyVector(topology->canonicalVertices, newMesh.canonicalVertices);
+    } else {
+        topologyRefinement(mesh, newMesh, map);
+        if (topologyCache != nullptr) {
+            RefinedTopology refined;
+            refined.numVerts = mesh.numVerts();
+            refined.numHalfEdges = mesh.numHalfEdges();
+            refined.numFaces = mesh.numFaces();
+            copyVector(newMesh.vertices, refined.vertices);
+            copyVector(newMesh.halfEdges, refined.halfEdges);
+            copyVector(newMesh.canonicalVertices, refined.canonicalVertices);
+            copyVector(newMesh.layoutVertices, refined.layoutVertices);
+            topologyCache->insert(key, refined);
+        }
+    }
+    // The key determines the subdivided topology, so it is its fingerprint
+    newMesh.topologyHash = key;
+}
+
+/**
+ * @brief sortUnique Sorts a list of indices and removes the duplicates.
+ * @param indices The indices.
+ */
+static void sortUnique(QVector<int> &indices) {
+    std::sort(indices.begin(), indices.end());
+    auto last = std::unique(indices.begin(), indices.end());
+    indices.resize(last - indices.begin());
+}
+
+/**
+ * @brief CatmullClarkSubdivider::updatePositions Updates the positions of a
+ * mesh that was subdivided from the provided mesh, after some of its vertices
+ * have moved. The topology of both meshes is left untouched. Only the face
+ * points of the faces around the moved vertices, and the edge and vertex points
+ * of those faces, are computed again, using the same formulas as subdivide.
+ * @param mesh The mesh of which vertices have moved. Its adjacency cache is
+ * built if it was not already.
+ * @param newMesh The mesh subdivided from it by a subdivider with the same
+ * layout.
+ * @param dirtyVertices The vertices of the mesh that have moved.
+ * @param newDirtyVertices Is set to the vertices of the new mesh that have
+ * moved, in ascending order.
+ */
+void CatmullClarkSubdivider::updatePositions(
+    Mesh &mesh, Mesh &newMesh, const QVector<int> &dirtyVertices,
+    QVector<int> &newDirtyVertices) const {
+    if (mesh.getAdjacency() == nullptr) {
+        mesh.buildAdjacency();
+    }
+    const VertexAdjacency *adjacency = mesh.getAdjacency();
+    // Face-major levels keep the layout they were subdivided into
+    const QVector<int> &vertexMap = newMesh.layoutVertices;
+    const int *map = vertexMap.isEmpty() ? nullptr : vertexMap.constData();
+    VertexPositions &newPositions = newMesh.getPositions();
+    int firstEdgePoint = mesh.numVerts() + mesh.numFaces();
+
+    QVector<int> faces;
+    for (int v : dirtyVertices) {
+        const int *ring = adjacency->faces(v);
+        for (int i = 0; i < adjacency->numFaces(v); i++) {
+            faces.append(ring[i]);
+        }
+    }
+    sortUnique(faces);
+
+    // Every edge is computed from the same half-edge as in subdivide, which
+    // is the one with the highest index
+    QVector<int> edges;
+    QVector<int> vertices;
+    for (int f : faces) {
+        int h = mesh.sideIdx(f);
+        for (int i = 0; i < mesh.faceValence(f); i++) {
+            edges.append(qMax(h, mesh.twinIdx(h)));
+            vertices.append(mesh.originIdx(h));
+            h = mesh.nextIdx(h);
+        }
+    }
+    sortUnique(edges);
+    sortUnique(vertices);
+
+    newDirtyVertices.clear();
+    for (int f : faces) {
+        int i = layoutIdx(map, mesh.numVerts() + f);
+        newPositions.set(i, facePoint(mesh, f));
+        newDirtyVertices.append(i);
+    }
+    for (int h : edges) {
+        int i = layoutIdx(map, firstEdgePoint + mesh.edgeIdx(h));
+        if (mesh.isBoundaryEdge(h)) {
+            newPositions.set(i, boundaryEdgePoint(mesh, h));
+        } else {
+            newPositions.set(i, edgePoint(mesh, h, newMesh, map));
+        }
+        newDirtyVertices.append(i);
+    }
+    for (int v : vertices) {
+        int i = layoutIdx(map, v);
+        if (adjacency->isBoundary(v)) {
+            newPositions.set(i, boundaryVertexPoint(mesh, v));
+        } else {
+            newPositions.set(i, vertexPoint(mesh, v, newMesh, map));
+        }
+        newDirtyVertices.append(i);
+    }
+    std::sort(newDirtyVertices.begin(), newDirtyVertices.end());
+}
+
+/**
+ * @brief CatmullClarkSubdivider::updateLevels Updates the positions of all
+ * subdivided levels after some vertices of the first level have moved. Every
+ * level is expected to be subdivided from the level before it by a subdivider
+ * with the same layout. The vertex attributes used for drawing are not
+ * extracted again.
+ * @param levels The levels, starting at the control mesh.
+ * @param dirtyVertices The vertices of the first level that have moved.
+ */
+void CatmullClarkSubdivider::updateLevels(
+    QVector<Mesh> &levels, const QVector<int> &dirtyVertices) const {
+    QVector<int> dirty = dirtyVertices;
+    sortUnique(dirty);
+    QVector<int> newDirty;
+    for (int k = 0; k + 1 < levels.size(); k++) {
+        updatePositions(levels[k], levels[k + 1], dirty, newDirty);
+        std::swap(dirty, newDirty);
+    }
+}
+
+/**
+ * @brief CatmullClarkSubdivider::reserveSizes Resizes the vertex and half-edge
+ * vectors. Aslo recalculates the edge count. The new mesh is a quad mesh, so
+ * its faces are not stored.
  * @param controlMesh The control mesh.
  * @param newMesh The new mesh. At this point, the mesh is fully empty.
  */
 void CatmullClarkSubdivider::reserveSizes(Mesh &controlMesh,
                                           Mesh &newMesh) const {
     int newNumEdges = 2 * controlMesh.numEdges() + controlMesh.numHalfEdges();
-    int newNumFaces = controlMesh.numHalfEdges();
     int newNumHalfEdges = controlMesh.numHalfEdges() * 4;
     int newNumVerts = controlMesh.numVerts() + controlMesh.numFaces() + controlMesh.numEdges();
 
     newMesh.getVertices().resize(newNumVerts);
+    newMesh.getPositions().resize(newNumVerts);
     newMesh.getHalfEdges().resize(newNumHalfEdges);
-    newMesh.getFaces().resize(newNumFaces);
+    newMesh.quadTopology = true;
     newMesh.edgeCount = newNumEdges;
 }
 
+/**
+ * @brief CatmullClarkSubdivider::faceMajorVertexMap Numbers the new vertices
+ * face by face. Every face numbers its face point, then the edge points of the
+ * edges whose lowest half-edge it contains, and finally the vertex points of
+ * its vertices that no earlier face has numbered. Vertices without faces come
+ * last. Stores the index in the new mesh of every canonical vertex index, as
+ * well as the canonical index of every new vertex, in the new mesh.
+ * @param mesh The control mesh.
+ * @param newMesh The new mesh.
+ */
+void CatmullClarkSubdivider::faceMajorVertexMap(const Mesh &mesh,
+                                                Mesh &newMesh) const {
+    int numVerts = mesh.numVerts();
+    int firstEdgePoint = numVerts + mesh.numFaces();
+    QVector<int> &vertexMap = newMesh.layoutVertices;
+    vertexMap.fill(-1, newMesh.numVerts());
+    int next = 0;
+    for (int f = 0; f < mesh.numFaces(); f++) {
+        vertexMap[numVerts + f] = next++;
+        int h = mesh.sideIdx(f);
+        for (int i = 0; i < mesh.faceValence(f); i++) {
+            int twin = mesh.twinIdx(h);
+            if (twin < 0 || h < twin) {
+                vertexMap[firstEdgePoint + mesh.edgeIdx(h)] = next++;
+            }
+            h = mesh.nextIdx(h);
+        }
+        for (int i = 0; i < mesh.faceValence(f); i++) {
+            int v = mesh.originIdx(h);
+            if (vertexMap[v] < 0) {
+                vertexMap[v] = next++;
+            }
+            h = mesh.nextIdx(h);
+        }
+    }
+    for (int v = 0; v < numVerts; v++) {
+        if (vertexMap[v] < 0) {
+            vertexMap[v] = next++;
+        }
+    }
+
+    // Vertex points keep the canonical index of their vertex, while the face
+    // and edge points are the same in both layouts
+    newMesh.canonicalVertices.resize(newMesh.numVerts());
+    for (int v = 0; v < newMesh.numVerts(); v++) {
+        newMesh.canonicalVertices[vertexMap[v]] =
+            v < numVerts ? mesh.canonicalVertexIdx(v) : v;
+    }
+}
+
 /**
  * @brief CatmullClarkSubdivider::geometryRefinement Performs the geometry
  * refinement. In other words, it calculates the coordinates of the vertex, edge
@@ -55,58 +356,157 @@ void CatmullClarkSubdivider::reserveSizes(Mesh &controlMesh,
  * boundary, in which case the valence will be 3.
  * The valence of a new vertex point is equal to the valence of the original
  * vertex point.
+ * The points are computed in three passes: first the face points, then the
+ * edge points and finally the vertex points. The last two passes read the face
+ * points from the new mesh, so every face point is computed only once.
  * @param controlMesh The control mesh.
  * @param newMesh The new mesh. At the start of this function, the only
  * guarantee you have of this newMesh is that the vertex, half-edge and face
  * vectors have the correct sizes.
+ * @param vertexMap The index in the new mesh of every canonical vertex index,
+ * or nullptr for the canonical layout.
  */
 void CatmullClarkSubdivider::geometryRefinement(Mesh &controlMesh,
-                                                Mesh &newMesh) const {
-    QVector<Vertex> &newVertices = newMesh.getVertices();
-    QVector<Vertex> &vertices = controlMesh.getVertices();
-    QVector<Face> &faces = controlMesh.getFaces();
+                                                Mesh &newMesh,
+                                                const int *vertexMap) const {
+    Vertex *newVertices = newMesh.getVertices().data();
+    VertexPositions &newPositions = newMesh.getPositions();
+    const QVector<Vertex> &vertices = controlMesh.vertices;
 
     // Face Points
-    for (int f = 0; f < controlMesh.numFaces(); f++) {
-        QVector3D coords = facePoint(faces[f]);
-        int i = controlMesh.numVerts() + faces[f].index;
-        // Face points always inherit the valence of the face
-        Vertex facePoint(coords, nullptr, faces[f].valence, i);
-        newVertices[i] = facePoint;
-    }
+    forEachBlock(controlMesh.numFaces(), [&](int first, int last) {
+        for (int f = first; f < last; f++) {
+            int i = layoutIdx(vertexMap, controlMesh.numVerts() + f);
+            newPositions.set(i, facePoint(controlMesh, f));
+            // Face points always inherit the valence of the face
+            newVertices[i] = Vertex(-1, controlMesh.faceValence(f));
+        }
+    });
 
-    // Edge Points
-    QVector<HalfEdge> &halfEdges = controlMesh.getHalfEdges();
-    for (int h = 0; h < controlMesh.numHalfEdges(); h++) {
-        HalfEdge currentEdge = halfEdges[h];
-        // Only create a new vertex per set of halfEdges (i.e. once per undirected
-        // edge)
-        if (h > currentEdge.twinIdx()) {
-            int v = controlMesh.numVerts() + controlMesh.numFaces() +
-                    currentEdge.edgeIdx();
-            int valence;
+    // Edge Points. These read the face points stored above.
+    const QVector<HalfEdge> &halfEdges = controlMesh.halfEdges;
+    forEachBlock(controlMesh.numHalfEdges(), [&](int first, int last) {
+        for (int h = first; h < last; h++) {
+            const HalfEdge &currentEdge = halfEdges[h];
+            // Only create a new vertex per set of halfEdges (i.e. once per
+            // undirected edge)
+            if (h > currentEdge.twinIdx()) {
+                int v = layoutIdx(vertexMap, controlMesh.numVerts() +
+                                                 controlMesh.numFaces() +
+                                                 currentEdge.edgeIdx());
+                int valence;
+                QVector3D coords;
+                if (currentEdge.isBoundaryEdge()) {
+                    coords = boundaryEdgePoint(controlMesh, h);
+                    valence = 3;
+                } else {
+                    coords = edgePoint(controlMesh, h, newMesh, vertexMap);
+                    valence = 4;
+                }
+                newPositions.set(v, coords);
+                newVertices[v] = Vertex(-1, valence);
+            }
+        }
+    });
+
+    // Vertex Points. These also read the stored face points.
+    forEachBlock(controlMesh.numVerts(), [&](int first, int last) {
+        for (int v = first; v < last; v++) {
             QVector3D coords;
-            if (currentEdge.isBoundaryEdge()) {
-                coords = boundaryEdgePoint(currentEdge);
-                valence = 3;
+            if (controlMesh.isBoundaryVertex(v)) {
+                coords = boundaryVertexPoint(controlMesh, v);
             } else {
-                coords = edgePoint(currentEdge);
-                valence = 4;
+                coords = vertexPoint(controlMesh, v, newMesh, vertexMap);
             }
-            newVertices[v] = Vertex(coords, nullptr, valence, v);
+            int i = layoutIdx(vertexMap, v);
+            newPositions.set(i, coords);
+            newVertices[i] = Vertex(-1, vertices[v].valence);
         }
-    }
+    });
+}
 
-    // Vertex Points
-    for (int v = 0; v < controlMesh.numVerts(); v++) {
-        QVector3D coords;
-        if (vertices[v].isBoundaryVertex()) {
-            coords = boundaryVertexPoint(vertices[v]);
-        } else {
-            coords = vertexPoint(vertices[v]);
+/**
+ * @brief CatmullClarkSubdivider::quadGeometryRefinement Performs the geometry
+ * refinement of a quad mesh in the canonical layout with the refinement
+ * kernels. The passes are the same as those of geometryRefinement, but process
+ * a vector of faces, edges or vertices at a time. Only regular vertices are
+ * handled by the kernels; the vertex points of the others are computed
+ * afterwards with the scalar formulas.
+ * @param controlMesh The control mesh. Its adjacency cache must be built.
+ * @param newMesh The new mesh, of which the vectors have the correct sizes.
+ */
+void CatmullClarkSubdivider::quadGeometryRefinement(Mesh &controlMesh,
+                                                    Mesh &newMesh) const {
+    Vertex *newVertices = newMesh.getVertices().data();
+    VertexPositions &newPositions = newMesh.getPositions();
+    const VertexPositions &positions = controlMesh.getPositions();
+    const VertexAdjacency *adjacency = controlMesh.getAdjacency();
+    const QVector<Vertex> &vertices = controlMesh.vertices;
+    const QVector<HalfEdge> &halfEdges = controlMesh.halfEdges;
+    int numVerts = controlMesh.numVerts();
+    int numFaces = controlMesh.numFaces();
+    int numEdges = controlMesh.numEdges();
+
+    // The edge kernel visits the edges rather than the half-edges, so that
+    // every lane produces an edge point. The buffer is kept with the control
+    // mesh, so subdividing a pooled level again does not allocate it.
+    QVector<int> &edgeHalfEdges = controlMesh.edgeHalfEdges;
+    edgeHalfEdges.resize(numEdges);
+    int *edgeHalfEdgeData = edgeHalfEdges.data();
+    forEachBlock(controlMesh.numHalfEdges(), [&](int first, int last) {
+        for (int h = first; h < last; h++) {
+            if (h > halfEdges[h].twinIdx()) {
+                edgeHalfEdgeData[halfEdges[h].edgeIdx()] = h;
+            }
         }
-        newVertices[v] = Vertex(coords, nullptr, vertices[v].valence, v);
-    }
+    });
+
+    QuadRefinementData data;
+    data.x = positions.x();
+    data.y = positions.y();
+    data.z = positions.z();
+    // HalfEdge consists of its origin, twin and edge index, which halfedge.h
+    // checks at compile time
+    data.halfEdges = reinterpret_cast<const int *>(halfEdges.constData());
+    data.edgeHalfEdges = edgeHalfEdges.constData();
+    data.neighborOffsets = adjacency->neighborOffsetData();
+    data.neighborIndices = adjacency->neighborIndexData();
+    data.faceOffsets = adjacency->faceOffsetData();
+    data.faceIndices = adjacency->faceIndexData();
+    data.newX = newPositions.x();
+    data.newY = newPositions.y();
+    data.newZ = newPositions.z();
+    data.numVerts = numVerts;
+    data.numFaces = numFaces;
+
+    forEachBlock(numFaces, [&](int first, int last) {
+        kernels->facePoints(data, first, last);
+        for (int f = first; f < last; f++) {
+            newVertices[numVerts + f] = Vertex(-1, 4);
+        }
+    });
+
+    forEachBlock(numEdges, [&](int first, int last) {
+        kernels->edgePoints(data, first, last);
+        for (int e = first; e < last; e++) {
+            bool boundary = halfEdges[edgeHalfEdgeData[e]].isBoundaryEdge();
+            newVertices[numVerts + numFaces + e] = Vertex(-1, boundary ? 3 : 4);
+        }
+    });
+
+    forEachBlock(numVerts, [&](int first, int last) {
+        kernels->vertexPoints(data, first, last);
+        for (int v = first; v < last; v++) {
+            if (adjacency->isBoundary(v)) {
+                newPositions.set(v, boundaryVertexPoint(controlMesh, v));
+            } else if (adjacency->numNeighbors(v) != 4 ||
+                       adjacency->numFaces(v) != 4) {
+                newPositions.set(v,
+                                 vertexPoint(controlMesh, v, newMesh, nullptr));
+            }
+            newVertices[v] = Vertex(-1, vertices[v].valence);
+        }
+    });
 }
 
 /**
@@ -125,24 +525,45 @@ void CatmullClarkSubdivider::geometryRefinement(Mesh &controlMesh,
  * S = old vertex point.
  * n = valence of the vertex.
  *
- * @param vertex The vertex to calculate the new position of. Note that this
- * vertex is the vertex from the control mesh.
+ * The one-ring is taken from the adjacency cache of the mesh if it has been
+ * built.
+ *
+ * @param mesh The control mesh.
+ * @param v Index of the vertex to calculate the new position of.
+ * @param newMesh The new mesh, which already holds the face points.
+ * @param vertexMap The index in the new mesh of every canonical vertex index,
+ * or nullptr for the canonical layout.
  * @return The coordinates of the new vertex point.
  */
-QVector3D CatmullClarkSubdivider::vertexPoint(const Vertex &vertex) const {
-    HalfEdge *edge = vertex.out;
+QVector3D CatmullClarkSubdivider::vertexPoint(const Mesh &mesh, int v,
+                                              const Mesh &newMesh,
+                                              const int *vertexMap) const {
+    const Vertex &vertex = mesh.vertices[v];
     QVector3D R;  // average of edge mid points
     QVector3D Q;  // average of face points
-    for (int i = 0; i < vertex.valence; i++) {
-        R += (edge->origin->coords + edge->next->origin->coords) / 2.0;
-        Q += facePoint(*edge->face);
-        edge = edge->prev->twin;
+    const VertexAdjacency *adjacency = mesh.getAdjacency();
+    if (adjacency != nullptr) {
+        const int *neighbors = adjacency->neighbors(v);
+        const int *faces = adjacency->faces(v);
+        for (int i = 0; i < adjacency->numFaces(v); i++) {
+            R += (mesh.position(v) + mesh.position(neighbors[i])) / 2.0;
+            Q += storedFacePoint(mesh, faces[i], newMesh, vertexMap);
+        }
+    } else {
+        int edge = vertex.out;
+        for (int i = 0; i < vertex.valence; i++) {
+            R += (mesh.position(mesh.originIdx(edge)) +
+                  mesh.position(mesh.originIdx(mesh.nextIdx(edge)))) /
+                 2.0;
+            Q += storedFacePoint(mesh, mesh.faceIdx(edge), newMesh, vertexMap);
+            edge = mesh.twinIdx(mesh.prevIdx(edge));
+        }
     }
     float n = float(vertex.valence);
     Q /= n;
     R /= n;
     // See Equation 1 of the aforementioned paper
-    return (Q + 2 * R + (vertex.coords * (n - 3.0f))) / n;
+    return (Q + 2 * R + (mesh.position(v) * (n - 3.0f))) / n;
 }
 
 /**
@@ -158,15 +579,24 @@ QVector3D CatmullClarkSubdivider::vertexPoint(const Vertex &vertex) const {
  * old vertex point.
  * S = old vertex point.
  *
- * @param vertex The vertex to calculate the new position of. Note that this
- * vertex is the vertex from the control mesh.
+ * @param mesh The control mesh.
+ * @param v Index of the vertex to calculate the new position of.
  * @return The coordinates of the new boundary vertex point.
  */
-QVector3D CatmullClarkSubdivider::boundaryVertexPoint(
-    const Vertex &vertex) const {
-    QVector3D boundPoint = vertex.coords * 2;
-    boundPoint += boundaryEdgePoint(*vertex.nextBoundaryHalfEdge());
-    boundPoint += boundaryEdgePoint(*vertex.prevBoundaryHalfEdge());
+QVector3D CatmullClarkSubdivider::boundaryVertexPoint(const Mesh &mesh,
+                                                      int v) const {
+    QVector3D boundPoint = mesh.position(v) * 2;
+    const VertexAdjacency *adjacency = mesh.getAdjacency();
+    if (adjacency != nullptr) {
+        QVector3D S = mesh.position(v);
+        boundPoint +=
+            (S + mesh.position(adjacency->nextBoundaryNeighbor(v))) / 2.0f;
+        boundPoint +=
+            (mesh.position(adjacency->prevBoundaryNeighbor(v)) + S) / 2.0f;
+    } else {
+        boundPoint += boundaryEdgePoint(mesh, mesh.nextBoundaryHalfEdge(v));
+        boundPoint += boundaryEdgePoint(mesh, mesh.prevBoundaryHalfEdge(v));
+    }
     return boundPoint / 4.0;
 }
 
@@ -182,118 +612,247 @@ QVector3D CatmullClarkSubdivider::boundaryVertexPoint(
  * edge.
  * M = the midpoint of the edge.
  *
- * @param edge One of the half-edges that lives on the edge to calculate
- * the edge point. Note that this half-edge is the half-edge from the control
- * mesh.
+ * @param mesh The control mesh.
+ * @param h Index of one of the half-edges that lives on the edge to calculate
+ * the edge point.
+ * @param newMesh The new mesh, which already holds the face points.
+ * @param vertexMap The index in the new mesh of every canonical vertex index,
+ * or nullptr for the canonical layout.
  * @return The coordinates of the new edge point.
  */
-QVector3D CatmullClarkSubdivider::edgePoint(const HalfEdge &edge) const {
-    QVector3D edgePt = boundaryEdgePoint(edge);
-    edgePt += (facePoint(*edge.face) + facePoint(*edge.twin->face)) / 2.0;
+QVector3D CatmullClarkSubdivider::edgePoint(const Mesh &mesh, int h,
+                                            const Mesh &newMesh,
+                                            const int *vertexMap) const {
+    QVector3D edgePt = boundaryEdgePoint(mesh, h);
+    edgePt +=
+        (storedFacePoint(mesh, mesh.faceIdx(h), newMesh, vertexMap) +
+         storedFacePoint(mesh, mesh.faceIdx(mesh.twinIdx(h)), newMesh,
+                         vertexMap)) /
+        2.0;
     return edgePt /= 2.0;
 }
 
 /**
  * @brief CatmullClarkSubdivider::boundaryEdgePoint Calculates the position of
  * the boundary edge point by taking the midpoint of the edge.
- * @param edge One of the half-edges that lives on the edge to calculate
- * the edge point. Note that this half-edge is the half-edge from the control
- * mesh.
+ * @param mesh The control mesh.
+ * @param h Index of one of the half-edges that lives on the edge to calculate
+ * the edge point.
  * @return The coordinates of the new boundary edge point.
  */
-QVector3D CatmullClarkSubdivider::boundaryEdgePoint(
-    const HalfEdge &edge) const {
-    return (edge.origin->coords + edge.next->origin->coords) / 2.0f;
+QVector3D CatmullClarkSubdivider::boundaryEdgePoint(const Mesh &mesh,
+                                                    int h) const {
+    return (mesh.position(mesh.originIdx(h)) +
+            mesh.position(mesh.originIdx(mesh.nextIdx(h)))) /
+           2.0f;
 }
 
 /**
  * @brief CatmullClarkSubdivider::facePoint Calculates the position of the face
  * point by averaging the positions of all vertices adjacent to the face.
- * @param face The face to calculate the face point of. Note that this face is
- * the face from the control mesh.
+ * @param mesh The control mesh.
+ * @param f Index of the face to calculate the face point of.
  * @return The coordinates of the new face point.
  */
-QVector3D CatmullClarkSubdivider::facePoint(const Face &face) const {
+QVector3D CatmullClarkSubdivider::facePoint(const Mesh &mesh, int f) const {
+    int valence = mesh.faceValence(f);
     QVector3D edgePt;
-    HalfEdge *edge = face.side;
+    int edge = mesh.sideIdx(f);
 
-    for (int side = 0; side < face.valence; side++) {
-        edgePt += edge->origin->coords;
-        edge = edge->next;
+    for (int side = 0; side < valence; side++) {
+        edgePt += mesh.position(mesh.originIdx(edge));
+        edge = mesh.nextIdx(edge);
     }
-    return edgePt / face.valence;
+    return edgePt / valence;
+}
+
+/**
+ * @brief CatmullClarkSubdivider::storedFacePoint Retrieves a face point that
+ * has already been written to the new mesh, so that the edge and vertex points
+ * around a face do not have to compute it again.
+ * @param mesh The control mesh.
+ * @param f Index of the face in the control mesh.
+ * @param newMesh The new mesh, which already holds the face points.
+ * @param vertexMap The index in the new mesh of every canonical vertex index,
+ * or nullptr for the canonical layout.
+ * @return The coordinates of the face point.
+ */
+QVector3D CatmullClarkSubdivider::storedFacePoint(const Mesh &mesh, int f,
+                                                  const Mesh &newMesh,
+                                                  const int *vertexMap) const {
+    return newMesh.position(layoutIdx(vertexMap, mesh.numVerts() + f));
 }
 
 /**
  * @brief CatmullClarkSubdivider::topologyRefinement Performs the topology
  * refinement. Every face is split into n new faces, where n is the valence of
- * the original face. Newly generated faces are all quads.
+ * the original face. Newly generated faces are all quads, and the four
+ * half-edges of new face h are 4h up to 4h + 3, so only the origins, twins and
+ * edge indices have to be set. When the half-edges are split on multiple
+ * threads, the outgoing half-edges of the new vertices are set afterwards.
  * @param controlMesh The control mesh.
  * @param newMesh The new mesh.
+ * @param vertexMap The index in the new mesh of every canonical vertex index,
+ * or nullptr for the canonical layout.
  */
 void CatmullClarkSubdivider::topologyRefinement(Mesh &controlMesh,
-                                                Mesh &newMesh) const {
-    for (int f = 0; f < newMesh.numFaces(); ++f) {
-        newMesh.faces[f].index = f;
-        newMesh.faces[f].valence = 4;
-    }
-
+                                                Mesh &newMesh,
+                                                const int *vertexMap) const {
+    bool parallel = runsInParallel(controlMesh.numHalfEdges());
     // Split halfedges
-    for (int h = 0; h < controlMesh.numHalfEdges(); ++h) {
-        HalfEdge *edge = &controlMesh.halfEdges[h];
-
-        int h1 = 4 * h;
-        int h2 = 4 * h + 1;
-        int h3 = 4 * h + 2;
-        int h4 = 4 * h + 3;
-
-        int twinIdx1 = edge->twinIdx() < 0 ? -1 : 4 * edge->twin->next->index + 3;
-        int twinIdx2 = 4 * edge->next->index + 2;
-        int twinIdx3 = 4 * edge->prev->index + 1;
-        int twinIdx4 = 4 * edge->prev->twinIdx();
-
-        int vertIdx1 = edge->origin->index;
-        int vertIdx2 =
-        controlMesh.numVerts() + controlMesh.numFaces() + edge->edgeIndex;
-        int vertIdx3 = controlMesh.numVerts() + edge->faceIdx();
-        int vertIdx4 =
-        controlMesh.numVerts() + controlMesh.numFaces() + edge->prev->edgeIndex;
-
-        int edgeIdx1 = 2 * edge->edgeIndex + (h > edge->twinIdx() ? 0 : 1);
-        int edgeIdx2 = 2 * controlMesh.numEdges() + h;
-        int edgeIdx3 = 2 * controlMesh.numEdges() + edge->prev->index;
-        int edgeIdx4 = 2 * edge->prev->edgeIndex + (edge->prevIdx() > edge->prev->twinIdx() ? 1 : 0);
-
-        setHalfEdgeData(newMesh, h1, edgeIdx1, vertIdx1, twinIdx1);
-        setHalfEdgeData(newMesh, h2, edgeIdx2, vertIdx2, twinIdx2);
-        setHalfEdgeData(newMesh, h3, edgeIdx3, vertIdx3, twinIdx3);
-        setHalfEdgeData(newMesh, h4, edgeIdx4, vertIdx4, twinIdx4);
+    forEachBlock(controlMesh.numHalfEdges(), [&](int first, int last) {
+        for (int h = first; h < last; ++h) {
+            const HalfEdge &edge = controlMesh.halfEdges[h];
+            int prev = controlMesh.prevIdx(h);
+            const HalfEdge &prevEdge = controlMesh.halfEdges[prev];
+
+            int h1 = 4 * h;
+            int h2 = 4 * h + 1;
+            int h3 = 4 * h + 2;
+            int h4 = 4 * h + 3;
+
+            int twinIdx1 = edge.twinIdx() < 0 ? -1 : 4 * controlMesh.nextIdx(edge.twin) + 3;
+            int twinIdx2 = 4 * controlMesh.nextIdx(h) + 2;
+            int twinIdx3 = 4 * prev + 1;
+            int twinIdx4 = 4 * prevEdge.twinIdx();
+
+            int vertIdx1 = layoutIdx(vertexMap, edge.origin);
+            int vertIdx2 = layoutIdx(vertexMap, controlMesh.numVerts() +
+                                                    controlMesh.numFaces() +
+                                                    edge.edgeIndex);
+            int vertIdx3 =
+                layoutIdx(vertexMap, controlMesh.numVerts() + controlMesh.faceIdx(h));
+            int vertIdx4 = layoutIdx(vertexMap, controlMesh.numVerts() +
+                                                    controlMesh.numFaces() +
+                                                    prevEdge.edgeIndex);
+
+            int edgeIdx1 = 2 * edge.edgeIndex + (h > edge.twinIdx() ? 0 : 1);
+            int edgeIdx2 = 2 * controlMesh.numEdges() + h;
+            int edgeIdx3 = 2 * controlMesh.numEdges() + prev;
+            int edgeIdx4 = 2 * prevEdge.edgeIndex + (prev > prevEdge.twinIdx() ? 1 : 0);
+
+            setHalfEdgeData(newMesh, h1, edgeIdx1, vertIdx1, twinIdx1, !parallel);
+            setHalfEdgeData(newMesh, h2, edgeIdx2, vertIdx2, twinIdx2, !parallel);
+            setHalfEdgeData(newMesh, h3, edgeIdx3, vertIdx3, twinIdx3, !parallel);
+            setHalfEdgeData(newMesh, h4, edgeIdx4, vertIdx4, twinIdx4, !parallel);
+        }
+    });
+    if (parallel) {
+        setOutgoingHalfEdges(controlMesh, newMesh, vertexMap);
     }
 }
 
 /**
- * @brief LoopSubdivider::setHalfEdgeData Sets the data of a single half-edge
- * (and the corresponding vertex and face)
+ * @brief CatmullClarkSubdivider::setHalfEdgeData Sets the data of a single
+ * half-edge (and the outgoing half-edge of its origin). The next half-edge and
+ * the face follow from the indexing rules: the four half-edges of a new face
+ * are stored consecutively.
  * @param newMesh The new mesh this half-edge will live in.
  * @param h Index of the half-edge.
  * @param edgeIdx Index of the (undirected) edge this half-edge will belong to.
  * @param vertIdx Index of the vertex that this half-edge will originate from.
  * @param twinIdx Index of the twin of this half-edge. -1 if the half-edge lies
  * on a boundary.
+ * @param setOut Whether to set the outgoing half-edge of the origin. Since the
+ * half-edges are set in increasing order, the outgoing half-edge of a vertex
+ * ends up being the last half-edge that originates from it.
  */
 void CatmullClarkSubdivider::setHalfEdgeData(Mesh &newMesh, int h, int edgeIdx,
-                                             int vertIdx, int twinIdx) const {
-    HalfEdge *halfEdge = &newMesh.halfEdges[h];
-
-    halfEdge->edgeIndex = edgeIdx;
-    halfEdge->index = h;
-    halfEdge->origin = &newMesh.vertices[vertIdx];
-    halfEdge->face = &newMesh.faces[halfEdge->faceIdx()];
-    halfEdge->next = &newMesh.halfEdges[halfEdge->nextIdx()];
-    halfEdge->prev = &newMesh.halfEdges[halfEdge->prevIdx()];
-    halfEdge->twin = twinIdx < 0 ? nullptr : &newMesh.halfEdges[twinIdx];
-
-    halfEdge->origin->out = halfEdge;
-    halfEdge->origin->index = vertIdx;
-    halfEdge->face->side = halfEdge;
+                                             int vertIdx, int twinIdx,
+                                             bool setOut) const {
+    newMesh.halfEdges[h] = HalfEdge(vertIdx, twinIdx, edgeIdx);
+    if (setOut) {
+        newMesh.vertices[vertIdx].out = h;
+    }
+}
+
+/**
+ * @brief CatmullClarkSubdivider::setOutgoingHalfEdges Sets the outgoing
+ * half-edge of every new vertex to the last half-edge that originates from it,
+ * which is the half-edge a single-threaded split would leave it at. Every new
+ * vertex is visited once, so this can be done on multiple threads as well.
+ * Child half-edge 4h + k originates from:
+ * k = 0: the vertex point of the origin of h,
+ * k = 1: the edge point of h,
+ * k = 2: the face point of the face of h,
+ * k = 3: the edge point of the previous half-edge of h.
+ * @param mesh The control mesh.
+ * @param newMesh The new mesh, of which the half-edges have been set.
+ * @param vertexMap The index in the new mesh of every canonical vertex index,
+ * or nullptr for the canonical layout.
+ */
+void CatmullClarkSubdivider::setOutgoingHalfEdges(const Mesh &mesh,
+                                                  Mesh &newMesh,
+                                                  const int *vertexMap) const {
+    Vertex *newVertices = newMesh.vertices.data();
+    int numVerts = mesh.numVerts();
+    int firstEdgePoint = numVerts + mesh.numFaces();
+
+    forEachBlock(mesh.numFaces(), [&](int first, int last) {
+        for (int f = first; f < last; f++) {
+            int h = mesh.sideIdx(f);
+            int lastHalfEdge = h;
+            for (int i = 1; i < mesh.faceValence(f); i++) {
+                h = mesh.nextIdx(h);
+                lastHalfEdge = qMax(lastHalfEdge, h);
+            }
+            newVertices[layoutIdx(vertexMap, numVerts + f)].out =
+                4 * lastHalfEdge + 2;
+        }
+    });
+
+    forEachBlock(mesh.numHalfEdges(), [&](int first, int last) {
+        for (int h = first; h < last; h++) {
+            int twin = mesh.twinIdx(h);
+            if (h > twin) {
+                // 4 * twin + 1 is always lower than 4 * h + 1
+                int out = qMax(4 * h + 1, 4 * mesh.nextIdx(h) + 3);
+                if (twin >= 0) {
+                    out = qMax(out, 4 * mesh.nextIdx(twin) + 3);
+                }
+                int v = firstEdgePoint + mesh.edgeIdx(h);
+                newVertices[layoutIdx(vertexMap, v)].out = out;
+            }
+        }
+    });
+
+    forEachBlock(numVerts, [&](int first, int last) {
+        for (int v = first; v < last; v++) {
+            int h = lastOutgoingHalfEdge(mesh, v);
+            newVertices[layoutIdx(vertexMap, v)].out = h < 0 ? -1 : 4 * h;
+        }
+    });
+}
+
+/**
+ * @brief CatmullClarkSubdivider::lastOutgoingHalfEdge Finds the half-edge with
+ * the highest index that originates from a vertex, by walking around the
+ * vertex in both directions.
+ * @param mesh The mesh.
+ * @param v Index of the vertex.
+ * @return Index of the last outgoing half-edge, or -1 if the vertex is not part
+ * of any face.
+ */
+int CatmullClarkSubdivider::lastOutgoingHalfEdge(const Mesh &mesh,
+                                                 int v) const {
+    int start = mesh.outIdx(v);
+    if (start < 0) {
+        return -1;
+    }
+    int lastHalfEdge = start;
+    int h = mesh.twinIdx(mesh.prevIdx(start));
+    while (h >= 0 && h != start) {
+        lastHalfEdge = qMax(lastHalfEdge, h);
+        h = mesh.twinIdx(mesh.prevIdx(h));
+    }
+    if (h < 0) {
+        // Boundary vertex: walk the other way as well
+        h = mesh.twinIdx(start);
+        while (h >= 0) {
+            h = mesh.nextIdx(h);
+            lastHalfEdge = qMax(lastHalfEdge, h);
+            h = mesh.twinIdx(h);
+        }
+    }
+    return lastHalfEdge;
 }
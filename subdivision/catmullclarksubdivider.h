@@ -1,31 +1,93 @@
 #ifndef CATMULL_CLARK_SUBDIVIDER_H
 #define CATMULL_CLARK_SUBDIVIDER_H
 
+#include <functional>
+
 #include "mesh/mesh.h"
+#include "refinementkernels.h"
 #include "subdivider.h"
+#include "topologycache.h"
 
 /**
  * @brief The CatmullClarkSubdivider class is a subdivider class that performs
  * Catmull-Clark subdivision on meshes.
+ *
+ * In the canonical vertex layout, the vertices of a subdivided mesh are the
+ * vertex points, followed by the face points and the edge points. In the
+ * face-major layout, the new vertices are instead numbered face by face: the
+ * face point of a face comes first, followed by the edge points and vertex
+ * points that were not numbered by an earlier face. Since the children of a
+ * face are stored next to each other, all levels then keep the vertices of
+ * every control face close together. The half-edges and faces are the same in
+ * either layout.
+ *
+ * Every new vertex and half-edge is written by exactly one iteration of the
+ * refinement passes, so the passes can be run on multiple threads. The result
+ * does not depend on the number of threads.
+ *
+ * When only some vertices of a mesh have moved, the positions of a subdivided
+ * mesh can be updated in place. Only the points of the faces around the moved
+ * vertices change, so the region to update grows by one ring every level and
+ * the cost is proportional to its size rather than to the size of the mesh.
+ *
+ * With a TopologyCache, the topology of a subdivided mesh is taken from the
+ * cache when a mesh with the same connectivity was subdivided before, so only
+ * the positions are computed.
+ *
+ * Quad meshes with an adjacency cache are refined in the canonical layout by
+ * the vectorized refinement kernels of the most capable instruction set of the
+ * processor. These give the same result as the scalar passes.
  */
 class CatmullClarkSubdivider : public Subdivider {
  public:
-  CatmullClarkSubdivider();
+  enum class VertexLayout { Canonical, FaceMajor };
+
+  CatmullClarkSubdivider(VertexLayout layout = VertexLayout::Canonical,
+                         int numThreads = 1);
   Mesh subdivide(Mesh& mesh) const override;
+  void subdivide(Mesh& mesh, Mesh& newMesh) const;
+  void updatePositions(Mesh& mesh, Mesh& newMesh,
+                       const QVector<int>& dirtyVertices,
+                       QVector<int>& newDirtyVertices) const;
+  void updateLevels(QVector<Mesh>& levels,
+                    const QVector<int>& dirtyVertices) const;
+
+  bool setSimdIsa(SimdIsa isa);
+  inline SimdIsa simdIsa() const { return kernels->isa; }
+  inline void setTopologyCache(TopologyCache* cache) { topologyCache = cache; }
 
  private:
   void reserveSizes(Mesh& mesh, Mesh& newMesh) const;
-  void geometryRefinement(Mesh& mesh, Mesh& newMesh) const;
-  void topologyRefinement(Mesh& mesh, Mesh& newMesh) const;
+  void faceMajorVertexMap(const Mesh& mesh, Mesh& newMesh) const;
+  void geometryRefinement(Mesh& mesh, Mesh& newMesh,
+                          const int* vertexMap) const;
+  void quadGeometryRefinement(Mesh& mesh, Mesh& newMesh) const;
+  void topologyRefinement(Mesh& mesh, Mesh& newMesh,
+                          const int* vertexMap) const;
 
   void setHalfEdgeData(Mesh& newMesh, int h, int edgeIdx, int vertIdx,
-                       int twinIdx) const;
+                       int twinIdx, bool setOut) const;
+  void setOutgoingHalfEdges(const Mesh& mesh, Mesh& newMesh,
+                            const int* vertexMap) const;
+  int lastOutgoingHalfEdge(const Mesh& mesh, int v) const;
+
+  bool runsInParallel(int count) const;
+  void forEachBlock(int count, const std::function<void(int, int)>& body) const;
+
+  QVector3D facePoint(const Mesh& mesh, int f) const;
+  QVector3D storedFacePoint(const Mesh& mesh, int f, const Mesh& newMesh,
+                            const int* vertexMap) const;
+  QVector3D edgePoint(const Mesh& mesh, int h, const Mesh& newMesh,
+                      const int* vertexMap) const;
+  QVector3D boundaryEdgePoint(const Mesh& mesh, int h) const;
+  QVector3D vertexPoint(const Mesh& mesh, int v, const Mesh& newMesh,
+                        const int* vertexMap) const;
+  QVector3D boundaryVertexPoint(const Mesh& mesh, int v) const;
 
-  QVector3D facePoint(const Face& face) const;
-  QVector3D edgePoint(const HalfEdge& edge) const;
-  QVector3D boundaryEdgePoint(const HalfEdge& edge) const;
-  QVector3D vertexPoint(const Vertex& vertex) const;
-  QVector3D boundaryVertexPoint(const Vertex& vertex) const;
+  VertexLayout layout;
+  int numThreads;
+  const RefinementKernels* kernels;
+  TopologyCache* topologyCache = nullptr;
 };
 
 #endif  // CATMULL_CLARK_SUBDIVIDER_H
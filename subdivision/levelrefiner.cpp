@@ -0,0 +1,427 @@
+#include "levelrefiner.h"
+
+#include "util/parallel.h"
+
+/**
+ * @brief The HalfEdgeSplitter class derives the half-edges of any subdivision
+ * level from the control mesh, by splitting control half-edges repeatedly
+ * according to the rules of CatmullClarkSubdivider::topologyRefinement. Levels
+ * above zero are quad meshes, so the next, previous and face of their
+ * half-edges follow from the index.
+ */
+class HalfEdgeSplitter {
+ public:
+  HalfEdgeSplitter(const Mesh& controlMesh, const QVector<LevelSizes>& sizes)
+      : controlMesh(controlMesh), sizes(sizes) {}
+
+  inline int nextIdx(int level, int h) const {
+    return level == 0 ? controlMesh.nextIdx(h) : (h & 3) == 3 ? h - 3 : h + 1;
+  }
+  inline int prevIdx(int level, int h) const {
+    return level == 0 ? controlMesh.prevIdx(h) : (h & 3) == 0 ? h + 3 : h - 1;
+  }
+  inline int faceIdx(int level, int h) const {
+    return level == 0 ? controlMesh.faceIdx(h) : h >> 2;
+  }
+
+  /**
+   * @brief numRoots Retrieves the number of elements forEachFace can be split
+   * over: the control faces for level 0, and the control half-edges otherwise.
+   * @param level The level of the faces.
+   * @return The number of roots.
+   */
+  inline int numRoots(int level) const {
+    return level == 0 ? controlMesh.numFaces() : controlMesh.numHalfEdges();
+  }
+
+  /**
+   * @brief forEachFace Invokes the body for every face of a level that
+   * descends from the roots [first, last). The body is passed the index of the
+   * face, its valence, and the indices and data of its half-edges, starting at
+   * the side of the face.
+   * @param level The level of the faces.
+   * @param first The first root.
+   * @param last The end of the range of roots (exclusive).
+   * @param body The function to invoke.
+   */
+  template <typename Body>
+  void forEachFace(int level, int first, int last, const Body& body) const {
+    if (level == 0) {
+      // Reused for every face, so they only grow for faces of high valence
+      QVector<int> indices;
+      QVector<HalfEdge> halfEdges;
+      for (int f = first; f < last; f++) {
+        int valence = controlMesh.faceValence(f);
+        indices.resize(valence);
+        halfEdges.resize(valence);
+        int h = controlMesh.sideIdx(f);
+        for (int i = 0; i < valence; i++) {
+          indices[i] = h;
+          halfEdges[i] = controlHalfEdge(h);
+          h = controlMesh.nextIdx(h);
+        }
+        body(f, valence, indices.constData(), halfEdges.constData());
+      }
+      return;
+    }
+    for (int h = first; h < last; h++) {
+      int prev = controlMesh.prevIdx(h);
+      descend(level, 0, h, controlHalfEdge(h), prev, controlHalfEdge(prev),
+              body);
+    }
+  }
+
+ private:
+  inline HalfEdge controlHalfEdge(int h) const {
+    return HalfEdge(controlMesh.originIdx(h), controlMesh.twinIdx(h),
+                    controlMesh.edgeIdx(h));
+  }
+
+  /**
+   * @brief split Computes the four children of a half-edge.
+   * @param level The level of the half-edge.
+   * @param h Index of the half-edge.
+   * @param edge The half-edge.
+   * @param prev Index of the previous half-edge.
+   * @param prevEdge The previous half-edge.
+   * @param children Is set to half-edges 4h up to 4h + 3 of the next level.
+   */
+  void split(int level, int h, const HalfEdge& edge, int prev,
+             const HalfEdge& prevEdge, HalfEdge* children) const {
+    const LevelSizes& size = sizes[level];
+    int firstEdgePoint = size.numVerts + size.numFaces;
+    children[0] = HalfEdge(
+        edge.origin, edge.twin < 0 ? -1 : 4 * nextIdx(level, edge.twin) + 3,
+        2 * edge.edgeIndex + (h > edge.twin ? 0 : 1));
+    children[1] = HalfEdge(firstEdgePoint + edge.edgeIndex,
+                           4 * nextIdx(level, h) + 2, 2 * size.numEdges + h);
+    children[2] = HalfEdge(size.numVerts + faceIdx(level, h), 4 * prev + 1,
+                           2 * size.numEdges + prev);
+    children[3] =
+        HalfEdge(firstEdgePoint + prevEdge.edgeIndex, 4 * prevEdge.twin,
+                 2 * prevEdge.edgeIndex + (prev > prevEdge.twin ? 1 : 0));
+  }
+
+  /**
+   * @brief descend Splits a half-edge until the children are at the requested
+   * level. The children of half-edge h form face h of the next level, and the
+   * previous half-edge of every child is one of its siblings.
+   */
+  template <typename Body>
+  void descend(int targetLevel, int level, int h, const HalfEdge& edge,
+               int prev, const HalfEdge& prevEdge, const Body& body) const {
+    HalfEdge children[4];
+    split(level, h, edge, prev, prevEdge, children);
+    if (level + 1 == targetLevel) {
+      // Listed from the side of the new face, half-edge 4h + 3
+      const int indices[4] = {4 * h + 3, 4 * h, 4 * h + 1, 4 * h + 2};
+      const HalfEdge halfEdges[4] = {children[3], children[0], children[1],
+                                     children[2]};
+      body(h, 4, indices, halfEdges);
+      return;
+    }
+    for (int k = 0; k < 4; k++) {
+      int prevChild = (k + 3) & 3;
+      descend(targetLevel, level + 1, 4 * h + k, children[k],
+              4 * h + prevChild, children[prevChild], body);
+    }
+  }
+
+  const Mesh& controlMesh;
+  const QVector<LevelSizes>& sizes;
+};
+
+/**
+ * @brief LevelRefiner::LevelRefiner Creates a new level refiner.
+ * @param numThreads The number of threads used to refine. The result does not
+ * depend on the number of threads.
+ */
+LevelRefiner::LevelRefiner(int numThreads) : numThreads(numThreads) {}
+
+/**
+ * @brief LevelRefiner::levelSizes Computes the number of elements of every
+ * subdivision level up to the requested one.
+ * @param controlMesh The control mesh.
+ * @param level The highest level.
+ * @return The sizes of levels 0 up to and including the requested level.
+ */
+QVector<LevelSizes> LevelRefiner::levelSizes(const Mesh& controlMesh,
+                                             int level) {
+    QVector<LevelSizes> sizes(level + 1);
+    sizes[0] = {controlMesh.numVerts(), controlMesh.numFaces(),
+                controlMesh.numEdges(), controlMesh.numHalfEdges()};
+    for (int k = 1; k <= level; k++) {
+        const LevelSizes& previous = sizes[k - 1];
+        sizes[k] = {previous.numVerts + previous.numFaces + previous.numEdges,
+                    previous.numHalfEdges,
+                    2 * previous.numEdges + previous.numHalfEdges,
+                    4 * previous.numHalfEdges};
+    }
+    return sizes;
+}
+
+/**
+ * @brief LevelRefiner::refine Subdivides a control mesh to a subdivision level.
+ * @param controlMesh The control mesh.
+ * @param level The number of subdivision steps.
+ * @return The mesh at the requested level.
+ */
+Mesh LevelRefiner::refine(const Mesh& controlMesh, int level) const {
+    Mesh result;
+    refine(controlMesh, level, result);
+    return result;
+}
+
+/**
+ * @brief LevelRefiner::refine Subdivides a control mesh to a subdivision level
+ * into an existing mesh, replacing its contents. The positions are computed
+ * first, so that their scratch buffers are released before the topology is
+ * allocated.
+ * @param controlMesh The control mesh.
+ * @param level The number of subdivision steps.
+ * @param result The mesh to store the result in.
+ */
+void LevelRefiner::refine(const Mesh& controlMesh, int level,
+                          Mesh& result) const {
+    if (level <= 0) {
+        result = controlMesh;
+        return;
+    }
+    result.clear();
+    QVector<LevelSizes> sizes = levelSizes(controlMesh, level);
+
+    // The positions of every level are computed from those of the previous
+    // level, alternating between two buffers. The last level is written to
+    // the result directly.
+    VertexPositions buffers[2];
+    const VertexPositions* positions = &controlMesh.getPositions();
+    for (int k = 0; k < level; k++) {
+        VertexPositions& newPositions =
+            k + 1 == level ? result.getPositions() : buffers[k & 1];
+        refinePositions(controlMesh, sizes, k, *positions, newPositions);
+        positions = &newPositions;
+    }
+    buffers[0] = VertexPositions();
+    buffers[1] = VertexPositions();
+
+    refineTopology(controlMesh, sizes, level, result);
+}
+
+/**
+ * @brief LevelRefiner::refineTopology Generates only the topology of a
+ * subdivision level into an existing mesh, replacing its contents. The
+ * positions of the result are left empty, for callers that compute them in
+ * another way.
+ * @param controlMesh The control mesh.
+ * @param level The number of subdivision steps, at least 1.
+ * @param result The mesh to store the topology in.
+ */
+void LevelRefiner::refineTopology(const Mesh& controlMesh, int level,
+                                  Mesh& result) const {
+    result.clear();
+    refineTopology(controlMesh, levelSizes(controlMesh, level), level, result);
+}
+
+/**
+ * @brief LevelRefiner::refinePositions Computes the positions of the next
+ * level from those of a level, in three passes like
+ * CatmullClarkSubdivider::geometryRefinement: first the face points, then the
+ * edge points and finally the vertex points. For the vertex points, every
+ * half-edge adds its edge midpoint and face point to the sums of its origin,
+ * since the rings of the vertices are not stored.
+ * @param controlMesh The control mesh.
+ * @param sizes The sizes of the levels.
+ * @param level The level of the positions.
+ * @param positions The positions of the vertices of the level.
+ * @param newPositions Is set to the positions of the vertices of the next
+ * level.
+ */
+void LevelRefiner::refinePositions(const Mesh& controlMesh,
+                                   const QVector<LevelSizes>& sizes, int level,
+                                   const VertexPositions& positions,
+                                   VertexPositions& newPositions) const {
+    HalfEdgeSplitter splitter(controlMesh, sizes);
+    int numVerts = sizes[level].numVerts;
+    int firstEdgePoint = numVerts + sizes[level].numFaces;
+    int numRoots = splitter.numRoots(level);
+    newPositions.resize(sizes[level + 1].numVerts);
+
+    // Face Points
+    parallelFor(
+        0, numRoots,
+        [&](int first, int last) {
+            splitter.forEachFace(
+                level, first, last,
+                [&](int f, int valence, const int*, const HalfEdge* halfEdges) {
+                    QVector3D facePt;
+                    for (int i = 0; i < valence; i++) {
+                        facePt += positions.at(halfEdges[i].origin);
+                    }
+                    newPositions.set(numVerts + f, facePt / valence);
+                });
+        },
+        numThreads);
+
+    // Edge Points. These read the face points stored above.
+    parallelFor(
+        0, numRoots,
+        [&](int first, int last) {
+            splitter.forEachFace(
+                level, first, last,
+                [&](int f, int valence, const int* indices,
+                    const HalfEdge* halfEdges) {
+                    for (int i = 0; i < valence; i++) {
+                        const HalfEdge& edge = halfEdges[i];
+                        if (indices[i] < edge.twin) {
+                            continue;
+                        }
+                        int target = halfEdges[(i + 1) % valence].origin;
+                        QVector3D edgePt =
+                            (positions.at(edge.origin) + positions.at(target)) /
+                            2.0f;
+                        if (edge.twin >= 0) {
+                            int twinFace = splitter.faceIdx(level, edge.twin);
+                            edgePt += (newPositions.at(numVerts + f) +
+                                       newPositions.at(numVerts + twinFace)) /
+                                      2.0;
+                            edgePt /= 2.0;
+                        }
+                        newPositions.set(firstEdgePoint + edge.edgeIndex,
+                                         edgePt);
+                    }
+                });
+        },
+        numThreads);
+
+    // Vertex Points. Half-edges sharing an origin may descend from different
+    // roots, so the sums are gathered on a single thread.
+    QVector<QVector3D> edgeSums(numVerts);
+    QVector<QVector3D> faceSums(numVerts);
+    // The midpoints of the outgoing and incoming boundary edge of every
+    // boundary vertex
+    QVector<QVector3D> nextBoundaryMids(numVerts);
+    QVector<QVector3D> prevBoundaryMids(numVerts);
+    QVector<int> valences(numVerts, 0);
+    QVector<char> boundary(numVerts, 0);
+    QVector3D* edgeSumData = edgeSums.data();
+    QVector3D* faceSumData = faceSums.data();
+    QVector3D* nextMidData = nextBoundaryMids.data();
+    QVector3D* prevMidData = prevBoundaryMids.data();
+    int* valenceData = valences.data();
+    char* boundaryData = boundary.data();
+    splitter.forEachFace(
+        level, 0, numRoots,
+        [&](int f, int valence, const int*, const HalfEdge* halfEdges) {
+            QVector3D facePt = newPositions.at(numVerts + f);
+            for (int i = 0; i < valence; i++) {
+                int v = halfEdges[i].origin;
+                int target = halfEdges[(i + 1) % valence].origin;
+                QVector3D S = positions.at(v);
+                QVector3D neighbor = positions.at(target);
+                edgeSumData[v] += (S + neighbor) / 2.0;
+                faceSumData[v] += facePt;
+                valenceData[v]++;
+                if (halfEdges[i].twin < 0) {
+                    nextMidData[v] = (S + neighbor) / 2.0f;
+                    prevMidData[target] = (S + neighbor) / 2.0f;
+                    boundaryData[v] = 1;
+                    boundaryData[target] = 1;
+                }
+            }
+        });
+
+    parallelFor(
+        0, numVerts,
+        [&](int first, int last) {
+            for (int v = first; v < last; v++) {
+                QVector3D S = positions.at(v);
+                if (valenceData[v] == 0) {
+                    // Vertices that are not part of any face stay in place
+                    newPositions.set(v, S);
+                } else if (boundaryData[v]) {
+                    // See CatmullClarkSubdivider::boundaryVertexPoint
+                    QVector3D boundPoint = S * 2;
+                    boundPoint += nextMidData[v];
+                    boundPoint += prevMidData[v];
+                    newPositions.set(v, boundPoint / 4.0);
+                } else {
+                    // See CatmullClarkSubdivider::vertexPoint
+                    float n = float(valenceData[v]);
+                    QVector3D Q = faceSumData[v] / n;
+                    QVector3D R = edgeSumData[v] / n;
+                    newPositions.set(v, (Q + 2 * R + (S * (n - 3.0f))) / n);
+                }
+            }
+        },
+        numThreads);
+}
+
+/**
+ * @brief LevelRefiner::refineTopology Generates the half-edges of a level by
+ * splitting every control half-edge down to that level, and derives the
+ * vertices from them. Like in the subdivider, the outgoing half-edge of a
+ * vertex is the last half-edge that originates from it, and new vertices
+ * inherit the valence of the vertex, face or edge they were created for:
+ * boundary edge points have a valence of 3.
+ * @param controlMesh The control mesh.
+ * @param sizes The sizes of the levels.
+ * @param level The level to generate, at least 1.
+ * @param result The mesh to store the topology in.
+ */
+void LevelRefiner::refineTopology(const Mesh& controlMesh,
+                                  const QVector<LevelSizes>& sizes, int level,
+                                  Mesh& result) const {
+    HalfEdgeSplitter splitter(controlMesh, sizes);
+    const LevelSizes& size = sizes[level];
+    result.halfEdges.resize(size.numHalfEdges);
+    result.quadTopology = true;
+    result.edgeCount = size.numEdges;
+
+    HalfEdge* newHalfEdges = result.halfEdges.data();
+    parallelFor(
+        0, splitter.numRoots(level),
+        [&](int first, int last) {
+            splitter.forEachFace(
+                level, first, last,
+                [&](int, int valence, const int* indices,
+                    const HalfEdge* halfEdges) {
+                    for (int i = 0; i < valence; i++) {
+                        newHalfEdges[indices[i]] = halfEdges[i];
+                    }
+                });
+        },
+        numThreads);
+
+    result.vertices.fill(Vertex(-1, 0), size.numVerts);
+    Vertex* vertices = result.vertices.data();
+    // Boundary vertices are marked by a negative valence until the end
+    for (int h = 0; h < size.numHalfEdges; h++) {
+        Vertex& vertex = vertices[newHalfEdges[h].origin];
+        vertex.out = h;
+        vertex.valence += vertex.valence < 0 ? -1 : 1;
+        if (newHalfEdges[h].twin < 0 && vertex.valence > 0) {
+            vertex.valence = -vertex.valence;
+        }
+    }
+    parallelFor(
+        0, size.numVerts,
+        [&](int first, int last) {
+            for (int v = first; v < last; v++) {
+                Vertex& vertex = vertices[v];
+                if (vertex.valence >= 0) {
+                    continue;
+                }
+                vertex.valence = -vertex.valence;
+                // Find the level the vertex was created at
+                int k = level;
+                while (k > 0 && v < sizes[k - 1].numVerts) {
+                    k--;
+                }
+                if (k > 0 && v >= sizes[k - 1].numVerts + sizes[k - 1].numFaces) {
+                    // A boundary edge point has one more edge than faces
+                    vertex.valence++;
+                }
+            }
+        },
+        numThreads);
+}
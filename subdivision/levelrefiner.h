@@ -0,0 +1,60 @@
+#ifndef LEVEL_REFINER_H
+#define LEVEL_REFINER_H
+
+#include <QVector>
+
+#include "mesh/mesh.h"
+
+/**
+ * @brief The LevelSizes struct holds the number of elements of a subdivision
+ * level.
+ */
+struct LevelSizes {
+  int numVerts;
+  int numFaces;
+  int numEdges;
+  int numHalfEdges;
+};
+
+/**
+ * @brief The LevelRefiner class subdivides a control mesh straight to a single
+ * subdivision level, without constructing the levels in between. The result is
+ * the same mesh the CatmullClarkSubdivider produces in its canonical layout
+ * when applied level after level.
+ *
+ * The children of half-edge h are half-edges 4h up to 4h + 3, so every
+ * half-edge of level k descends from control half-edge h >> 2k, and can be
+ * derived from that control half-edge by splitting it k times. The topology of
+ * level k is generated that way, control half-edge by control half-edge, with
+ * only the current path of splits held in memory. The positions are computed
+ * level by level in two alternating buffers, visiting the faces of every level
+ * in the same way. Only the positions of the previous level and the final
+ * level are therefore kept, instead of the full topology of every level.
+ *
+ * Face and edge points are computed exactly like the subdivider does. The
+ * vertex points of interior vertices sum the contributions of their ring in
+ * half-edge order rather than in ring order, so they may differ from those of
+ * the subdivider in the last bits.
+ */
+class LevelRefiner {
+ public:
+  LevelRefiner(int numThreads = 1);
+  Mesh refine(const Mesh& controlMesh, int level) const;
+  void refine(const Mesh& controlMesh, int level, Mesh& result) const;
+  void refineTopology(const Mesh& controlMesh, int level, Mesh& result) const;
+
+  static QVector<LevelSizes> levelSizes(const Mesh& controlMesh, int level);
+
+ private:
+  void refinePositions(const Mesh& controlMesh,
+                       const QVector<LevelSizes>& sizes, int level,
+                       const VertexPositions& positions,
+                       VertexPositions& newPositions) const;
+  void refineTopology(const Mesh& controlMesh,
+                      const QVector<LevelSizes>& sizes, int level,
+                      Mesh& result) const;
+
+  int numThreads;
+};
+
+#endif  // LEVEL_REFINER_H
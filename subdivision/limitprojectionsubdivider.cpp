@@ -14,49 +14,70 @@ LimitPositionSubdivider::LimitPositionSubdivider() {}
  * @return Resulting mesh with all vertex points in their limit position.
  */
 Mesh LimitPositionSubdivider::subdivide(Mesh &mesh) const {
+    // The topology is index-based, so the copy is self-contained and only its
+    // vertex coordinates have to be replaced.
     Mesh newMesh = mesh;
-    geometryRefinement(newMesh);
+    geometryRefinement(mesh, newMesh);
     return newMesh;
 }
 
 /**
  * @brief LimitPositionSubdivider::geometryRefinement Performs the geometry
  * refinement. In other words, it calculates the new coordinates of all the vertex
- * points of the mesh.
+ * points of the mesh. All positions are computed from the control mesh, so the
+ * result does not depend on the order in which the vertices are processed.
  * @param controlMesh The current mesh.
- * @param newMesh The new mesh.
+ * @param newMesh The new mesh. Has the same topology as the control mesh.
  */
-void LimitPositionSubdivider::geometryRefinement(Mesh &controlMesh) const {
-    QVector<Vertex> &vertices = controlMesh.getVertices();
+void LimitPositionSubdivider::geometryRefinement(const Mesh &controlMesh,
+                                                 Mesh &newMesh) const {
+    VertexPositions &newPositions = newMesh.getPositions();
 
     for (int v = 0; v < controlMesh.numVerts(); v++) {
-        QVector3D coords;
-        // Vertex points on boundary
-        if (vertices[v].isBoundaryVertex()) {
-            coords = getBoundaryVertexPos(vertices[v]);
-        }
-        // Vertex points not on boundary.
-        else {
-            coords = vertexPointLimitProjection(vertices[v]);
-        }
-        vertices[v] = Vertex(coords, nullptr, vertices[v].valence, v);
+        newPositions.set(v, limitPosition(controlMesh, v));
+    }
+}
+
+/**
+ * @brief LimitPositionSubdivider::limitPosition Calculates the limit position
+ * of a single vertex. Only the one-ring of the vertex is used.
+ * @param mesh The current mesh.
+ * @param v Index of the vertex.
+ * @return The limit position of the vertex.
+ */
+QVector3D LimitPositionSubdivider::limitPosition(const Mesh &mesh,
+                                                 int v) const {
+    // Vertex points on boundary
+    if (mesh.isBoundaryVertex(v)) {
+        return getBoundaryVertexPos(mesh, v);
     }
+    // Vertex points not on boundary.
+    return vertexPointLimitProjection(mesh, v);
 }
 
 
 /**
  * @brief LimitPositionSubdivider::getBoundaryVertexPos Calculates the
  * position pf vertex if it is a boundary point.
- * @param currentVertex The given vertex to calculate the position.
+ * @param mesh The current mesh.
+ * @param v Index of the given vertex to calculate the position.
  * @return The limit position coordinates of the vertex.
  */
-QVector3D LimitPositionSubdivider::getBoundaryVertexPos(
-        const Vertex &currentVertex) const {
-
-    QVector3D next = currentVertex.nextBoundaryHalfEdge()->next->origin->coords;
-    QVector3D prev = currentVertex.prevBoundaryHalfEdge()->origin->coords;
+QVector3D LimitPositionSubdivider::getBoundaryVertexPos(const Mesh &mesh,
+                                                        int v) const {
+    QVector3D next;
+    QVector3D prev;
+    const VertexAdjacency *adjacency = mesh.getAdjacency();
+    if (adjacency != nullptr) {
+        next = mesh.position(adjacency->nextBoundaryNeighbor(v));
+        prev = mesh.position(adjacency->prevBoundaryNeighbor(v));
+    } else {
+        int nextEdge = mesh.nextBoundaryHalfEdge(v);
+        next = mesh.position(mesh.originIdx(mesh.nextIdx(nextEdge)));
+        prev = mesh.position(mesh.originIdx(mesh.prevBoundaryHalfEdge(v)));
+    }
     // Using boundary stencils
-    QVector3D boundaryPos =  (3.0 / 4.0) * currentVertex.coords + (1.0 / 8.0) * (next + prev);
+    QVector3D boundaryPos =  (3.0 / 4.0) * mesh.position(v) + (1.0 / 8.0) * (next + prev);
     return boundaryPos;
 }
 
@@ -64,12 +85,12 @@ QVector3D LimitPositionSubdivider::getBoundaryVertexPos(
 /**
  * @brief LimitPositionSubdivider::vertexPoint_LimitPosition Calculates the limit position of
  *  the vertex.
- * @param vertex The vertex to calculate its limit position.
+ * @param mesh The current mesh.
+ * @param v Index of the vertex to calculate its limit position.
  * @return The coordinates of the limit position.
  */
-QVector3D LimitPositionSubdivider::vertexPointLimitProjection(const Vertex &vertex) const {
-    // Halfedge of given vertex.
-    HalfEdge *he = vertex.out;
+QVector3D LimitPositionSubdivider::vertexPointLimitProjection(const Mesh &mesh, int v) const {
+    const Vertex &vertex = mesh.vertices[v];
     // average of edge midpoints
     QVector3D E_avg;
     // average of face points
@@ -77,35 +98,48 @@ QVector3D LimitPositionSubdivider::vertexPointLimitProjection(const Vertex &vert
     // coordinates of the vertex's limit position
     QVector3D limitPosition;
 
-    for (int i = 0; i < vertex.valence; i++) {
-        E_avg += (he->origin->coords + he->next->origin->coords) / 2.0;
-        F_avg += facePoint(*he->face);
-        he = he->prev->twin;
+    const VertexAdjacency *adjacency = mesh.getAdjacency();
+    if (adjacency != nullptr) {
+        // Take the one-ring from the adjacency cache
+        const int *neighbors = adjacency->neighbors(v);
+        const int *faces = adjacency->faces(v);
+        for (int i = 0; i < adjacency->numFaces(v); i++) {
+            E_avg += (mesh.position(v) + mesh.position(neighbors[i])) / 2.0;
+            F_avg += facePoint(mesh, faces[i]);
+        }
+    } else {
+        // Halfedge of given vertex.
+        int he = vertex.out;
+        for (int i = 0; i < vertex.valence; i++) {
+            E_avg += (mesh.position(mesh.originIdx(he)) + mesh.position(mesh.originIdx(mesh.nextIdx(he)))) / 2.0;
+            F_avg += facePoint(mesh, mesh.faceIdx(he));
+            he = mesh.twinIdx(mesh.prevIdx(he));
+        }
     }
-    float v = float(vertex.valence);
+    float n = float(vertex.valence);
     // Calculate the limit position
-    limitPosition = vertex.coords*( (v-3.0f) / (v+5.0f) ) + ( 4.0f / (v * (v+5.0f)) ) * (E_avg + F_avg);
+    limitPosition = mesh.position(v)*( (n-3.0f) / (n+5.0f) ) + ( 4.0f / (n * (n+5.0f)) ) * (E_avg + F_avg);
     return limitPosition;
 }
 
 /**
  * @brief LimitPositionProjector::facePoint Calculates the position of the face
  * point by averaging the positions of all adjacent vertices.
- * @param face The given face.
+ * @param mesh The current mesh.
+ * @param f Index of the given face.
  * @return The coordinates of the new face point.
  */
-QVector3D LimitPositionSubdivider::facePoint(const Face &face) const {
+QVector3D LimitPositionSubdivider::facePoint(const Mesh &mesh, int f) const {
+    int valence = mesh.faceValence(f);
     QVector3D posFace;
-    HalfEdge *he = face.side;
+    int he = mesh.sideIdx(f);
     QVector3D sumEdge;
     // Taking sum of coords of adjacent half edges
-    for (int side = 0; side < face.valence; side++) {
-        sumEdge += he->origin->coords;
-        he = he->next;
+    for (int side = 0; side < valence; side++) {
+        sumEdge += mesh.position(mesh.originIdx(he));
+        he = mesh.nextIdx(he);
     }
     // Taking average by dividing with valence
-    posFace = sumEdge / face.valence;
+    posFace = sumEdge / valence;
     return posFace;
 }
-
-
@@ -13,13 +13,14 @@ class LimitPositionSubdivider : public Subdivider {
     public:
         LimitPositionSubdivider();
         Mesh subdivide(Mesh& mesh) const;
+        QVector3D limitPosition(const Mesh& mesh, int v) const;
 
     private:
-        void geometryRefinement(Mesh& mesh) const;
+        void geometryRefinement(const Mesh& controlMesh, Mesh& newMesh) const;
 
-        QVector3D facePoint(const Face& face) const;
-        QVector3D getBoundaryVertexPos(const Vertex& vertex) const;
-        QVector3D vertexPointLimitProjection(const Vertex& vertex) const;
+        QVector3D facePoint(const Mesh& mesh, int f) const;
+        QVector3D getBoundaryVertexPos(const Mesh& mesh, int v) const;
+        QVector3D vertexPointLimitProjection(const Mesh& mesh, int v) const;
 };
 
 #endif // LIMITPROJECTIONSUBDIVIDER_H
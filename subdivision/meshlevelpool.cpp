@@ -0,0 +1,76 @@
+#include "meshlevelpool.h"
+
+#include <utility>
+
+/**
+ * @brief MeshLevelPool::MeshLevelPool Creates an empty pool.
+ */
+MeshLevelPool::MeshLevelPool() {}
+
+/**
+ * @brief MeshLevelPool::acquire Takes the pooled buffers of a subdivision level
+ * out of the pool. The returned mesh is empty, but keeps the memory of the last
+ * mesh that was recycled for this level, if any.
+ * @param level The subdivision level the mesh will be used for.
+ * @return An empty mesh to subdivide into.
+ */
+Mesh MeshLevelPool::acquire(int level) {
+    if (level >= levels.size()) {
+        return Mesh();
+    }
+    Mesh mesh = std::move(levels[level]);
+    levels[level] = Mesh();
+    return mesh;
+}
+
+/**
+ * @brief MeshLevelPool::recycle Returns the buffers of a mesh to the pool. The
+ * mesh is left empty. If the pool already holds buffers for this level, the
+ * larger of the two is kept.
+ * @param level The subdivision level the mesh was used for.
+ * @param mesh The mesh to recycle.
+ */
+void MeshLevelPool::recycle(int level, Mesh& mesh) {
+    if (level >= levels.size()) {
+        levels.resize(level + 1);
+    }
+    if (mesh.memoryUsage() > levels[level].memoryUsage()) {
+        mesh.clear();
+        levels[level] = std::move(mesh);
+    }
+    mesh = Mesh();
+}
+
+/**
+ * @brief MeshLevelPool::recycleLevels Returns all subdivided levels to the pool
+ * and clears the provided levels. The control mesh at level 0 was not
+ * created by subdivision and is simply released.
+ * @param levels The control mesh followed by its subdivided levels.
+ */
+void MeshLevelPool::recycleLevels(QVector<Mesh>& levels) {
+    for (int k = 1; k < levels.size(); k++) {
+        recycle(k, levels[k]);
+    }
+    levels.clear();
+}
+
+/**
+ * @brief MeshLevelPool::release Frees all memory held by the pool.
+ */
+void MeshLevelPool::release() {
+    levels.clear();
+    levels.squeeze();
+}
+
+/**
+ * @brief MeshLevelPool::memoryUsage Retrieves the amount of memory held by the
+ * pool.
+ * @return The number of bytes allocated by the pooled meshes.
+ */
+qint64 MeshLevelPool::memoryUsage() const {
+    qint64 numBytes = 0;
+    for (const Mesh& mesh : levels) {
+        numBytes += mesh.memoryUsage();
+    }
+    return numBytes;
+}
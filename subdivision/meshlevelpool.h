@@ -0,0 +1,32 @@
+#ifndef MESH_LEVEL_POOL_H
+#define MESH_LEVEL_POOL_H
+
+#include <QVector>
+
+#include "mesh/mesh.h"
+
+/**
+ * @brief The MeshLevelPool class holds on to the buffers of subdivision levels
+ * that are no longer needed, such as those of a previously loaded model. Buffers
+ * are kept per subdivision level, since a level needs similarly sized buffers
+ * every time it is subdivided. Subdividing to a level that was subdivided
+ * before then reuses its buffers instead of allocating new ones.
+ */
+class MeshLevelPool {
+ public:
+  MeshLevelPool();
+
+  Mesh acquire(int level);
+  void recycle(int level, Mesh& mesh);
+  void recycleLevels(QVector<Mesh>& levels);
+  void release();
+
+  qint64 memoryUsage() const;
+
+ private:
+  // The pooled mesh of every level. Meshes of levels that are in use are
+  // empty.
+  QVector<Mesh> levels;
+};
+
+#endif  // MESH_LEVEL_POOL_H
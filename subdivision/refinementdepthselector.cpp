@@ -0,0 +1,274 @@
+#include "refinementdepthselector.h"
+
+#include <QVector4D>
+#include <cmath>
+
+// The number of halvings of the tolerance interval when fitting a face budget
+#define BUDGET_SEARCH_STEPS 32
+
+/**
+ * @brief RefinementDepthSelector::RefinementDepthSelector Creates a new
+ * refinement depth selector.
+ */
+RefinementDepthSelector::RefinementDepthSelector() {}
+
+/**
+ * @brief RefinementDepthSelector::selectDepths Selects the refinement depth of
+ * every control face. Without a tolerance, every face is refined to the
+ * maximum level. If the depths that meet the tolerance exceed the face budget,
+ * the tolerance is raised until they fit. The search is logarithmic in the
+ * tolerance, and every step is linear in the number of faces.
+ * @param controlMesh The control mesh.
+ * @param criteria The criteria to meet.
+ * @return The number of subdivision steps of every control face.
+ */
+QVector<int> RefinementDepthSelector::selectDepths(
+    const Mesh& controlMesh, const RefinementCriteria& criteria) const {
+    int maxLevel = qMax(criteria.maxLevel, 0);
+    QVector<float> errors = faceErrors(controlMesh, criteria);
+    QVector<int> depths;
+    if (criteria.tolerance > 0.0f) {
+        depths = depthsForTolerance(controlMesh, errors, criteria.tolerance,
+                                    maxLevel);
+    } else {
+        depths.fill(maxLevel, controlMesh.numFaces());
+    }
+    if (criteria.faceBudget <= 0 ||
+        numRefinedFaces(controlMesh, depths) <= criteria.faceBudget) {
+        return depths;
+    }
+
+    float maxError = 0.0f;
+    for (float error : errors) {
+        maxError = qMax(maxError, error);
+    }
+    // No face is refined at the largest error, which is the fewest faces
+    // possible. Below the smallest tolerance, all faces are at the maximum
+    // level.
+    float high = maxError;
+    float low = criteria.tolerance > 0.0f
+                    ? criteria.tolerance
+                    : maxError * std::pow(0.25f, maxLevel + 1);
+    QVector<int> bestDepths =
+        depthsForTolerance(controlMesh, errors, high, maxLevel);
+    if (maxError <= 0.0f) {
+        return bestDepths;
+    }
+    for (int i = 0; i < BUDGET_SEARCH_STEPS; i++) {
+        float tolerance = std::sqrt(low * high);
+        QVector<int> candidate =
+            depthsForTolerance(controlMesh, errors, tolerance, maxLevel);
+        if (numRefinedFaces(controlMesh, candidate) <= criteria.faceBudget) {
+            high = tolerance;
+            bestDepths = std::move(candidate);
+        } else {
+            low = tolerance;
+        }
+    }
+    return bestDepths;
+}
+
+/**
+ * @brief RefinementDepthSelector::numRefinedFaces Counts the faces that
+ * refining every control face to its depth results in. A face of valence n is
+ * split into n quads by the first step, and every quad into four by every
+ * further step.
+ * @param controlMesh The control mesh.
+ * @param depths The number of subdivision steps of every control face.
+ * @return The number of refined faces.
+ */
+qint64 RefinementDepthSelector::numRefinedFaces(const Mesh& controlMesh,
+                                                const QVector<int>& depths) {
+    qint64 numFaces = 0;
+    for (int f = 0; f < controlMesh.numFaces(); f++) {
+        if (depths[f] == 0) {
+            numFaces++;
+        } else {
+            numFaces += qint64(controlMesh.faceValence(f))
+                        << (2 * (depths[f] - 1));
+        }
+    }
+    return numFaces;
+}
+
+/**
+ * @brief RefinementDepthSelector::faceErrors Estimates the error of every
+ * control face, which is the largest error of its corners. When view
+ * dependent, the error is converted to pixels.
+ * @param controlMesh The control mesh.
+ * @param criteria The criteria to meet.
+ * @return The error of every control face.
+ */
+QVector<float> RefinementDepthSelector::faceErrors(
+    const Mesh& controlMesh, const RefinementCriteria& criteria) const {
+    VertexAdjacency adjacency;
+    adjacency.build(controlMesh);
+    QVector<float> vertexErrors(controlMesh.numVerts());
+    for (int v = 0; v < controlMesh.numVerts(); v++) {
+        vertexErrors[v] = vertexError(controlMesh, adjacency, v);
+    }
+
+    QMatrix4x4 viewProjection =
+        criteria.projectionMatrix * criteria.modelViewMatrix;
+    float aspectRatio =
+        criteria.projectionMatrix(0, 0) != 0.0f
+            ? criteria.projectionMatrix(1, 1) / criteria.projectionMatrix(0, 0)
+            : 1.0f;
+    QVector<float> errors(controlMesh.numFaces());
+    for (int f = 0; f < controlMesh.numFaces(); f++) {
+        float error = 0.0f;
+        int h = controlMesh.sideIdx(f);
+        for (int m = 0; m < controlMesh.faceValence(f); m++) {
+            error = qMax(error, vertexErrors[controlMesh.originIdx(h)]);
+            h = controlMesh.nextIdx(h);
+        }
+        if (criteria.viewDependent) {
+            error *= pixelsPerUnit(controlMesh, f, viewProjection, aspectRatio,
+                                   criteria.viewportHeight);
+        }
+        errors[f] = error;
+    }
+    return errors;
+}
+
+/**
+ * @brief RefinementDepthSelector::vertexError Estimates how far a vertex is
+ * from being flat: the distance along the vertex normal between the vertex and
+ * the average of its neighbours. Boundary vertices also use the distance to
+ * the midpoint of their boundary neighbours, so curved boundaries of flat
+ * regions are refined as well.
+ * @param mesh The mesh the vertex belongs to.
+ * @param adjacency The one-rings of the mesh.
+ * @param v Index of the vertex.
+ * @return The error of the vertex.
+ */
+float RefinementDepthSelector::vertexError(const Mesh& mesh,
+                                           const VertexAdjacency& adjacency,
+                                           int v) const {
+    int numNeighbors = adjacency.numNeighbors(v);
+    if (numNeighbors == 0) {
+        return 0.0f;
+    }
+    QVector3D position = mesh.position(v);
+    QVector3D centroid;
+    const int* neighbors = adjacency.neighbors(v);
+    for (int i = 0; i < numNeighbors; i++) {
+        centroid += mesh.position(neighbors[i]);
+    }
+    centroid /= numNeighbors;
+
+    QVector3D normal;
+    const int* faces = adjacency.faces(v);
+    for (int i = 0; i < adjacency.numFaces(v); i++) {
+        normal += mesh.computeFaceNormal(faces[i]);
+    }
+    float error = 0.0f;
+    if (normal.length() > 0.0f) {
+        error = std::fabs(
+            QVector3D::dotProduct(centroid - position, normal.normalized()));
+    }
+    if (adjacency.isBoundary(v)) {
+        QVector3D midpoint =
+            (mesh.position(adjacency.nextBoundaryNeighbor(v)) +
+             mesh.position(adjacency.prevBoundaryNeighbor(v))) /
+            2.0f;
+        error = qMax(error, (midpoint - position).length());
+    }
+    return error;
+}
+
+/**
+ * @brief RefinementDepthSelector::pixelsPerUnit Estimates how many pixels a
+ * model unit covers around a face, from the ratio between the projected and
+ * the actual length of its edges. Edges behind the camera are skipped, so
+ * faces that are entirely behind it are not refined.
+ * @param mesh The mesh the face belongs to.
+ * @param f Index of the face.
+ * @param viewProjection The projection matrix times the model view matrix.
+ * @param aspectRatio The width of the viewport divided by its height.
+ * @param viewportHeight The height of the viewport in pixels.
+ * @return The largest ratio of the edges of the face.
+ */
+float RefinementDepthSelector::pixelsPerUnit(const Mesh& mesh, int f,
+                                             const QMatrix4x4& viewProjection,
+                                             float aspectRatio,
+                                             int viewportHeight) const {
+    float halfHeight = 0.5f * viewportHeight;
+    float maxRatio = 0.0f;
+    int h = mesh.sideIdx(f);
+    for (int m = 0; m < mesh.faceValence(f); m++) {
+        QVector3D p0 = mesh.position(mesh.originIdx(h));
+        QVector3D p1 = mesh.position(mesh.originIdx(mesh.nextIdx(h)));
+        h = mesh.nextIdx(h);
+        QVector4D c0 = viewProjection * QVector4D(p0, 1.0f);
+        QVector4D c1 = viewProjection * QVector4D(p1, 1.0f);
+        float length = (p1 - p0).length();
+        if (c0.w() <= 0.0f || c1.w() <= 0.0f || length <= 0.0f) {
+            continue;
+        }
+        float dx = (c1.x() / c1.w() - c0.x() / c0.w()) * aspectRatio;
+        float dy = c1.y() / c1.w() - c0.y() / c0.w();
+        float pixels = std::sqrt(dx * dx + dy * dy) * halfHeight;
+        maxRatio = qMax(maxRatio, pixels / length);
+    }
+    return maxRatio;
+}
+
+/**
+ * @brief RefinementDepthSelector::depthsForTolerance Selects the smallest
+ * depth of every face that brings its error below a tolerance, assuming that
+ * every subdivision step quarters the error. The depths are then balanced.
+ * @param controlMesh The control mesh.
+ * @param errors The error of every control face.
+ * @param tolerance The largest allowed error.
+ * @param maxLevel The largest depth.
+ * @return The depth of every control face.
+ */
+QVector<int> RefinementDepthSelector::depthsForTolerance(
+    const Mesh& controlMesh, const QVector<float>& errors, float tolerance,
+    int maxLevel) const {
+    QVector<int> depths(errors.size());
+    for (int f = 0; f < errors.size(); f++) {
+        float error = errors[f];
+        int depth = 0;
+        while (depth < maxLevel && error > tolerance) {
+            error *= 0.25f;
+            depth++;
+        }
+        depths[f] = depth;
+    }
+    balanceDepths(controlMesh, depths);
+    return depths;
+}
+
+/**
+ * @brief RefinementDepthSelector::balanceDepths Raises the depths of faces
+ * until the depths of faces that share an edge differ by at most one. Raising
+ * a face may in turn require raising its neighbours, so the faces that were
+ * raised are revisited.
+ * @param controlMesh The control mesh.
+ * @param depths The depth of every control face.
+ */
+void RefinementDepthSelector::balanceDepths(const Mesh& controlMesh,
+                                            QVector<int>& depths) const {
+    QVector<int> pending(controlMesh.numFaces());
+    for (int f = 0; f < controlMesh.numFaces(); f++) {
+        pending[f] = f;
+    }
+    while (!pending.isEmpty()) {
+        int f = pending.takeLast();
+        int h = controlMesh.sideIdx(f);
+        for (int m = 0; m < controlMesh.faceValence(f); m++) {
+            int twin = controlMesh.twinIdx(h);
+            h = controlMesh.nextIdx(h);
+            if (twin < 0) {
+                continue;
+            }
+            int neighbor = controlMesh.faceIdx(twin);
+            if (depths[neighbor] < depths[f] - 1) {
+                depths[neighbor] = depths[f] - 1;
+                pending.append(neighbor);
+            }
+        }
+    }
+}
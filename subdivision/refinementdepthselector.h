@@ -0,0 +1,68 @@
+#ifndef REFINEMENT_DEPTH_SELECTOR_H
+#define REFINEMENT_DEPTH_SELECTOR_H
+
+#include <QMatrix4x4>
+#include <QVector>
+
+#include "mesh/mesh.h"
+
+/**
+ * @brief The RefinementCriteria struct holds the criteria the refinement depth
+ * of every control face is selected by.
+ */
+struct RefinementCriteria {
+  int maxLevel = 4;
+  // The largest allowed distance between the refined faces and the limit
+  // surface, in pixels when view dependent and in model units otherwise.
+  // Disabled when zero or less.
+  float tolerance = 0.0f;
+  // The largest allowed number of refined faces. Disabled when zero or less.
+  int faceBudget = 0;
+
+  // Measure the tolerance on screen, using the projected edge lengths
+  bool viewDependent = false;
+  QMatrix4x4 modelViewMatrix;
+  QMatrix4x4 projectionMatrix;
+  int viewportHeight = 1080;
+};
+
+/**
+ * @brief The RefinementDepthSelector class selects how often every control
+ * face of a mesh is subdivided, so that the result meets a tolerance or a face
+ * budget with as few faces as possible.
+ *
+ * The error of a face is estimated from how much its corners deviate from the
+ * plane through their neighbours, along the vertex normal. This is zero in
+ * flat regions, and grows with the curvature. Every subdivision step about
+ * quarters the distance to the limit surface, so the depth of a face is the
+ * number of steps that brings its error below the tolerance. When view
+ * dependent, the error is scaled by the number of pixels a model unit covers
+ * around the face, which follows from its projected edge lengths.
+ *
+ * The depths of faces that share an edge differ by at most one, so the
+ * AdaptiveSubdivider can close the transitions between them.
+ */
+class RefinementDepthSelector {
+ public:
+  RefinementDepthSelector();
+  QVector<int> selectDepths(const Mesh& controlMesh,
+                            const RefinementCriteria& criteria) const;
+
+  static qint64 numRefinedFaces(const Mesh& controlMesh,
+                                const QVector<int>& depths);
+
+ private:
+  QVector<float> faceErrors(const Mesh& controlMesh,
+                            const RefinementCriteria& criteria) const;
+  float vertexError(const Mesh& mesh, const VertexAdjacency& adjacency,
+                    int v) const;
+  float pixelsPerUnit(const Mesh& mesh, int f,
+                      const QMatrix4x4& viewProjection, float aspectRatio,
+                      int viewportHeight) const;
+  QVector<int> depthsForTolerance(const Mesh& controlMesh,
+                                  const QVector<float>& errors,
+                                  float tolerance, int maxLevel) const;
+  void balanceDepths(const Mesh& controlMesh, QVector<int>& depths) const;
+};
+
+#endif  // REFINEMENT_DEPTH_SELECTOR_H
@@ -0,0 +1,91 @@
+#include "refinementkernels.h"
+
+#include "refinementkernels_impl.h"
+
+#ifdef SUBDIVISION_X86_KERNELS
+// Defined in the translation units compiled for each instruction set
+const RefinementKernels& sse42RefinementKernels();
+const RefinementKernels& avx2RefinementKernels();
+const RefinementKernels& avx512RefinementKernels();
+#endif
+
+/**
+ * @brief detectSimdIsa Determines the most capable instruction set that is
+ * supported by both the processor and this build.
+ * @return The instruction set.
+ */
+SimdIsa detectSimdIsa() {
+#ifdef SUBDIVISION_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return SimdIsa::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdIsa::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return SimdIsa::SSE42;
+    }
+#endif
+    return SimdIsa::Scalar;
+}
+
+/**
+ * @brief simdIsaName Retrieves the name of an instruction set.
+ * @param isa The instruction set.
+ * @return The name of the instruction set.
+ */
+const char* simdIsaName(SimdIsa isa) {
+    switch (isa) {
+        case SimdIsa::SSE42:
+            return "SSE4.2";
+        case SimdIsa::AVX2:
+            return "AVX2";
+        case SimdIsa::AVX512:
+            return "AVX-512";
+        default:
+            return "Scalar";
+    }
+}
+
+/**
+ * @brief refinementKernels Retrieves the refinement kernels of an instruction
+ * set.
+ * @param isa The instruction set.
+ * @return The kernels, or nullptr if the instruction set is not supported by
+ * the processor or by this build.
+ */
+const RefinementKernels* refinementKernels(SimdIsa isa) {
+    static const RefinementKernels scalarKernels =
+        makeRefinementKernels<ScalarTraits>(SimdIsa::Scalar);
+    // The instruction sets are ordered from least to most capable, and every
+    // processor supporting one also supports the ones before it
+    if (int(isa) > int(detectSimdIsa())) {
+        return nullptr;
+    }
+    switch (isa) {
+#ifdef SUBDIVISION_X86_KERNELS
+        case SimdIsa::SSE42:
+            return &sse42RefinementKernels();
+        case SimdIsa::AVX2:
+            return &avx2RefinementKernels();
+        case SimdIsa::AVX512:
+            return &avx512RefinementKernels();
+#endif
+        case SimdIsa::Scalar:
+            return &scalarKernels;
+        default:
+            return nullptr;
+    }
+}
+
+/**
+ * @brief bestRefinementKernels Retrieves the kernels of the most capable
+ * instruction set available. The instruction set is detected only once.
+ * @return The kernels.
+ */
+const RefinementKernels& bestRefinementKernels() {
+    static const RefinementKernels* kernels =
+        refinementKernels(detectSimdIsa());
+    return *kernels;
+}
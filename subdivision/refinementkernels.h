@@ -0,0 +1,66 @@
+#ifndef REFINEMENT_KERNELS_H
+#define REFINEMENT_KERNELS_H
+
+/**
+ * @brief The instruction sets the refinement kernels are available for, from
+ * least to most capable.
+ */
+enum class SimdIsa { Scalar, SSE42, AVX2, AVX512 };
+
+/**
+ * @brief The QuadRefinementData struct holds the arrays the refinement kernels
+ * read from and write to when subdividing a quad mesh into the canonical
+ * layout. The half-edges are read as three ints each: origin, twin and edge
+ * index.
+ */
+struct QuadRefinementData {
+  // Positions of the vertices of the quad mesh
+  const float* x;
+  const float* y;
+  const float* z;
+  const int* halfEdges;
+  // For every edge, its half-edge with the highest index
+  const int* edgeHalfEdges;
+  // The one-rings of the vertices, as stored by VertexAdjacency
+  const int* neighborOffsets;
+  const int* neighborIndices;
+  const int* faceOffsets;
+  const int* faceIndices;
+
+  // Positions of the vertices of the subdivided mesh
+  float* newX;
+  float* newY;
+  float* newZ;
+  int numVerts;
+  int numFaces;
+};
+
+/**
+ * @brief The RefinementKernels struct holds the kernels for one instruction
+ * set. Every kernel computes the points of a range of elements of a quad mesh:
+ *
+ * facePoints: the face points of faces [first, last).
+ * edgePoints: the edge points of edges [first, last). Reads the face points.
+ * vertexPoints: the vertex points of the vertices in [first, last) that are
+ * regular, i.e. interior vertices of valence 4. Reads the face points. Other
+ * vertices are left for the caller.
+ *
+ * The kernels perform the same float operations in the same order as the
+ * scalar CatmullClarkSubdivider::facePoint, edgePoint, boundaryEdgePoint and
+ * vertexPoint. The kernels are compiled without contracting multiplications
+ * and additions into fused operations, so their results are identical to the
+ * scalar ones: the tolerance is zero units in the last place.
+ */
+struct RefinementKernels {
+  SimdIsa isa;
+  void (*facePoints)(const QuadRefinementData& data, int first, int last);
+  void (*edgePoints)(const QuadRefinementData& data, int first, int last);
+  void (*vertexPoints)(const QuadRefinementData& data, int first, int last);
+};
+
+SimdIsa detectSimdIsa();
+const char* simdIsaName(SimdIsa isa);
+const RefinementKernels* refinementKernels(SimdIsa isa);
+const RefinementKernels& bestRefinementKernels();
+
+#endif  // REFINEMENT_KERNELS_H
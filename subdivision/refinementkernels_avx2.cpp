@@ -0,0 +1,73 @@
+#include "refinementkernels_impl.h"
+
+#ifdef SUBDIVISION_X86_KERNELS
+
+#include <immintrin.h>
+
+/**
+ * @brief The Avx2Traits struct implements the vector operations on eight
+ * lanes, using the AVX2 gather instructions.
+ */
+struct Avx2Traits {
+  static const int Width = 8;
+  typedef __m256 F;
+  typedef __m256i I;
+  typedef __m256i M;
+
+  static inline F zero() { return _mm256_setzero_ps(); }
+  static inline F set1(float a) { return _mm256_set1_ps(a); }
+  static inline F load(const float* p) { return _mm256_loadu_ps(p); }
+  static inline void store(float* p, F a) { _mm256_storeu_ps(p, a); }
+  static inline F add(F a, F b) { return _mm256_add_ps(a, b); }
+  static inline F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+  static inline F blend(M m, F ifTrue, F ifFalse) {
+    return _mm256_blendv_ps(ifFalse, ifTrue, _mm256_castsi256_ps(m));
+  }
+
+  static inline I loadInt(const int* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+  static inline I set1Int(int a) { return _mm256_set1_epi32(a); }
+  static inline I ramp(int start, int step) {
+    return _mm256_add_epi32(
+        _mm256_set1_epi32(start),
+        _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                           _mm256_set1_epi32(step)));
+  }
+  static inline I addInt(I a, I b) { return _mm256_add_epi32(a, b); }
+  static inline I subInt(I a, I b) { return _mm256_sub_epi32(a, b); }
+  static inline I andInt(I a, I b) { return _mm256_and_si256(a, b); }
+  static inline I orInt(I a, I b) { return _mm256_or_si256(a, b); }
+  static inline I mul3(I a) {
+    return _mm256_add_epi32(_mm256_add_epi32(a, a), a);
+  }
+  static inline I shiftRight2(I a) { return _mm256_srai_epi32(a, 2); }
+
+  static inline M equal(I a, I b) { return _mm256_cmpeq_epi32(a, b); }
+  static inline M nonNegative(I a) {
+    return _mm256_cmpgt_epi32(a, _mm256_set1_epi32(-1));
+  }
+  static inline M andMask(M a, M b) { return _mm256_and_si256(a, b); }
+  static inline M allMask() { return _mm256_set1_epi32(-1); }
+
+  static inline F gather(const float* base, I index, M m) {
+    return _mm256_mask_i32gather_ps(_mm256_setzero_ps(), base, index,
+                                    _mm256_castsi256_ps(m), 4);
+  }
+  static inline I gatherInt(const int* base, I index, M m) {
+    return _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), base, index,
+                                       m, 4);
+  }
+};
+
+/**
+ * @brief avx2RefinementKernels Retrieves the AVX2 refinement kernels.
+ * @return The kernels.
+ */
+const RefinementKernels& avx2RefinementKernels() {
+    static const RefinementKernels kernels =
+        makeRefinementKernels<Avx2Traits>(SimdIsa::AVX2);
+    return kernels;
+}
+
+#endif  // SUBDIVISION_X86_KERNELS
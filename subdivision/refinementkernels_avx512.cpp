@@ -0,0 +1,71 @@
+#include "refinementkernels_impl.h"
+
+#ifdef SUBDIVISION_X86_KERNELS
+
+#include <immintrin.h>
+
+/**
+ * @brief The Avx512Traits struct implements the vector operations on sixteen
+ * lanes, using the AVX-512 gather instructions and mask registers.
+ */
+struct Avx512Traits {
+  static const int Width = 16;
+  typedef __m512 F;
+  typedef __m512i I;
+  typedef __mmask16 M;
+
+  static inline F zero() { return _mm512_setzero_ps(); }
+  static inline F set1(float a) { return _mm512_set1_ps(a); }
+  static inline F load(const float* p) { return _mm512_loadu_ps(p); }
+  static inline void store(float* p, F a) { _mm512_storeu_ps(p, a); }
+  static inline F add(F a, F b) { return _mm512_add_ps(a, b); }
+  static inline F mul(F a, F b) { return _mm512_mul_ps(a, b); }
+  static inline F blend(M m, F ifTrue, F ifFalse) {
+    return _mm512_mask_blend_ps(m, ifFalse, ifTrue);
+  }
+
+  static inline I loadInt(const int* p) { return _mm512_loadu_si512(p); }
+  static inline I set1Int(int a) { return _mm512_set1_epi32(a); }
+  static inline I ramp(int start, int step) {
+    return _mm512_add_epi32(
+        _mm512_set1_epi32(start),
+        _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                                             11, 12, 13, 14, 15),
+                           _mm512_set1_epi32(step)));
+  }
+  static inline I addInt(I a, I b) { return _mm512_add_epi32(a, b); }
+  static inline I subInt(I a, I b) { return _mm512_sub_epi32(a, b); }
+  static inline I andInt(I a, I b) { return _mm512_and_si512(a, b); }
+  static inline I orInt(I a, I b) { return _mm512_or_si512(a, b); }
+  static inline I mul3(I a) {
+    return _mm512_add_epi32(_mm512_add_epi32(a, a), a);
+  }
+  static inline I shiftRight2(I a) { return _mm512_srai_epi32(a, 2); }
+
+  static inline M equal(I a, I b) { return _mm512_cmpeq_epi32_mask(a, b); }
+  static inline M nonNegative(I a) {
+    return _mm512_cmpgt_epi32_mask(a, _mm512_set1_epi32(-1));
+  }
+  static inline M andMask(M a, M b) { return a & b; }
+  static inline M allMask() { return 0xffff; }
+
+  static inline F gather(const float* base, I index, M m) {
+    return _mm512_mask_i32gather_ps(_mm512_setzero_ps(), m, index, base, 4);
+  }
+  static inline I gatherInt(const int* base, I index, M m) {
+    return _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), m, index, base,
+                                       4);
+  }
+};
+
+/**
+ * @brief avx512RefinementKernels Retrieves the AVX-512 refinement kernels.
+ * @return The kernels.
+ */
+const RefinementKernels& avx512RefinementKernels() {
+    static const RefinementKernels kernels =
+        makeRefinementKernels<Avx512Traits>(SimdIsa::AVX512);
+    return kernels;
+}
+
+#endif  // SUBDIVISION_X86_KERNELS
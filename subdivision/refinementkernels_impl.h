@@ -0,0 +1,278 @@
+#ifndef REFINEMENT_KERNELS_IMPL_H
+#define REFINEMENT_KERNELS_IMPL_H
+
+#include "refinementkernels.h"
+
+/*
+ * The refinement kernels are written once against a small set of vector
+ * operations, which every instruction set provides as a traits struct:
+ *
+ * F, I, M: a vector of floats, a vector of ints and a lane mask.
+ * Width: the number of lanes.
+ * zero, set1, load, store, add, mul, blend: float operations.
+ * loadInt, set1Int, ramp, addInt, subInt, andInt, orInt, mul3, shiftRight2:
+ * int operations. ramp(start, step) holds start + i * step in lane i.
+ * equal, nonNegative, andMask, allMask: mask operations.
+ * gather, gatherInt: load base[index] in every lane of the mask, and zero in
+ * the other lanes.
+ *
+ * Each instruction set is compiled in its own translation unit, so that only
+ * that file is compiled for the instruction set. Ranges that do not fill a
+ * vector are finished with the scalar traits.
+ *
+ * Everything in this header has internal linkage. Otherwise the linker would
+ * keep a single copy of the scalar kernels, which may be one compiled for an
+ * instruction set that the processor does not support.
+ */
+
+namespace {
+
+/**
+ * @brief The ScalarTraits struct implements the vector operations on single
+ * values.
+ */
+struct ScalarTraits {
+  static const int Width = 1;
+  typedef float F;
+  typedef int I;
+  typedef bool M;
+
+  static inline F zero() { return 0.0f; }
+  static inline F set1(float a) { return a; }
+  static inline F load(const float* p) { return *p; }
+  static inline void store(float* p, F a) { *p = a; }
+  static inline F add(F a, F b) { return a + b; }
+  static inline F mul(F a, F b) { return a * b; }
+  static inline F blend(M m, F ifTrue, F ifFalse) {
+    return m ? ifTrue : ifFalse;
+  }
+
+  static inline I loadInt(const int* p) { return *p; }
+  static inline I set1Int(int a) { return a; }
+  static inline I ramp(int start, int) { return start; }
+  static inline I addInt(I a, I b) { return a + b; }
+  static inline I subInt(I a, I b) { return a - b; }
+  static inline I andInt(I a, I b) { return a & b; }
+  static inline I orInt(I a, I b) { return a | b; }
+  static inline I mul3(I a) { return 3 * a; }
+  static inline I shiftRight2(I a) { return a >> 2; }
+
+  static inline M equal(I a, I b) { return a == b; }
+  static inline M nonNegative(I a) { return a >= 0; }
+  static inline M andMask(M a, M b) { return a && b; }
+  static inline M allMask() { return true; }
+
+  static inline F gather(const float* base, I index, M m) {
+    return m ? base[index] : 0.0f;
+  }
+  static inline I gatherInt(const int* base, I index, M m) {
+    return m ? base[index] : 0;
+  }
+};
+
+/**
+ * @brief facePointsKernel Computes the face points of the quads [first, last).
+ * The face point of a quad is the average of its four corners, which are the
+ * origins of half-edges 4f up to 4f + 3.
+ * @param d The arrays of the quad mesh and the subdivided mesh.
+ * @param first The first face.
+ * @param last The end of the range of faces (exclusive).
+ */
+template <typename T>
+void facePointsKernel(const QuadRefinementData& d, int first, int last) {
+  typedef typename T::F F;
+  typedef typename T::I I;
+  float* fx = d.newX + d.numVerts;
+  float* fy = d.newY + d.numVerts;
+  float* fz = d.newZ + d.numVerts;
+  const typename T::M all = T::allMask();
+  const F quarter = T::set1(0.25f);
+
+  int f = first;
+  for (; f + T::Width <= last; f += T::Width) {
+    F sumX = T::zero();
+    F sumY = T::zero();
+    F sumZ = T::zero();
+    // The corners are visited from the side of the quad, half-edge 4f + 3,
+    // like the scalar face point does
+    for (int k = 3; k < 7; k++) {
+      // The origin of half-edge 4f + (k & 3) is int 3 * (4f + (k & 3))
+      I origin =
+          T::gatherInt(d.halfEdges, T::ramp(12 * f + 3 * (k & 3), 12), all);
+      sumX = T::add(sumX, T::gather(d.x, origin, all));
+      sumY = T::add(sumY, T::gather(d.y, origin, all));
+      sumZ = T::add(sumZ, T::gather(d.z, origin, all));
+    }
+    T::store(fx + f, T::mul(sumX, quarter));
+    T::store(fy + f, T::mul(sumY, quarter));
+    T::store(fz + f, T::mul(sumZ, quarter));
+  }
+  if (f < last) {
+    facePointsKernel<ScalarTraits>(d, f, last);
+  }
+}
+
+/**
+ * @brief edgePointsKernel Computes the edge points of the edges [first, last)
+ * of a quad mesh. Boundary edge points are the midpoint of the edge; other
+ * edge points average the midpoint with the average of the two adjacent face
+ * points.
+ * @param d The arrays of the quad mesh and the subdivided mesh.
+ * @param first The first edge.
+ * @param last The end of the range of edges (exclusive).
+ */
+template <typename T>
+void edgePointsKernel(const QuadRefinementData& d, int first, int last) {
+  typedef typename T::F F;
+  typedef typename T::I I;
+  typedef typename T::M M;
+  const float* fx = d.newX + d.numVerts;
+  const float* fy = d.newY + d.numVerts;
+  const float* fz = d.newZ + d.numVerts;
+  int firstEdgePoint = d.numVerts + d.numFaces;
+  float* ex = d.newX + firstEdgePoint;
+  float* ey = d.newY + firstEdgePoint;
+  float* ez = d.newZ + firstEdgePoint;
+  const M all = T::allMask();
+  const F half = T::set1(0.5f);
+
+  int e = first;
+  for (; e + T::Width <= last; e += T::Width) {
+    I h = T::loadInt(d.edgeHalfEdges + e);
+    I h3 = T::mul3(h);
+    I twin = T::gatherInt(d.halfEdges, T::addInt(h3, T::set1Int(1)), all);
+    // The next half-edge within the quad
+    I next = T::orInt(T::andInt(h, T::set1Int(~3)),
+                      T::andInt(T::addInt(h, T::set1Int(1)), T::set1Int(3)));
+    I origin = T::gatherInt(d.halfEdges, h3, all);
+    I target = T::gatherInt(d.halfEdges, T::mul3(next), all);
+    M interior = T::nonNegative(twin);
+    I face = T::shiftRight2(h);
+    I twinFace = T::shiftRight2(twin);
+
+    F midX = T::mul(T::add(T::gather(d.x, origin, all),
+                           T::gather(d.x, target, all)),
+                    half);
+    F midY = T::mul(T::add(T::gather(d.y, origin, all),
+                           T::gather(d.y, target, all)),
+                    half);
+    F midZ = T::mul(T::add(T::gather(d.z, origin, all),
+                           T::gather(d.z, target, all)),
+                    half);
+    F faceX = T::mul(T::add(T::gather(fx, face, all),
+                            T::gather(fx, twinFace, interior)),
+                     half);
+    F faceY = T::mul(T::add(T::gather(fy, face, all),
+                            T::gather(fy, twinFace, interior)),
+                     half);
+    F faceZ = T::mul(T::add(T::gather(fz, face, all),
+                            T::gather(fz, twinFace, interior)),
+                     half);
+    T::store(ex + e,
+             T::blend(interior, T::mul(T::add(midX, faceX), half), midX));
+    T::store(ey + e,
+             T::blend(interior, T::mul(T::add(midY, faceY), half), midY));
+    T::store(ez + e,
+             T::blend(interior, T::mul(T::add(midZ, faceZ), half), midZ));
+  }
+  if (e < last) {
+    edgePointsKernel<ScalarTraits>(d, e, last);
+  }
+}
+
+/**
+ * @brief vertexPointsKernel Computes the vertex points of the regular vertices
+ * in [first, last) of a quad mesh. Regular vertices are interior vertices with
+ * four neighbours and four faces. The positions of the other vertices are left
+ * untouched.
+ * @param d The arrays of the quad mesh and the subdivided mesh.
+ * @param first The first vertex.
+ * @param last The end of the range of vertices (exclusive).
+ */
+template <typename T>
+void vertexPointsKernel(const QuadRefinementData& d, int first, int last) {
+  typedef typename T::F F;
+  typedef typename T::I I;
+  typedef typename T::M M;
+  const float* fx = d.newX + d.numVerts;
+  const float* fy = d.newY + d.numVerts;
+  const float* fz = d.newZ + d.numVerts;
+  const I four = T::set1Int(4);
+  const F half = T::set1(0.5f);
+  const F quarter = T::set1(0.25f);
+  const F two = T::set1(2.0f);
+  // n - 3 for n = 4
+  const F one = T::set1(1.0f);
+
+  int v = first;
+  for (; v + T::Width <= last; v += T::Width) {
+    I neighborOffset = T::loadInt(d.neighborOffsets + v);
+    I faceOffset = T::loadInt(d.faceOffsets + v);
+    M regular = T::andMask(
+        T::equal(T::subInt(T::loadInt(d.neighborOffsets + v + 1),
+                           neighborOffset),
+                 four),
+        T::equal(T::subInt(T::loadInt(d.faceOffsets + v + 1), faceOffset),
+                 four));
+
+    F sX = T::load(d.x + v);
+    F sY = T::load(d.y + v);
+    F sZ = T::load(d.z + v);
+    F rX = T::zero();
+    F rY = T::zero();
+    F rZ = T::zero();
+    F qX = T::zero();
+    F qY = T::zero();
+    F qZ = T::zero();
+    for (int k = 0; k < 4; k++) {
+      I neighbor = T::gatherInt(
+          d.neighborIndices, T::addInt(neighborOffset, T::set1Int(k)), regular);
+      I face = T::gatherInt(d.faceIndices,
+                            T::addInt(faceOffset, T::set1Int(k)), regular);
+      rX = T::add(rX, T::mul(T::add(sX, T::gather(d.x, neighbor, regular)),
+                             half));
+      rY = T::add(rY, T::mul(T::add(sY, T::gather(d.y, neighbor, regular)),
+                             half));
+      rZ = T::add(rZ, T::mul(T::add(sZ, T::gather(d.z, neighbor, regular)),
+                             half));
+      qX = T::add(qX, T::gather(fx, face, regular));
+      qY = T::add(qY, T::gather(fy, face, regular));
+      qZ = T::add(qZ, T::gather(fz, face, regular));
+    }
+    // (Q + 2R + S(n - 3)) / n, where Q and R are averages over the ring
+    F pX = T::mul(T::add(T::add(T::mul(qX, quarter),
+                                T::mul(two, T::mul(rX, quarter))),
+                         T::mul(sX, one)),
+                  quarter);
+    F pY = T::mul(T::add(T::add(T::mul(qY, quarter),
+                                T::mul(two, T::mul(rY, quarter))),
+                         T::mul(sY, one)),
+                  quarter);
+    F pZ = T::mul(T::add(T::add(T::mul(qZ, quarter),
+                                T::mul(two, T::mul(rZ, quarter))),
+                         T::mul(sZ, one)),
+                  quarter);
+    T::store(d.newX + v, T::blend(regular, pX, T::load(d.newX + v)));
+    T::store(d.newY + v, T::blend(regular, pY, T::load(d.newY + v)));
+    T::store(d.newZ + v, T::blend(regular, pZ, T::load(d.newZ + v)));
+  }
+  if (v < last) {
+    vertexPointsKernel<ScalarTraits>(d, v, last);
+  }
+}
+
+/**
+ * @brief makeRefinementKernels Instantiates the kernels for an instruction
+ * set.
+ * @param isa The instruction set the traits implement.
+ * @return The kernels.
+ */
+template <typename T>
+RefinementKernels makeRefinementKernels(SimdIsa isa) {
+  return RefinementKernels{isa, &facePointsKernel<T>, &edgePointsKernel<T>,
+                           &vertexPointsKernel<T>};
+}
+
+}  // namespace
+
+#endif  // REFINEMENT_KERNELS_IMPL_H
@@ -0,0 +1,81 @@
+#include "refinementkernels_impl.h"
+
+#ifdef SUBDIVISION_X86_KERNELS
+
+#include <nmmintrin.h>
+
+/**
+ * @brief The Sse42Traits struct implements the vector operations on four
+ * lanes. SSE has no gather instructions, so gathers load the lanes one by one.
+ */
+struct Sse42Traits {
+  static const int Width = 4;
+  typedef __m128 F;
+  typedef __m128i I;
+  typedef __m128i M;
+
+  static inline F zero() { return _mm_setzero_ps(); }
+  static inline F set1(float a) { return _mm_set1_ps(a); }
+  static inline F load(const float* p) { return _mm_loadu_ps(p); }
+  static inline void store(float* p, F a) { _mm_storeu_ps(p, a); }
+  static inline F add(F a, F b) { return _mm_add_ps(a, b); }
+  static inline F mul(F a, F b) { return _mm_mul_ps(a, b); }
+  static inline F blend(M m, F ifTrue, F ifFalse) {
+    return _mm_blendv_ps(ifFalse, ifTrue, _mm_castsi128_ps(m));
+  }
+
+  static inline I loadInt(const int* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  }
+  static inline I set1Int(int a) { return _mm_set1_epi32(a); }
+  static inline I ramp(int start, int step) {
+    return _mm_setr_epi32(start, start + step, start + 2 * step,
+                          start + 3 * step);
+  }
+  static inline I addInt(I a, I b) { return _mm_add_epi32(a, b); }
+  static inline I subInt(I a, I b) { return _mm_sub_epi32(a, b); }
+  static inline I andInt(I a, I b) { return _mm_and_si128(a, b); }
+  static inline I orInt(I a, I b) { return _mm_or_si128(a, b); }
+  static inline I mul3(I a) { return _mm_add_epi32(_mm_add_epi32(a, a), a); }
+  static inline I shiftRight2(I a) { return _mm_srai_epi32(a, 2); }
+
+  static inline M equal(I a, I b) { return _mm_cmpeq_epi32(a, b); }
+  static inline M nonNegative(I a) {
+    return _mm_cmpgt_epi32(a, _mm_set1_epi32(-1));
+  }
+  static inline M andMask(M a, M b) { return _mm_and_si128(a, b); }
+  static inline M allMask() { return _mm_set1_epi32(-1); }
+
+  static inline F gather(const float* base, I index, M m) {
+    alignas(16) int indices[4];
+    alignas(16) int mask[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(indices), index);
+    _mm_store_si128(reinterpret_cast<__m128i*>(mask), m);
+    return _mm_setr_ps(mask[0] ? base[indices[0]] : 0.0f,
+                       mask[1] ? base[indices[1]] : 0.0f,
+                       mask[2] ? base[indices[2]] : 0.0f,
+                       mask[3] ? base[indices[3]] : 0.0f);
+  }
+  static inline I gatherInt(const int* base, I index, M m) {
+    alignas(16) int indices[4];
+    alignas(16) int mask[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(indices), index);
+    _mm_store_si128(reinterpret_cast<__m128i*>(mask), m);
+    return _mm_setr_epi32(mask[0] ? base[indices[0]] : 0,
+                          mask[1] ? base[indices[1]] : 0,
+                          mask[2] ? base[indices[2]] : 0,
+                          mask[3] ? base[indices[3]] : 0);
+  }
+};
+
+/**
+ * @brief sse42RefinementKernels Retrieves the SSE4.2 refinement kernels.
+ * @return The kernels.
+ */
+const RefinementKernels& sse42RefinementKernels() {
+    static const RefinementKernels kernels =
+        makeRefinementKernels<Sse42Traits>(SimdIsa::SSE42);
+    return kernels;
+}
+
+#endif  // SUBDIVISION_X86_KERNELS
@@ -0,0 +1,61 @@
+#include "stenciltable.h"
+
+#include "util/parallel.h"
+
+/**
+ * @brief StencilTable::StencilTable Creates an empty table without any
+ * stencils.
+ */
+StencilTable::StencilTable() : offsets(1, 0), numControlVerts(0) {}
+
+/**
+ * @brief StencilTable::evaluate Computes the refined positions of a set of
+ * control positions by applying every stencil to them. The control positions
+ * must belong to a mesh with the topology the table was built for.
+ * @param controlPositions The positions of the control vertices.
+ * @param positions Is resized to the number of refined vertices and set to
+ * their positions.
+ * @param numThreads The number of threads used to apply the stencils.
+ */
+void StencilTable::evaluate(const VertexPositions& controlPositions,
+                            VertexPositions& positions,
+                            int numThreads) const {
+    positions.resize(numVertices());
+    const float* controlX = controlPositions.x();
+    const float* controlY = controlPositions.y();
+    const float* controlZ = controlPositions.z();
+    float* x = positions.x();
+    float* y = positions.y();
+    float* z = positions.z();
+
+    parallelFor(
+        0, numVertices(),
+        [&](int first, int last) {
+            for (int v = first; v < last; v++) {
+                float sumX = 0.0f;
+                float sumY = 0.0f;
+                float sumZ = 0.0f;
+                for (int i = offsets[v]; i < offsets[v + 1]; i++) {
+                    int c = indices[i];
+                    float w = weights[i];
+                    sumX += w * controlX[c];
+                    sumY += w * controlY[c];
+                    sumZ += w * controlZ[c];
+                }
+                x[v] = sumX;
+                y[v] = sumY;
+                z[v] = sumZ;
+            }
+        },
+        numThreads);
+}
+
+/**
+ * @brief StencilTable::memoryUsage Retrieves the amount of memory allocated by
+ * the table.
+ * @return The number of bytes allocated by the table.
+ */
+qint64 StencilTable::memoryUsage() const {
+    return (offsets.capacity() + indices.capacity()) * qint64(sizeof(int)) +
+           weights.capacity() * qint64(sizeof(float));
+}
@@ -0,0 +1,47 @@
+#ifndef STENCIL_TABLE_H
+#define STENCIL_TABLE_H
+
+#include <QVector>
+
+#include "mesh/vertexpositions.h"
+
+/**
+ * @brief The StencilTable class expresses the vertices of a subdivided mesh as
+ * weighted sums of the vertices of its control mesh. The stencils are stored
+ * as a sparse matrix with one row per refined vertex: the stencil of vertex v
+ * occupies positions offsets[v] up to offsets[v + 1] of the index and weight
+ * arrays. Once built, the refined positions for any set of control positions
+ * follow from a single sparse matrix-vector product, without touching the
+ * topology. Tables are built by the StencilTableBuilder.
+ */
+class StencilTable {
+ public:
+  StencilTable();
+
+  inline int numControlVertices() const { return numControlVerts; }
+  inline int numVertices() const { return offsets.size() - 1; }
+  inline int numWeights() const { return indices.size(); }
+
+  inline int stencilSize(int v) const { return offsets[v + 1] - offsets[v]; }
+  inline const int* stencilIndices(int v) const {
+    return indices.constData() + offsets[v];
+  }
+  inline const float* stencilWeights(int v) const {
+    return weights.constData() + offsets[v];
+  }
+
+  void evaluate(const VertexPositions& controlPositions,
+                VertexPositions& positions, int numThreads = 1) const;
+
+  qint64 memoryUsage() const;
+
+ private:
+  QVector<int> offsets;
+  QVector<int> indices;
+  QVector<float> weights;
+  int numControlVerts;
+
+  friend class StencilTableBuilder;
+};
+
+#endif  // STENCIL_TABLE_H
@@ -0,0 +1,214 @@
+#include "stenciltablebuilder.h"
+
+#include <algorithm>
+
+#include "catmullclarksubdivider.h"
+
+/**
+ * @brief The StencilAccumulator class sums weighted stencils into a single
+ * stencil. Every control vertex that is touched gets a slot in the list of
+ * touched vertices, so that only those have to be visited when the stencil is
+ * written out.
+ */
+class StencilAccumulator {
+ public:
+  explicit StencilAccumulator(int numControlVerts)
+      : slots(numControlVerts, -1) {}
+
+  /**
+   * @brief add Adds a weighted stencil of a table to the sum.
+   * @param table The table holding the stencil.
+   * @param v The row of the stencil in the table.
+   * @param weight The weight to multiply the stencil by.
+   */
+  void add(const StencilTable& table, int v, double weight) {
+    const int* indices = table.stencilIndices(v);
+    const float* weights = table.stencilWeights(v);
+    for (int i = 0; i < table.stencilSize(v); i++) {
+      int c = indices[i];
+      if (slots[c] < 0) {
+        slots[c] = touched.size();
+        touched.append(c);
+        sums.append(0.0);
+      }
+      sums[slots[c]] += weight * weights[i];
+    }
+  }
+
+  /**
+   * @brief takeInto Appends the summed stencil to the index and weight arrays
+   * of a table, ordered by control vertex, and resets the sum.
+   * @param indices The control vertex indices of the table.
+   * @param weights The weights of the table.
+   */
+  void takeInto(QVector<int>& indices, QVector<float>& weights) {
+    std::sort(touched.begin(), touched.end());
+    for (int c : touched) {
+      indices.append(c);
+      weights.append(float(sums[slots[c]]));
+    }
+    for (int c : touched) {
+      slots[c] = -1;
+    }
+    touched.clear();
+    sums.clear();
+  }
+
+ private:
+  // Position of every control vertex in the touched list, or -1
+  QVector<int> slots;
+  QVector<int> touched;
+  QVector<double> sums;
+};
+
+/**
+ * @brief StencilTableBuilder::StencilTableBuilder Creates a new stencil table
+ * builder.
+ */
+StencilTableBuilder::StencilTableBuilder() {}
+
+/**
+ * @brief StencilTableBuilder::build Builds the stencil table of the vertices of
+ * a subdivision level. Only the topology of the control mesh is used, so the
+ * table remains valid for as long as the topology does not change.
+ * @param controlMesh The control mesh.
+ * @param level The subdivision level to build the stencils of.
+ * @param refinedMesh If provided, is set to the subdivided mesh at the
+ * requested level, whose topology belongs to the evaluated positions.
+ * @return The stencil of every vertex of the subdivision level.
+ */
+StencilTable StencilTableBuilder::build(const Mesh& controlMesh, int level,
+                                        Mesh* refinedMesh) const {
+    int numControlVerts = controlMesh.numVerts();
+    StencilTable stencils;
+    stencils.numControlVerts = numControlVerts;
+    stencils.offsets.resize(numControlVerts + 1);
+    stencils.indices.resize(numControlVerts);
+    stencils.weights.fill(1.0f, numControlVerts);
+    for (int v = 0; v <= numControlVerts; v++) {
+        stencils.offsets[v] = v;
+        if (v < numControlVerts) {
+            stencils.indices[v] = v;
+        }
+    }
+
+    CatmullClarkSubdivider subdivider;
+    Mesh mesh = controlMesh;
+    for (int k = 0; k < level; k++) {
+        mesh.buildAdjacency();
+        stencils = refine(mesh, stencils);
+        if (k + 1 < level || refinedMesh != nullptr) {
+            Mesh newMesh;
+            subdivider.subdivide(mesh, newMesh);
+            mesh = std::move(newMesh);
+        }
+    }
+    if (refinedMesh != nullptr) {
+        *refinedMesh = std::move(mesh);
+    }
+    return stencils;
+}
+
+/**
+ * @brief StencilTableBuilder::refine Computes the stencils of the vertices of
+ * the next subdivision level from those of the current level. Uses the rules
+ * of CatmullClarkSubdivider::facePoint, edgePoint, boundaryEdgePoint,
+ * vertexPoint and boundaryVertexPoint, expanded into weights:
+ * face point: 1/n for every corner of the face,
+ * edge point: 1/4 for both endpoints and both adjacent face points,
+ * boundary edge point: 1/2 for both endpoints,
+ * vertex point: (n - 2)/n for the vertex and 1/n^2 for every neighbour and
+ * every adjacent face point,
+ * boundary vertex point: 3/4 for the vertex and 1/8 for both boundary
+ * neighbours.
+ * @param mesh The mesh of the current level, of which the adjacency has been
+ * built.
+ * @param stencils The stencils of the vertices of the current level.
+ * @return The stencils of the vertices of the next level.
+ */
+StencilTable StencilTableBuilder::refine(const Mesh& mesh,
+                                         const StencilTable& stencils) const {
+    int numVerts = mesh.numVerts();
+    int numFaces = mesh.numFaces();
+    int numEdges = mesh.numEdges();
+    const VertexAdjacency* adjacency = mesh.getAdjacency();
+    StencilAccumulator accumulator(stencils.numControlVerts);
+
+    // The face points are needed by the edge and vertex points, which come
+    // before them in the new mesh, so they are computed first.
+    StencilTable facePoints;
+    facePoints.numControlVerts = stencils.numControlVerts;
+    facePoints.offsets.reserve(numFaces + 1);
+    for (int f = 0; f < numFaces; f++) {
+        int valence = mesh.faceValence(f);
+        int h = mesh.sideIdx(f);
+        for (int i = 0; i < valence; i++) {
+            accumulator.add(stencils, mesh.originIdx(h), 1.0 / valence);
+            h = mesh.nextIdx(h);
+        }
+        accumulator.takeInto(facePoints.indices, facePoints.weights);
+        facePoints.offsets.append(facePoints.indices.size());
+    }
+
+    StencilTable result;
+    result.numControlVerts = stencils.numControlVerts;
+    result.offsets.reserve(numVerts + numFaces + numEdges + 1);
+    auto appendStencil = [&]() {
+        accumulator.takeInto(result.indices, result.weights);
+        result.offsets.append(result.indices.size());
+    };
+
+    // Vertex points
+    for (int v = 0; v < numVerts; v++) {
+        int n = adjacency->numFaces(v);
+        if (adjacency->isBoundary(v)) {
+            accumulator.add(stencils, v, 0.75);
+            accumulator.add(stencils, adjacency->nextBoundaryNeighbor(v), 0.125);
+            accumulator.add(stencils, adjacency->prevBoundaryNeighbor(v), 0.125);
+        } else if (n > 0) {
+            const int* neighbors = adjacency->neighbors(v);
+            const int* faces = adjacency->faces(v);
+            double ringWeight = 1.0 / (double(n) * n);
+            accumulator.add(stencils, v, double(n - 2) / n);
+            for (int i = 0; i < n; i++) {
+                accumulator.add(stencils, neighbors[i], ringWeight);
+                accumulator.add(facePoints, faces[i], ringWeight);
+            }
+        } else {
+            // Vertices without faces are not moved
+            accumulator.add(stencils, v, 1.0);
+        }
+        appendStencil();
+    }
+
+    // Face points
+    for (int f = 0; f < numFaces; f++) {
+        accumulator.add(facePoints, f, 1.0);
+        appendStencil();
+    }
+
+    // Edge points, ordered by the index of their edge
+    QVector<int> edgeHalfEdges(numEdges);
+    for (int h = 0; h < mesh.numHalfEdges(); h++) {
+        if (h > mesh.twinIdx(h)) {
+            edgeHalfEdges[mesh.edgeIdx(h)] = h;
+        }
+    }
+    for (int e = 0; e < numEdges; e++) {
+        int h = edgeHalfEdges[e];
+        int twin = mesh.twinIdx(h);
+        int origin = mesh.originIdx(h);
+        int target = mesh.originIdx(mesh.nextIdx(h));
+        if (twin < 0) {
+            accumulator.add(stencils, origin, 0.5);
+            accumulator.add(stencils, target, 0.5);
+        } else {
+            accumulator.add(stencils, origin, 0.25);
+            accumulator.add(stencils, target, 0.25);
+            accumulator.add(facePoints, mesh.faceIdx(h), 0.25);
+            accumulator.add(facePoints, mesh.faceIdx(twin), 0.25);
+        }
+        appendStencil();
+    }
+    return result;
+}
@@ -0,0 +1,25 @@
+#ifndef STENCIL_TABLE_BUILDER_H
+#define STENCIL_TABLE_BUILDER_H
+
+#include "mesh/mesh.h"
+#include "stenciltable.h"
+
+/**
+ * @brief The StencilTableBuilder class builds the stencil table that maps the
+ * vertices of a control mesh to the vertices of one of its subdivision levels.
+ * The stencils of every level are combined from the stencils of the previous
+ * level using the same Catmull-Clark rules as the CatmullClarkSubdivider, so
+ * the refined vertices are numbered like those of the subdivider in its
+ * canonical layout.
+ */
+class StencilTableBuilder {
+ public:
+  StencilTableBuilder();
+  StencilTable build(const Mesh& controlMesh, int level,
+                     Mesh* refinedMesh = nullptr) const;
+
+ private:
+  StencilTable refine(const Mesh& mesh, const StencilTable& stencils) const;
+};
+
+#endif  // STENCIL_TABLE_BUILDER_H
@@ -0,0 +1,614 @@
+#include "tiledsubdivider.h"
+
+#include <algorithm>
+
+#include "catmullclarksubdivider.h"
+#include "levelrefiner.h"
+#include "util/parallel.h"
+
+// Number of control faces a thread takes from the shared range at a time
+#define TILE_GRAIN_SIZE 64
+
+/*
+ * Two values give the same sum in either order, so the points below add the
+ * corners of a quad and the ring of a regular vertex as two pairs of opposite
+ * elements. Rotating or mirroring the ring only swaps elements within a pair or
+ * swaps the pairs. Rings of other sizes are added in sorted order.
+ */
+
+/**
+ * @brief quadFacePoint Computes the face point of a quad.
+ * @param a, b, c, d The corners of the quad, in order around the quad.
+ * @return The face point.
+ */
+static inline QVector3D quadFacePoint(const QVector3D& a, const QVector3D& b,
+                                      const QVector3D& c, const QVector3D& d) {
+    return ((a + c) + (b + d)) * 0.25f;
+}
+
+/**
+ * @brief edgePoint Computes the edge point of an interior edge.
+ * @param p0, p1 The end points of the edge.
+ * @param f0, f1 The face points of the faces on either side of the edge.
+ * @return The edge point.
+ */
+static inline QVector3D edgePoint(const QVector3D& p0, const QVector3D& p1,
+                                  const QVector3D& f0, const QVector3D& f1) {
+    return ((p0 + p1) * 0.5f + (f0 + f1) * 0.5f) * 0.5f;
+}
+
+/**
+ * @brief boundaryEdgePoint Computes the edge point of a boundary edge, which is
+ * its midpoint.
+ * @param p0, p1 The end points of the edge.
+ * @return The edge point.
+ */
+static inline QVector3D boundaryEdgePoint(const QVector3D& p0,
+                                          const QVector3D& p1) {
+    return (p0 + p1) * 0.5f;
+}
+
+/**
+ * @brief boundaryVertexPoint Computes the vertex point of a boundary vertex
+ * from its two neighbours along the boundary.
+ * @param s The vertex.
+ * @param a, b The neighbours along the boundary.
+ * @return The vertex point.
+ */
+static inline QVector3D boundaryVertexPoint(const QVector3D& s,
+                                            const QVector3D& a,
+                                            const QVector3D& b) {
+    return (s * 2.0f + ((s + a) * 0.5f + (s + b) * 0.5f)) * 0.25f;
+}
+
+/**
+ * @brief regularVertexPoint Computes the vertex point of an interior vertex of
+ * valence 4.
+ * @param s The vertex.
+ * @param n The neighbours, in ring order.
+ * @param f The face points of the faces around the vertex, in ring order.
+ * @return The vertex point.
+ */
+static inline QVector3D regularVertexPoint(const QVector3D& s,
+                                           const QVector3D* n,
+                                           const QVector3D* f) {
+    QVector3D r = ((s + n[0]) * 0.5f + (s + n[2]) * 0.5f) +
+                  ((s + n[1]) * 0.5f + (s + n[3]) * 0.5f);
+    QVector3D q = (f[0] + f[2]) + (f[1] + f[3]);
+    // (Q + 2R + S(n - 3)) / n, where Q and R are averages over the ring
+    return (q * 0.25f + 2.0f * (r * 0.25f) + s) * 0.25f;
+}
+
+/**
+ * @brief sortedSum Adds up terms per coordinate in ascending order, which
+ * gives the same sum for any order of the terms.
+ * @param terms The terms.
+ * @param count The number of terms, at least 1.
+ * @param scratch Buffer for the sorted coordinates.
+ * @return The sum.
+ */
+static QVector3D sortedSum(const QVector3D* terms, int count,
+                           QVector<float>& scratch) {
+    scratch.resize(count);
+    float* values = scratch.data();
+    QVector3D sum;
+    for (int axis = 0; axis < 3; axis++) {
+        for (int i = 0; i < count; i++) {
+            values[i] = terms[i][axis];
+        }
+        std::sort(values, values + count);
+        float total = values[0];
+        for (int i = 1; i < count; i++) {
+            total += values[i];
+        }
+        sum[axis] = total;
+    }
+    return sum;
+}
+
+/**
+ * @brief The CornerRing struct holds the ring of a corner of a tile. The ring
+ * is stored like the VertexAdjacency does: the i-th face lies between the
+ * i-th and the next neighbour, and the ring of a boundary vertex runs from one
+ * boundary neighbour to the other. For every face, the corner opposite the
+ * vertex is kept.
+ */
+struct CornerRing {
+  // The corner in units of the size of the tile, and the grid directions
+  // towards the next and the previous corner of the tile
+  int cornerX, cornerY;
+  int nextX, nextY;
+  int prevX, prevY;
+
+  int valence;
+  bool boundary;
+  // The face of the ring that is the tile
+  int tileFace;
+  QVector<QVector3D> neighbors;
+  QVector<QVector3D> diagonals;
+
+  inline bool isRegular() const { return !boundary && valence == 4; }
+
+  /**
+   * @brief neighborAt Finds a neighbour relative to the tile.
+   * @param offset The number of steps from the neighbour towards the next
+   * corner of the tile.
+   * @return The index of the neighbour, or -1 if the ring does not extend that
+   * far.
+   */
+  inline int neighborAt(int offset) const {
+    int i = tileFace + offset;
+    if (boundary) {
+      return i >= 0 && i <= valence ? i : -1;
+    }
+    return (i % valence + valence) % valence;
+  }
+
+  /**
+   * @brief faceAt Finds a face relative to the tile.
+   * @param offset The number of steps from the tile.
+   * @return The index of the face, or -1 if the ring does not extend that far.
+   */
+  inline int faceAt(int offset) const {
+    int i = tileFace + offset;
+    if (boundary) {
+      return i >= 0 && i < valence ? i : -1;
+    }
+    return (i % valence + valence) % valence;
+  }
+};
+
+/**
+ * @brief The QuadTile class refines a quad of the first subdivision level on a
+ * grid of points. At size n, the grid holds the (n + 1)^2 points of the quad
+ * and one ring of points around them, with the first corner of the quad at
+ * grid position (0, 0) and the second one at (n, 0). Points outside the quad
+ * that lie across a boundary side of the quad are left out. Corners that are
+ * not regular keep their ring next to the grid, since the grid has no room for
+ * more or fewer than four faces around a point.
+ */
+class QuadTile {
+ public:
+  QuadTile() : size(0), dim(0) {}
+
+  void gather(const Mesh& mesh, const VertexAdjacency& adjacency, int face);
+  void refine();
+  void scatter(const Mesh& mesh, int face, int depth, Mesh& result);
+
+ private:
+  inline int gridIdx(int x, int y) const { return (y + 1) * dim + x + 1; }
+
+  void refineCorner(CornerRing& corner, QVector3D* newPoints, int newDim);
+  void mapFace(int face, int depth, int x, int y, int ax, int ay, int bx,
+               int by, int s, const Mesh& result);
+
+  // The number of faces along a side of the tile, and along a side of the grid
+  // including the surrounding ring
+  int size;
+  int dim;
+  // Whether the sides starting at each corner are boundary edges
+  bool boundarySides[4];
+  CornerRing corners[4];
+  QVector<QVector3D> points;
+  QVector<QVector3D> newPoints;
+  // The vertex of the final level at every point of the tile
+  QVector<int> vertexIndices;
+
+  QVector<QVector3D> ringScratch;
+  QVector<float> sortScratch;
+};
+
+/**
+ * @brief QuadTile::gather Copies a quad of the first subdivision level and the
+ * rings of its corners into a grid of size 1.
+ * @param mesh The first subdivision level.
+ * @param adjacency The vertex adjacency of the mesh.
+ * @param face The quad.
+ */
+void QuadTile::gather(const Mesh& mesh, const VertexAdjacency& adjacency,
+                      int face) {
+    // The corners of the quad and the directions towards their next and
+    // previous corners
+    static const int frames[4][6] = {{0, 0, 1, 0, 0, 1},
+                                     {1, 0, 0, 1, -1, 0},
+                                     {1, 1, -1, 0, 0, -1},
+                                     {0, 1, 0, -1, 1, 0}};
+    size = 1;
+    dim = 4;
+    points.fill(QVector3D(), dim * dim);
+
+    for (int k = 0; k < 4; k++) {
+        CornerRing& corner = corners[k];
+        corner.cornerX = frames[k][0];
+        corner.cornerY = frames[k][1];
+        corner.nextX = frames[k][2];
+        corner.nextY = frames[k][3];
+        corner.prevX = frames[k][4];
+        corner.prevY = frames[k][5];
+
+        int h = 4 * face + k;
+        int v = mesh.originIdx(h);
+        int nextCorner = mesh.originIdx(mesh.nextIdx(h));
+        const int* neighbors = adjacency.neighbors(v);
+        const int* faces = adjacency.faces(v);
+        corner.valence = adjacency.numFaces(v);
+        corner.boundary = adjacency.isBoundary(v);
+        corner.tileFace = 0;
+        corner.neighbors.resize(adjacency.numNeighbors(v));
+        corner.diagonals.resize(corner.valence);
+        for (int i = 0; i < adjacency.numNeighbors(v); i++) {
+            corner.neighbors[i] = mesh.position(neighbors[i]);
+        }
+        for (int i = 0; i < corner.valence; i++) {
+            int f = faces[i];
+            if (f == face && neighbors[i] == nextCorner) {
+                corner.tileFace = i;
+            }
+            // The corner of the quad opposite the vertex
+            int j = 0;
+            while (j < 3 && mesh.originIdx(4 * f + j) != v) {
+                j++;
+            }
+            corner.diagonals[i] =
+                mesh.position(mesh.originIdx(4 * f + ((j + 2) & 3)));
+        }
+    }
+
+    for (int k = 0; k < 4; k++) {
+        const CornerRing& corner = corners[k];
+        boundarySides[k] = corner.boundary && corner.tileFace == 0;
+
+        // Every point of the grid is a neighbour or a diagonal of a corner
+        int x = corner.cornerX;
+        int y = corner.cornerY;
+        int ux = corner.nextX;
+        int uy = corner.nextY;
+        int wx = corner.prevX;
+        int wy = corner.prevY;
+        points[gridIdx(x, y)] = mesh.position(mesh.originIdx(4 * face + k));
+        int i = corner.neighborAt(0);
+        points[gridIdx(x + ux, y + uy)] = corner.neighbors[i];
+        i = corner.neighborAt(1);
+        points[gridIdx(x + wx, y + wy)] = corner.neighbors[i];
+        i = corner.faceAt(0);
+        points[gridIdx(x + ux + wx, y + uy + wy)] = corner.diagonals[i];
+        if ((i = corner.faceAt(1)) >= 0) {
+            points[gridIdx(x - ux + wx, y - uy + wy)] = corner.diagonals[i];
+        }
+        if ((i = corner.neighborAt(2)) >= 0) {
+            points[gridIdx(x - ux, y - uy)] = corner.neighbors[i];
+        }
+        if (corner.isRegular()) {
+            i = corner.faceAt(2);
+            points[gridIdx(x - ux - wx, y - uy - wy)] = corner.diagonals[i];
+        }
+        if ((i = corner.neighborAt(-1)) >= 0) {
+            points[gridIdx(x - wx, y - wy)] = corner.neighbors[i];
+        }
+        if ((i = corner.faceAt(-1)) >= 0) {
+            points[gridIdx(x + ux - wx, y + uy - wy)] = corner.diagonals[i];
+        }
+    }
+}
+
+/**
+ * @brief QuadTile::refine Subdivides the tile once, doubling its size. The
+ * face points are computed first, then the edge points and finally the vertex
+ * points. Irregular corners are refined from their rings afterwards, and
+ * overwrite the grid points that depend on faces the grid does not hold.
+ */
+void QuadTile::refine() {
+    int n = size;
+    int newSize = 2 * n;
+    int newDim = newSize + 3;
+    newPoints.resize(newDim * newDim);
+    const QVector3D* p = points.constData();
+    QVector3D* q = newPoints.data();
+    auto at = [&](int x, int y) -> const QVector3D& {
+        return p[(y + 1) * dim + x + 1];
+    };
+    auto newIdx = [&](int x, int y) { return (y + 1) * newDim + x + 1; };
+
+    // The range of faces of the grid
+    int firstX = boundarySides[3] ? 0 : -1;
+    int lastX = boundarySides[1] ? n - 1 : n;
+    int firstY = boundarySides[0] ? 0 : -1;
+    int lastY = boundarySides[2] ? n - 1 : n;
+
+    for (int y = firstY; y <= lastY; y++) {
+        for (int x = firstX; x <= lastX; x++) {
+            q[newIdx(2 * x + 1, 2 * y + 1)] =
+                quadFacePoint(at(x, y), at(x + 1, y), at(x + 1, y + 1),
+                              at(x, y + 1));
+        }
+    }
+
+    for (int y = 0; y <= n; y++) {
+        bool boundary =
+            (y == 0 && boundarySides[0]) || (y == n && boundarySides[2]);
+        for (int x = firstX; x <= lastX; x++) {
+            q[newIdx(2 * x + 1, 2 * y)] =
+                boundary ? boundaryEdgePoint(at(x, y), at(x + 1, y))
+                         : edgePoint(at(x, y), at(x + 1, y),
+                                     q[newIdx(2 * x + 1, 2 * y + 1)],
+                                     q[newIdx(2 * x + 1, 2 * y - 1)]);
+        }
+    }
+    for (int y = firstY; y <= lastY; y++) {
+        for (int x = 0; x <= n; x++) {
+            bool boundary =
+                (x == 0 && boundarySides[3]) || (x == n && boundarySides[1]);
+            q[newIdx(2 * x, 2 * y + 1)] =
+                boundary ? boundaryEdgePoint(at(x, y), at(x, y + 1))
+                         : edgePoint(at(x, y), at(x, y + 1),
+                                     q[newIdx(2 * x + 1, 2 * y + 1)],
+                                     q[newIdx(2 * x - 1, 2 * y + 1)]);
+        }
+    }
+
+    for (int y = 0; y <= n; y++) {
+        bool alongX =
+            (y == 0 && boundarySides[0]) || (y == n && boundarySides[2]);
+        for (int x = 0; x <= n; x++) {
+            bool alongY =
+                (x == 0 && boundarySides[3]) || (x == n && boundarySides[1]);
+            if ((x == 0 || x == n) && (y == 0 || y == n)) {
+                int k = y == 0 ? (x == 0 ? 0 : 1) : (x == 0 ? 3 : 2);
+                if (!corners[k].isRegular()) {
+                    continue;
+                }
+            }
+            const QVector3D& s = at(x, y);
+            QVector3D& result = q[newIdx(2 * x, 2 * y)];
+            if (alongX) {
+                result = boundaryVertexPoint(s, at(x - 1, y), at(x + 1, y));
+            } else if (alongY) {
+                result = boundaryVertexPoint(s, at(x, y - 1), at(x, y + 1));
+            } else {
+                QVector3D ring[4] = {at(x + 1, y), at(x, y + 1), at(x - 1, y),
+                                     at(x, y - 1)};
+                QVector3D faces[4] = {q[newIdx(2 * x + 1, 2 * y + 1)],
+                                      q[newIdx(2 * x - 1, 2 * y + 1)],
+                                      q[newIdx(2 * x - 1, 2 * y - 1)],
+                                      q[newIdx(2 * x + 1, 2 * y - 1)]};
+                result = regularVertexPoint(s, ring, faces);
+            }
+        }
+    }
+
+    for (int k = 0; k < 4; k++) {
+        if (!corners[k].isRegular()) {
+            refineCorner(corners[k], q, newDim);
+        }
+    }
+
+    points.swap(newPoints);
+    size = newSize;
+    dim = newDim;
+}
+
+/**
+ * @brief QuadTile::refineCorner Subdivides the ring of an irregular corner and
+ * stores the corner and its two neighbours away from the tile in the new grid.
+ * The grid cannot compute these, as they depend on the faces of the ring that
+ * do not fit in the grid.
+ * @param corner The corner.
+ * @param newPoints The grid of the next size.
+ * @param newDim The dimension of the grid of the next size.
+ */
+void QuadTile::refineCorner(CornerRing& corner, QVector3D* newPoints,
+                            int newDim) {
+    int valence = corner.valence;
+    int numNeighbors = corner.neighbors.size();
+    const QVector3D s =
+        points[gridIdx(corner.cornerX * size, corner.cornerY * size)];
+    QVector3D* neighbors = corner.neighbors.data();
+    QVector3D* diagonals = corner.diagonals.data();
+
+    for (int i = 0; i < valence; i++) {
+        diagonals[i] = quadFacePoint(s, neighbors[i], diagonals[i],
+                                     neighbors[(i + 1) % numNeighbors]);
+    }
+
+    QVector3D vertexPoint;
+    if (corner.boundary) {
+        vertexPoint = boundaryVertexPoint(s, neighbors[0], neighbors[valence]);
+    } else {
+        ringScratch.resize(valence);
+        for (int i = 0; i < valence; i++) {
+            ringScratch[i] = (s + neighbors[i]) * 0.5f;
+        }
+        QVector3D r = sortedSum(ringScratch.constData(), valence, sortScratch);
+        QVector3D q = sortedSum(diagonals, valence, sortScratch);
+        float n = valence;
+        vertexPoint = (q / n + 2.0f * (r / n) + s * (n - 3.0f)) / n;
+    }
+
+    for (int i = 0; i < numNeighbors; i++) {
+        if (corner.boundary && (i == 0 || i == valence)) {
+            neighbors[i] = boundaryEdgePoint(s, neighbors[i]);
+        } else {
+            neighbors[i] = edgePoint(s, neighbors[i],
+                                     diagonals[(i + valence - 1) % valence],
+                                     diagonals[i]);
+        }
+    }
+
+    int x = 2 * corner.cornerX * size;
+    int y = 2 * corner.cornerY * size;
+    newPoints[(y + 1) * newDim + x + 1] = vertexPoint;
+    int i = corner.neighborAt(2);
+    if (i >= 0) {
+        newPoints[(y - corner.nextY + 1) * newDim + x - corner.nextX + 1] =
+            neighbors[i];
+    }
+    i = corner.neighborAt(-1);
+    if (i >= 0) {
+        newPoints[(y - corner.prevY + 1) * newDim + x - corner.prevX + 1] =
+            neighbors[i];
+    }
+}
+
+/**
+ * @brief QuadTile::scatter Writes the points of the tile into the mesh of the
+ * final level. Points on a side of the tile are written by the tile holding
+ * the side half-edge with the highest index, and corners by the tile holding
+ * their outgoing half-edge, so that tiles refined in parallel never write the
+ * same vertex.
+ * @param mesh The first subdivision level.
+ * @param face The quad of the first subdivision level.
+ * @param depth The number of times the tile was refined.
+ * @param result The mesh of the final level, of which the topology is set.
+ */
+void QuadTile::scatter(const Mesh& mesh, int face, int depth, Mesh& result) {
+    int n = size;
+    vertexIndices.resize((n + 1) * (n + 1));
+    mapFace(face, depth, 0, 0, 1, 0, 0, 1, n, result);
+
+    bool ownsSide[4];
+    bool ownsCorner[4];
+    for (int k = 0; k < 4; k++) {
+        int h = 4 * face + k;
+        ownsSide[k] = h > mesh.twinIdx(h);
+        ownsCorner[k] = mesh.outIdx(mesh.originIdx(h)) == h;
+    }
+
+    VertexPositions& positions = result.getPositions();
+    for (int y = 0; y <= n; y++) {
+        for (int x = 0; x <= n; x++) {
+            bool owned = true;
+            if ((x == 0 || x == n) && (y == 0 || y == n)) {
+                owned =
+                    ownsCorner[y == 0 ? (x == 0 ? 0 : 1) : (x == 0 ? 3 : 2)];
+            } else if (y == 0) {
+                owned = ownsSide[0];
+            } else if (x == n) {
+                owned = ownsSide[1];
+            } else if (y == n) {
+                owned = ownsSide[2];
+            } else if (x == 0) {
+                owned = ownsSide[3];
+            }
+            if (owned) {
+                positions.set(vertexIndices[y * (n + 1) + x],
+                              points[gridIdx(x, y)]);
+            }
+        }
+    }
+}
+
+/**
+ * @brief QuadTile::mapFace Looks up the vertices of the final level at the
+ * corners of a face of the tile. The children of half-edge h are half-edges
+ * 4h up to 4h + 3, so the faces of the next level within face f are faces 4f
+ * up to 4f + 3, and face 4f + i has corner i of face f as its first corner.
+ * @param face The face.
+ * @param depth The number of levels between the face and the final level.
+ * @param x, y The grid position of the first corner of the face.
+ * @param ax, ay The grid direction towards the second corner.
+ * @param bx, by The grid direction towards the last corner.
+ * @param s The number of grid steps along a side of the face.
+ * @param result The mesh of the final level.
+ */
+void QuadTile::mapFace(int face, int depth, int x, int y, int ax, int ay,
+                       int bx, int by, int s, const Mesh& result) {
+    int cornerX[4] = {x, x + s * ax, x + s * (ax + bx), x + s * bx};
+    int cornerY[4] = {y, y + s * ay, y + s * (ay + by), y + s * by};
+    if (depth == 0) {
+        for (int i = 0; i < 4; i++) {
+            vertexIndices[cornerY[i] * (size + 1) + cornerX[i]] =
+                result.originIdx(4 * face + i);
+        }
+        return;
+    }
+    for (int i = 0; i < 4; i++) {
+        int next = (i + 1) & 3;
+        int prev = (i + 3) & 3;
+        mapFace(4 * face + i, depth - 1, cornerX[i], cornerY[i],
+                (cornerX[next] - cornerX[i]) / s,
+                (cornerY[next] - cornerY[i]) / s,
+                (cornerX[prev] - cornerX[i]) / s,
+                (cornerY[prev] - cornerY[i]) / s, s / 2, result);
+    }
+}
+
+/**
+ * @brief TiledSubdivider::TiledSubdivider Initializes a tiled subdivider.
+ * @param numThreads The number of threads the control faces are divided over.
+ * The result does not depend on the number of threads.
+ */
+TiledSubdivider::TiledSubdivider(int numThreads) : numThreads(numThreads) {}
+
+/**
+ * @brief TiledSubdivider::subdivide Subdivides a control mesh to a
+ * subdivision level.
+ * @param controlMesh The control mesh.
+ * @param level The number of subdivision steps.
+ * @return The mesh at the requested level.
+ */
+Mesh TiledSubdivider::subdivide(Mesh& controlMesh, int level) const {
+    Mesh result;
+    subdivide(controlMesh, level, result);
+    return result;
+}
+
+/**
+ * @brief TiledSubdivider::subdivide Subdivides a control mesh to a
+ * subdivision level into an existing mesh, replacing its contents. The
+ * vertices and half-edges are laid out like those of the CatmullClarkSubdivider
+ * in its canonical layout.
+ * @param controlMesh The control mesh.
+ * @param level The number of subdivision steps.
+ * @param result The mesh to store the result in.
+ */
+void TiledSubdivider::subdivide(Mesh& controlMesh, int level,
+                                Mesh& result) const {
+    if (level <= 0) {
+        result = controlMesh;
+        return;
+    }
+    CatmullClarkSubdivider subdivider(
+        CatmullClarkSubdivider::VertexLayout::Canonical, numThreads);
+    if (level == 1) {
+        subdivider.subdivide(controlMesh, result);
+        return;
+    }
+
+    Mesh firstLevel;
+    subdivider.subdivide(controlMesh, firstLevel);
+    firstLevel.buildAdjacency();
+    const VertexAdjacency& adjacency = *firstLevel.getAdjacency();
+
+    int depth = level - 1;
+    LevelRefiner refiner(numThreads);
+    refiner.refineTopology(firstLevel, depth, result);
+    VertexPositions& positions = result.getPositions();
+    positions.resize(result.numVerts());
+    // Vertices that are not part of any face stay in place
+    for (int v = 0; v < result.numVerts(); v++) {
+        if (result.outIdx(v) < 0) {
+            positions.set(v, v < firstLevel.numVerts() ? firstLevel.position(v)
+                                                        : QVector3D());
+        }
+    }
+
+    // The quads of the first level are numbered by the control half-edge they
+    // were created for
+    parallelForStealing(
+        0, controlMesh.numFaces(), TILE_GRAIN_SIZE,
+        [&](int first, int last) {
+            QuadTile tile;
+            for (int f = first; f < last; f++) {
+                int h = controlMesh.sideIdx(f);
+                for (int i = 0; i < controlMesh.faceValence(f); i++) {
+                    tile.gather(firstLevel, adjacency, h);
+                    for (int k = 0; k < depth; k++) {
+                        tile.refine();
+                    }
+                    tile.scatter(firstLevel, h, depth, result);
+                    h = controlMesh.nextIdx(h);
+                }
+            }
+        },
+        numThreads);
+}
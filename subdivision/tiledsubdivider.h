@@ -0,0 +1,38 @@
+#ifndef TILED_SUBDIVIDER_H
+#define TILED_SUBDIVIDER_H
+
+#include "mesh/mesh.h"
+
+/**
+ * @brief The TiledSubdivider class subdivides a control mesh to a single
+ * subdivision level one control face at a time, instead of sweeping over the
+ * whole mesh once per level.
+ *
+ * The first subdivision step splits every control face of valence n into n
+ * quads, and is done by the CatmullClarkSubdivider. Every such quad is then
+ * refined on its own as a tile: the quad and the one-ring of faces around it
+ * are gathered into a dense grid of (2^k + 3)^2 points, which is refined level
+ * by level in a scratch buffer of the thread until the quad is a grid of
+ * (2^k + 1)^2 points. The grid only keeps one ring of faces around the quad at
+ * every level, which is all the next level needs. Corners that are not regular
+ * keep their full ring next to the grid. The tiles of a control face are
+ * refined by the same thread, and the refined points are written into a mesh
+ * of which the topology is generated by the LevelRefiner.
+ *
+ * The points shared by neighbouring tiles are computed by each of them. To get
+ * the same bits in every tile, the face, edge and vertex points add up their
+ * terms in an order that does not depend on where the ring of a vertex or the
+ * corners of a face start. The results may therefore differ from those of the
+ * CatmullClarkSubdivider in the last bits.
+ */
+class TiledSubdivider {
+ public:
+  TiledSubdivider(int numThreads = 1);
+  Mesh subdivide(Mesh& controlMesh, int level) const;
+  void subdivide(Mesh& controlMesh, int level, Mesh& result) const;
+
+ private:
+  int numThreads;
+};
+
+#endif  // TILED_SUBDIVIDER_H
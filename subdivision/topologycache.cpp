@@ -0,0 +1,107 @@
+#include "topologycache.h"
+
+/**
+ * @brief RefinedTopology::memoryUsage Retrieves the amount of memory held by
+ * the topology.
+ * @return The number of bytes allocated by the vectors.
+ */
+qint64 RefinedTopology::memoryUsage() const {
+    return vertices.capacity() * qint64(sizeof(Vertex)) +
+           halfEdges.capacity() * qint64(sizeof(HalfEdge)) +
+           (canonicalVertices.capacity() + layoutVertices.capacity()) *
+               qint64(sizeof(int));
+}
+
+/**
+ * @brief TopologyCache::TopologyCache Creates an empty cache.
+ * @param maxBytes The amount of memory the cached topologies may hold.
+ */
+TopologyCache::TopologyCache(qint64 maxBytes) : maxBytes(maxBytes) {}
+
+/**
+ * @brief TopologyCache::find Looks up the topology of a subdivision step. The
+ * sizes of the mesh are compared as well, which guards against most
+ * fingerprint collisions. Every lookup counts as a hit or a miss.
+ * @param key The refinement key of the mesh that is subdivided.
+ * @param numVerts The number of vertices of that mesh.
+ * @param numHalfEdges The number of half-edges of that mesh.
+ * @param numFaces The number of faces of that mesh.
+ * @return The cached topology, or nullptr if there is none.
+ */
+const RefinedTopology* TopologyCache::find(quint64 key, int numVerts,
+                                           int numHalfEdges, int numFaces) {
+    auto entry = entries.constFind(key);
+    if (entry == entries.constEnd() || entry->numVerts != numVerts ||
+        entry->numHalfEdges != numHalfEdges || entry->numFaces != numFaces) {
+        misses++;
+        return nullptr;
+    }
+    hits++;
+    return &entry.value();
+}
+
+/**
+ * @brief TopologyCache::insert Stores the topology of a subdivision step,
+ * dropping the oldest entries until the cache fits in its memory limit.
+ * Topologies that do not fit on their own are not stored.
+ * @param key The refinement key of the mesh that was subdivided.
+ * @param topology The topology of the subdivided mesh. Should not share its
+ * data with a mesh.
+ */
+void TopologyCache::insert(quint64 key, const RefinedTopology& topology) {
+    qint64 topologyBytes = topology.memoryUsage();
+    if (topologyBytes > maxBytes) {
+        return;
+    }
+    auto entry = entries.constFind(key);
+    if (entry != entries.constEnd()) {
+        numBytes -= entry->memoryUsage();
+    } else {
+        insertionOrder.append(key);
+    }
+    entries.insert(key, topology);
+    numBytes += topologyBytes;
+    while (numBytes > maxBytes) {
+        quint64 oldest = insertionOrder.takeFirst();
+        numBytes -= entries.value(oldest).memoryUsage();
+        entries.remove(oldest);
+    }
+}
+
+/**
+ * @brief TopologyCache::clear Removes all entries. The hit and miss counts are
+ * kept.
+ */
+void TopologyCache::clear() {
+    entries.clear();
+    insertionOrder.clear();
+    numBytes = 0;
+}
+
+/**
+ * @brief TopologyCache::refinementKey Derives the key of a subdivision step
+ * from the topology fingerprint of the mesh that is subdivided. The key also
+ * serves as the fingerprint of the subdivided mesh, since that mesh is fully
+ * determined by it.
+ * @param fingerprint The topology fingerprint of the mesh.
+ * @param layout The vertex layout of the subdivided mesh.
+ * @return The key, which is never zero.
+ */
+quint64 TopologyCache::refinementKey(quint64 fingerprint, int layout) {
+    // The finalizer of SplitMix64, which spreads every input bit over the key
+    quint64 key = fingerprint + 0x9e3779b97f4a7c15ULL * quint64(layout + 1);
+    key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return key == 0 ? 1 : key;
+}
+
+/**
+ * @brief TopologyCache::hitRate Retrieves the fraction of lookups that found
+ * a cached topology.
+ * @return The hit rate, or 0 if nothing has been looked up yet.
+ */
+float TopologyCache::hitRate() const {
+    int lookups = hits + misses;
+    return lookups == 0 ? 0.0f : float(hits) / lookups;
+}
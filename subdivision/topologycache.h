@@ -0,0 +1,65 @@
+#ifndef TOPOLOGY_CACHE_H
+#define TOPOLOGY_CACHE_H
+
+#include <QHash>
+#include <QVector>
+
+#include "mesh/halfedge.h"
+#include "mesh/vertex.h"
+
+/**
+ * @brief The RefinedTopology struct holds the topology of a subdivided mesh,
+ * together with the sizes of the mesh it was subdivided from.
+ */
+struct RefinedTopology {
+  int numVerts = 0;
+  int numHalfEdges = 0;
+  int numFaces = 0;
+
+  QVector<Vertex> vertices;
+  QVector<HalfEdge> halfEdges;
+  // Only used by face-major levels
+  QVector<int> canonicalVertices;
+  QVector<int> layoutVertices;
+
+  qint64 memoryUsage() const;
+};
+
+/**
+ * @brief The TopologyCache class keeps the topology of subdivided meshes, so
+ * that subdividing a mesh with the same connectivity again only has to compute
+ * the positions. Entries are keyed by the topology fingerprint of the mesh
+ * that was subdivided and the vertex layout. The fingerprint of a subdivided
+ * mesh follows from its key, so only the control mesh is ever hashed.
+ *
+ * The cache keeps its own copies of the topology, so that the meshes it is
+ * copied into can keep reusing their buffers. The oldest entries are dropped
+ * once the cache holds more memory than its limit.
+ */
+class TopologyCache {
+ public:
+  TopologyCache(qint64 maxBytes = 256 * 1024 * 1024);
+
+  const RefinedTopology* find(quint64 key, int numVerts, int numHalfEdges,
+                              int numFaces);
+  void insert(quint64 key, const RefinedTopology& topology);
+  void clear();
+
+  static quint64 refinementKey(quint64 fingerprint, int layout);
+
+  inline int numHits() const { return hits; }
+  inline int numMisses() const { return misses; }
+  float hitRate() const;
+  inline qint64 memoryUsage() const { return numBytes; }
+
+ private:
+  QHash<quint64, RefinedTopology> entries;
+  // The keys in the order in which they were inserted
+  QVector<quint64> insertionOrder;
+  qint64 maxBytes;
+  qint64 numBytes = 0;
+  int hits = 0;
+  int misses = 0;
+};
+
+#endif  // TOPOLOGY_CACHE_H
@@ -0,0 +1,601 @@
+#include "benchmark.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QPair>
+#include <QTextStream>
+#include <QThread>
+#include <algorithm>
+#include <random>
+
+#include "initialization/meshinitializer.h"
+#include "initialization/meshreorderer.h"
+#include "initialization/objfile.h"
+#include "subdivision/adaptivesubdivider.h"
+#include "subdivision/catmullclarksubdivider.h"
+#include "subdivision/levelrefiner.h"
+#include "subdivision/refinementdepthselector.h"
+#include "subdivision/stenciltablebuilder.h"
+#include "subdivision/tiledsubdivider.h"
+#include "subdivision/topologycache.h"
+
+/**
+ * @brief writeGridOBJ Writes a closed quad mesh to an .obj file. The mesh is a
+ * torus of n x n quads, so every edge has a twin and every vertex has valence
+ * 4.
+ * @param fileName Path of the .obj file to write.
+ * @param n Number of quads along either direction of the torus.
+ * @param shuffle Whether to list the vertices and faces in random order, like
+ * some exported scans do.
+ */
+static void writeGridOBJ(const QString& fileName, int n, bool shuffle = false) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return;
+    }
+    // Vertex (i, j) is written at position vertexOrder[i * n + j]
+    QVector<int> vertexOrder(n * n);
+    QVector<int> faceOrder(n * n);
+    for (int k = 0; k < n * n; k++) {
+        vertexOrder[k] = k;
+        faceOrder[k] = k;
+    }
+    if (shuffle) {
+        std::mt19937 generator(n);
+        std::shuffle(vertexOrder.begin(), vertexOrder.end(), generator);
+        std::shuffle(faceOrder.begin(), faceOrder.end(), generator);
+    }
+    QVector<int> vertexAt(n * n);
+    for (int k = 0; k < n * n; k++) {
+        vertexAt[vertexOrder[k]] = k;
+    }
+
+    QTextStream out(&file);
+    for (int k = 0; k < n * n; k++) {
+        int i = vertexAt[k] / n;
+        int j = vertexAt[k] % n;
+        out << "v " << i << " " << j << " " << (i * j) % 7 << "\n";
+    }
+    for (int k = 0; k < n * n; k++) {
+        int i = faceOrder[k] / n;
+        int j = faceOrder[k] % n;
+        int v0 = vertexOrder[i * n + j];
+        int v1 = vertexOrder[((i + 1) % n) * n + j];
+        int v2 = vertexOrder[((i + 1) % n) * n + (j + 1) % n];
+        int v3 = vertexOrder[i * n + (j + 1) % n];
+        // OBJ starts indexing from 1
+        out << "f " << v0 + 1 << " " << v1 + 1 << " " << v2 + 1 << " "
+            << v3 + 1 << "\n";
+    }
+}
+
+/**
+ * @brief benchmarkTwinMatching Measures how the construction of the half-edge
+ * mesh scales with the number of faces. The time per half-edge should stay
+ * roughly constant when the edge matching runs in linear time.
+ */
+void benchmarkTwinMatching() {
+    qDebug() << ":: Benchmarking half-edge construction";
+    QString fileName = QDir::tempPath() + "/catmark_benchmark_grid.obj";
+    for (int n = 64; n <= 1024; n *= 2) {
+        writeGridOBJ(fileName, n);
+        OBJFile grid(fileName);
+        if (!grid.loadedSuccessfully()) {
+            qDebug() << " * Could not write" << fileName;
+            break;
+        }
+
+        MeshInitializer meshInitializer;
+        QElapsedTimer timer;
+        timer.start();
+        Mesh mesh = meshInitializer.constructHalfEdgeMesh(grid);
+        qint64 nsecs = timer.nsecsElapsed();
+
+        qDebug() << " * Faces =" << mesh.numFaces()
+                 << "Time (ms) =" << nsecs / 1000000.0
+                 << "ns / half-edge =" << double(nsecs) / mesh.numHalfEdges();
+
+        int numThreads = QThread::idealThreadCount();
+        MeshInitializer parallelInitializer(numThreads);
+        timer.restart();
+        mesh = parallelInitializer.constructHalfEdgeMesh(grid);
+        nsecs = timer.nsecsElapsed();
+
+        qDebug() << "   Threads =" << numThreads
+                 << "Time (ms) =" << nsecs / 1000000.0
+                 << "ns / half-edge =" << double(nsecs) / mesh.numHalfEdges();
+    }
+    QFile::remove(fileName);
+}
+
+/**
+ * @brief timeSubdivision Measures how long it takes to subdivide a mesh the way
+ * the application does. The fastest of a few runs is reported.
+ * @param mesh The control mesh.
+ * @param steps The number of subdivision steps.
+ * @return The time in nanoseconds to subdivide the mesh.
+ */
+static qint64 timeSubdivision(const Mesh& mesh, int steps) {
+    qint64 fastest = -1;
+    for (int run = 0; run < 3; run++) {
+        Mesh level = mesh;
+        CatmullClarkSubdivider subdivider;
+        QElapsedTimer timer;
+        timer.start();
+        for (int k = 0; k < steps; k++) {
+            level.buildAdjacency();
+            Mesh newLevel;
+            subdivider.subdivide(level, newLevel);
+            level = std::move(newLevel);
+        }
+        qint64 nsecs = timer.nsecsElapsed();
+        if (fastest < 0 || nsecs < fastest) {
+            fastest = nsecs;
+        }
+    }
+    return fastest;
+}
+
+/**
+ * @brief loadBundledModels Loads the models bundled with the application and
+ * constructs their half-edge meshes. Models that fail to load are skipped.
+ * @return The file name and control mesh of every bundled model.
+ */
+static QVector<QPair<QString, Mesh>> loadBundledModels() {
+    QVector<QPair<QString, Mesh>> meshes;
+    QDir models(":/models");
+    for (const QString& entry : models.entryList({"*.obj"}, QDir::Files)) {
+        OBJFile model(models.filePath(entry));
+        if (!model.loadedSuccessfully()) {
+            continue;
+        }
+        MeshInitializer meshInitializer;
+        meshes.append({entry, meshInitializer.constructHalfEdgeMesh(model)});
+    }
+    return meshes;
+}
+
+/**
+ * @brief benchmarkReorderedModel Compares the time to subdivide a model in file
+ * order with the time to subdivide it after reordering it for cache locality.
+ * @param name Name of the model to report.
+ * @param mesh The control mesh of the model.
+ * @param steps The number of subdivision steps.
+ */
+static void benchmarkReorderedModel(const QString& name, const Mesh& mesh,
+                                    int steps) {
+    MeshReorderer meshReorderer;
+    MeshPermutation permutation;
+    QElapsedTimer timer;
+    timer.start();
+    Mesh reordered = meshReorderer.reorder(mesh, permutation);
+    qint64 reorderNsecs = timer.nsecsElapsed();
+
+    qint64 fileOrderNsecs = timeSubdivision(mesh, steps);
+    qint64 reorderedNsecs = timeSubdivision(reordered, steps);
+    qDebug() << " *" << name << "Faces =" << mesh.numFaces()
+             << "Reordering (ms) =" << reorderNsecs / 1000000.0
+             << "Subdivision (ms) =" << fileOrderNsecs / 1000000.0 << "->"
+             << reorderedNsecs / 1000000.0
+             << "Speedup =" << double(fileOrderNsecs) / reorderedNsecs;
+}
+
+/**
+ * @brief benchmarkReordering Measures the effect of reordering control meshes
+ * for cache locality on the subdivision of the bundled models. The bundled
+ * models are small and mostly ordered well already, so a large grid in random
+ * order is included as well.
+ */
+void benchmarkReordering() {
+    qDebug() << ":: Benchmarking cache-locality reordering";
+    for (const QPair<QString, Mesh>& model : loadBundledModels()) {
+        benchmarkReorderedModel(model.first, model.second, 3);
+    }
+
+    QString fileName = QDir::tempPath() + "/catmark_benchmark_shuffled.obj";
+    writeGridOBJ(fileName, 512, true);
+    OBJFile grid(fileName);
+    if (grid.loadedSuccessfully()) {
+        MeshInitializer meshInitializer;
+        benchmarkReorderedModel("Shuffled grid",
+                                meshInitializer.constructHalfEdgeMesh(grid), 2);
+    } else {
+        qDebug() << " * Could not write" << fileName;
+    }
+    QFile::remove(fileName);
+}
+
+/**
+ * @brief benchmarkStencilTables Compares re-evaluating a subdivision level of
+ * every bundled model through a stencil table with subdividing it again. Only
+ * evaluating the table has to be repeated when the control positions change;
+ * building it is a one-time cost.
+ */
+void benchmarkStencilTables() {
+    qDebug() << ":: Benchmarking stencil tables";
+    const int level = 3;
+    for (const QPair<QString, Mesh>& model : loadBundledModels()) {
+        const QString& entry = model.first;
+        const Mesh& mesh = model.second;
+
+        StencilTableBuilder builder;
+        QElapsedTimer timer;
+        timer.start();
+        StencilTable table = builder.build(mesh, level);
+        qint64 buildNsecs = timer.nsecsElapsed();
+
+        VertexPositions positions;
+        timer.restart();
+        table.evaluate(mesh.getPositions(), positions);
+        qint64 evaluateNsecs = timer.nsecsElapsed();
+
+        qint64 subdivideNsecs = timeSubdivision(mesh, level);
+        qDebug() << " *" << entry << "Vertices =" << table.numVertices()
+                 << "Weights / vertex ="
+                 << double(table.numWeights()) / table.numVertices()
+                 << "Build (ms) =" << buildNsecs / 1000000.0
+                 << "Evaluate (ms) =" << evaluateNsecs / 1000000.0
+                 << "Subdivide (ms) =" << subdivideNsecs / 1000000.0;
+    }
+}
+
+/**
+ * @brief benchmarkRefinementKernels Compares the refinement kernels of every
+ * instruction set the processor supports on a subdivision step of every
+ * bundled model. The kernels only handle quad meshes, so the models are
+ * subdivided twice first.
+ */
+void benchmarkRefinementKernels() {
+    qDebug() << ":: Benchmarking refinement kernels, best instruction set ="
+             << simdIsaName(detectSimdIsa());
+    const SimdIsa isas[] = {SimdIsa::Scalar, SimdIsa::SSE42, SimdIsa::AVX2,
+                            SimdIsa::AVX512};
+    for (QPair<QString, Mesh>& model : loadBundledModels()) {
+        const QString& entry = model.first;
+        Mesh& mesh = model.second;
+        CatmullClarkSubdivider subdivider;
+        for (int k = 0; k < 2; k++) {
+            mesh = subdivider.subdivide(mesh);
+        }
+        mesh.buildAdjacency();
+
+        qint64 scalarNsecs = -1;
+        for (SimdIsa isa : isas) {
+            if (!subdivider.setSimdIsa(isa)) {
+                continue;
+            }
+            qint64 fastest = -1;
+            Mesh newMesh;
+            for (int run = 0; run < 5; run++) {
+                QElapsedTimer timer;
+                timer.start();
+                subdivider.subdivide(mesh, newMesh);
+                qint64 nsecs = timer.nsecsElapsed();
+                if (fastest < 0 || nsecs < fastest) {
+                    fastest = nsecs;
+                }
+            }
+            if (isa == SimdIsa::Scalar) {
+                scalarNsecs = fastest;
+            }
+            qDebug() << " *" << entry << simdIsaName(isa)
+                     << "Time (ms) =" << fastest / 1000000.0
+                     << "Speedup =" << double(scalarNsecs) / fastest;
+        }
+    }
+}
+
+/**
+ * @brief benchmarkDirectRefinement Compares subdividing every bundled model to
+ * a single level with the level refiner against subdividing it level by level
+ * while keeping every level, as the application does. The memory of the
+ * levels is the memory allocated by the meshes themselves.
+ */
+void benchmarkDirectRefinement() {
+    qDebug() << ":: Benchmarking direct refinement";
+    const int level = 4;
+    for (const QPair<QString, Mesh>& model : loadBundledModels()) {
+        const QString& entry = model.first;
+        const Mesh& mesh = model.second;
+
+        QElapsedTimer timer;
+        timer.start();
+        QVector<Mesh> levels = {mesh};
+        CatmullClarkSubdivider subdivider;
+        for (int k = 0; k < level; k++) {
+            levels[k].buildAdjacency();
+            Mesh newMesh;
+            subdivider.subdivide(levels[k], newMesh);
+            levels.append(std::move(newMesh));
+        }
+        qint64 levelsNsecs = timer.nsecsElapsed();
+        qint64 levelsMemory = 0;
+        for (int k = 1; k <= level; k++) {
+            levelsMemory += levels[k].memoryUsage();
+        }
+        levels.clear();
+
+        LevelRefiner refiner;
+        timer.restart();
+        Mesh refined = refiner.refine(mesh, level);
+        qint64 directNsecs = timer.nsecsElapsed();
+
+        qDebug() << " *" << entry << "Level by level (ms) ="
+                 << levelsNsecs / 1000000.0 << "Direct (ms) ="
+                 << directNsecs / 1000000.0 << "Levels (MB) ="
+                 << levelsMemory / (1024.0 * 1024.0) << "Final level (MB) ="
+                 << refined.memoryUsage() / (1024.0 * 1024.0);
+    }
+}
+
+/**
+ * @brief benchmarkTiledSubdivision Compares subdividing every bundled model to
+ * a deep level with the tiled subdivider against subdividing it level by
+ * level, as the application does. Also reports the largest distance between
+ * the vertices of both results, which only differ by rounding.
+ */
+void benchmarkTiledSubdivision() {
+    qDebug() << ":: Benchmarking tiled subdivision";
+    const int level = 5;
+    for (QPair<QString, Mesh>& model : loadBundledModels()) {
+        const QString& entry = model.first;
+        Mesh& mesh = model.second;
+
+        QElapsedTimer timer;
+        timer.start();
+        QVector<Mesh> levels = {mesh};
+        CatmullClarkSubdivider subdivider;
+        for (int k = 0; k < level; k++) {
+            levels[k].buildAdjacency();
+            Mesh newMesh;
+            subdivider.subdivide(levels[k], newMesh);
+            levels.append(std::move(newMesh));
+        }
+        qint64 levelsNsecs = timer.nsecsElapsed();
+        Mesh reference = levels[level];
+        levels.clear();
+
+        TiledSubdivider tiledSubdivider;
+        timer.restart();
+        Mesh tiled = tiledSubdivider.subdivide(mesh, level);
+        qint64 tiledNsecs = timer.nsecsElapsed();
+
+        float maxDistance = 0.0f;
+        for (int v = 0; v < reference.numVerts(); v++) {
+            QVector3D difference = tiled.position(v) - reference.position(v);
+            maxDistance = qMax(maxDistance, difference.length());
+        }
+        qDebug() << " *" << entry << "Level by level (ms) ="
+                 << levelsNsecs / 1000000.0 << "Tiled (ms) ="
+                 << tiledNsecs / 1000000.0 << "Max distance =" << maxDistance;
+    }
+}
+
+/**
+ * @brief benchmarkAdaptiveSubdivision Compares subdividing every bundled model
+ * adaptively against subdividing it uniformly to the same level. Reports the
+ * number of points each of them produces, along with the number of patches and
+ * irregular quads of the adaptive result.
+ */
+void benchmarkAdaptiveSubdivision() {
+    qDebug() << ":: Benchmarking adaptive subdivision";
+    const int level = 4;
+    for (const QPair<QString, Mesh>& model : loadBundledModels()) {
+        const QString& entry = model.first;
+        const Mesh& mesh = model.second;
+        int uniformVerts =
+            LevelRefiner::levelSizes(mesh, level).last().numVerts;
+
+        QElapsedTimer timer;
+        timer.start();
+        QVector<Mesh> levels = {mesh};
+        CatmullClarkSubdivider subdivider;
+        for (int k = 0; k < level; k++) {
+            levels[k].buildAdjacency();
+            Mesh newMesh;
+            subdivider.subdivide(levels[k], newMesh);
+            levels.append(std::move(newMesh));
+        }
+        qint64 uniformNsecs = timer.nsecsElapsed();
+        levels.clear();
+
+        AdaptiveSubdivider adaptiveSubdivider;
+        timer.restart();
+        AdaptivePatches patches = adaptiveSubdivider.subdivide(mesh, level);
+        qint64 adaptiveNsecs = timer.nsecsElapsed();
+
+        qDebug() << " *" << entry << "Uniform points =" << uniformVerts
+                 << "Adaptive points =" << patches.points.size()
+                 << "Patches =" << patches.numPatches()
+                 << "Irregular quads =" << patches.numIrregularQuads()
+                 << "Uniform (ms) =" << uniformNsecs / 1000000.0
+                 << "Adaptive (ms) =" << adaptiveNsecs / 1000000.0;
+    }
+}
+
+/**
+ * @brief benchmarkAdaptiveRefinement Refines every bundled model adaptively,
+ * as seen by the default camera of the application, and compares the number of
+ * faces against uniform subdivision to the same maximum level. The first run
+ * meets a tolerance of one pixel; the second fits a face budget.
+ */
+void benchmarkAdaptiveRefinement() {
+    qDebug() << ":: Benchmarking adaptive refinement";
+    RefinementCriteria criteria;
+    criteria.maxLevel = 5;
+    criteria.viewDependent = true;
+    criteria.modelViewMatrix.translate(QVector3D(0.0, 0.0, -3.0));
+    criteria.projectionMatrix.perspective(80.0f, 16.0f / 9.0f, 0.1f, 40.0f);
+    criteria.viewportHeight = 1080;
+    const int faceBudget = 10000;
+
+    for (const QPair<QString, Mesh>& model : loadBundledModels()) {
+        const QString& entry = model.first;
+        const Mesh& mesh = model.second;
+        int uniformFaces =
+            LevelRefiner::levelSizes(mesh, criteria.maxLevel).last().numFaces;
+
+        RefinementDepthSelector depthSelector;
+        AdaptiveSubdivider adaptiveSubdivider;
+        criteria.tolerance = 1.0f;
+        criteria.faceBudget = 0;
+        QElapsedTimer timer;
+        timer.start();
+        Mesh refined = adaptiveSubdivider.refine(
+            mesh, depthSelector.selectDepths(mesh, criteria));
+        qint64 toleranceNsecs = timer.nsecsElapsed();
+
+        criteria.tolerance = 0.0f;
+        criteria.faceBudget = faceBudget;
+        timer.restart();
+        Mesh budgeted = adaptiveSubdivider.refine(
+            mesh, depthSelector.selectDepths(mesh, criteria));
+        qint64 budgetNsecs = timer.nsecsElapsed();
+
+        qDebug() << " *" << entry << "Uniform faces =" << uniformFaces
+                 << "1 pixel faces =" << refined.numFaces() << "in (ms)"
+                 << toleranceNsecs / 1000000.0 << "Budget faces ="
+                 << budgeted.numFaces() << "in (ms)"
+                 << budgetNsecs / 1000000.0;
+    }
+}
+
+/**
+ * @brief benchmarkIncrementalUpdate Moves a single control vertex of every
+ * bundled model, and compares updating the subdivided levels in place against
+ * subdividing them again. Also counts the vertices of the deepest level in
+ * which both differ, which should be none.
+ */
+void benchmarkIncrementalUpdate() {
+    qDebug() << ":: Benchmarking incremental updates";
+    const int level = 4;
+    for (const QPair<QString, Mesh>& model : loadBundledModels()) {
+        const QString& entry = model.first;
+        const Mesh& mesh = model.second;
+        CatmullClarkSubdivider subdivider;
+        QVector<Mesh> levels = {mesh};
+        for (int k = 0; k < level; k++) {
+            levels[k].buildAdjacency();
+            Mesh newMesh;
+            subdivider.subdivide(levels[k], newMesh);
+            levels.append(std::move(newMesh));
+        }
+
+        int v = mesh.numVerts() / 2;
+        levels[0].getPositions().set(
+            v, levels[0].position(v) + QVector3D(0.01f, 0.01f, 0.01f));
+        QElapsedTimer timer;
+        timer.start();
+        subdivider.updateLevels(levels, {v});
+        qint64 updateNsecs = timer.nsecsElapsed();
+
+        timer.restart();
+        Mesh reference = levels[0];
+        for (int k = 0; k < level; k++) {
+            Mesh newMesh;
+            subdivider.subdivide(reference, newMesh);
+            reference = std::move(newMesh);
+            reference.buildAdjacency();
+        }
+        qint64 fullNsecs = timer.nsecsElapsed();
+
+        int mismatches = 0;
+        for (int w = 0; w < reference.numVerts(); w++) {
+            if (reference.position(w) != levels[level].position(w)) {
+                mismatches++;
+            }
+        }
+        qDebug() << " *" << entry << "Incremental (ms) ="
+                 << updateNsecs / 1000000.0 << "Full (ms) ="
+                 << fullNsecs / 1000000.0 << "Mismatches =" << mismatches;
+    }
+}
+
+/**
+ * @brief subdivideLevels Subdivides a mesh a number of times.
+ * @param subdivider The subdivider to use.
+ * @param mesh The control mesh.
+ * @param steps The number of subdivision steps.
+ * @return The mesh of the deepest level.
+ */
+static Mesh subdivideLevels(const CatmullClarkSubdivider& subdivider,
+                            const Mesh& mesh, int steps) {
+    Mesh result = mesh;
+    for (int k = 0; k < steps; k++) {
+        result.buildAdjacency();
+        Mesh newMesh;
+        subdivider.subdivide(result, newMesh);
+        result = std::move(newMesh);
+    }
+    return result;
+}
+
+/**
+ * @brief benchmarkTopologyReuse Subdivides every bundled model once to fill a
+ * topology cache, then moves all of its control vertices and compares
+ * subdividing it again with and without the cache. Also counts the vertices
+ * and half-edges of the deepest level in which both differ, which should be
+ * none.
+ */
+void benchmarkTopologyReuse() {
+    qDebug() << ":: Benchmarking topology reuse";
+    const int level = 4;
+    for (QPair<QString, Mesh>& model : loadBundledModels()) {
+        const QString& entry = model.first;
+        Mesh& mesh = model.second;
+        TopologyCache cache;
+        CatmullClarkSubdivider cachedSubdivider;
+        cachedSubdivider.setTopologyCache(&cache);
+        subdivideLevels(cachedSubdivider, mesh, level);
+
+        VertexPositions& positions = mesh.getPositions();
+        for (int v = 0; v < mesh.numVerts(); v++) {
+            positions.set(v, mesh.position(v) * 1.01f);
+        }
+        QElapsedTimer timer;
+        timer.start();
+        Mesh reference = subdivideLevels(CatmullClarkSubdivider(), mesh, level);
+        qint64 fullNsecs = timer.nsecsElapsed();
+        timer.restart();
+        Mesh cached = subdivideLevels(cachedSubdivider, mesh, level);
+        qint64 cachedNsecs = timer.nsecsElapsed();
+
+        int mismatches = 0;
+        for (int v = 0; v < reference.numVerts(); v++) {
+            if (reference.position(v) != cached.position(v) ||
+                reference.outIdx(v) != cached.outIdx(v)) {
+                mismatches++;
+            }
+        }
+        for (int h = 0; h < reference.numHalfEdges(); h++) {
+            if (reference.originIdx(h) != cached.originIdx(h) ||
+                reference.twinIdx(h) != cached.twinIdx(h) ||
+                reference.edgeIdx(h) != cached.edgeIdx(h)) {
+                mismatches++;
+            }
+        }
+        qDebug() << " *" << entry << "Full (ms) =" << fullNsecs / 1000000.0
+                 << "Cached topology (ms) =" << cachedNsecs / 1000000.0
+                 << "Hit rate =" << cache.hitRate()
+                 << "Mismatches =" << mismatches;
+    }
+}
+
+/**
+ * @brief runBenchmarks Runs all the benchmarks. Invoked by starting the
+ * application with the --benchmark argument.
+ */
+void runBenchmarks() {
+    benchmarkTwinMatching();
+    benchmarkReordering();
+    benchmarkStencilTables();
+    benchmarkRefinementKernels();
+    benchmarkDirectRefinement();
+    benchmarkTiledSubdivision();
+    benchmarkAdaptiveSubdivision();
+    benchmarkAdaptiveRefinement();
+    benchmarkIncrementalUpdate();
+    benchmarkTopologyReuse();
+}
@@ -0,0 +1,16 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+void runBenchmarks();
+void benchmarkTwinMatching();
+void benchmarkReordering();
+void benchmarkStencilTables();
+void benchmarkRefinementKernels();
+void benchmarkDirectRefinement();
+void benchmarkTiledSubdivision();
+void benchmarkAdaptiveSubdivision();
+void benchmarkAdaptiveRefinement();
+void benchmarkIncrementalUpdate();
+void benchmarkTopologyReuse();
+
+#endif  // BENCHMARK_H
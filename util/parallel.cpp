@@ -0,0 +1,193 @@
+#include "parallel.h"
+
+#include <QtGlobal>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief parallelFor Splits the range [begin, end) into contiguous blocks of
+ * (almost) equal size and invokes the body once per block, each on its own
+ * thread. The calling thread processes the first block and returns once all
+ * blocks are done.
+ * @param begin Start of the range.
+ * @param end End of the range (exclusive).
+ * @param body Function invoked with the start and end of a block.
+ * @param numThreads The maximum number of threads to use.
+ */
+void parallelFor(int begin, int end,
+                 const std::function<void(int, int)>& body, int numThreads) {
+    int count = end - begin;
+    if (count <= 0) {
+        return;
+    }
+    numThreads = qBound(1, numThreads, count);
+
+    std::vector<std::thread> workers;
+    workers.reserve(numThreads - 1);
+    for (int t = 1; t < numThreads; t++) {
+        int blockBegin = begin + int(qint64(count) * t / numThreads);
+        int blockEnd = begin + int(qint64(count) * (t + 1) / numThreads);
+        workers.emplace_back(body, blockBegin, blockEnd);
+    }
+    body(begin, begin + int(qint64(count) / numThreads));
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+/**
+ * @brief popFront Takes the first chunk from a range of chunks. The range is
+ * packed into a single value, with its start in the lower 32 bits and its end
+ * in the upper 32 bits, so that it can be updated atomically.
+ * @param range The range to take the chunk from.
+ * @return The index of the chunk, or -1 if the range is empty.
+ */
+static int popFront(std::atomic<quint64>& range) {
+    quint64 value = range.load();
+    quint32 front;
+    quint32 back;
+    do {
+        front = quint32(value);
+        back = quint32(value >> 32);
+        if (front >= back) {
+            return -1;
+        }
+    } while (!range.compare_exchange_weak(
+        value, (quint64(back) << 32) | (front + 1)));
+    return int(front);
+}
+
+/**
+ * @brief popBack Takes the last chunk from a range of chunks.
+ * @param range The range to take the chunk from. See popFront.
+ * @return The index of the chunk, or -1 if the range is empty.
+ */
+static int popBack(std::atomic<quint64>& range) {
+    quint64 value = range.load();
+    quint32 front;
+    quint32 back;
+    do {
+        front = quint32(value);
+        back = quint32(value >> 32);
+        if (front >= back) {
+            return -1;
+        }
+    } while (!range.compare_exchange_weak(
+        value, (quint64(back - 1) << 32) | front));
+    return int(back - 1);
+}
+
+/**
+ * @brief parallelForStealing Splits the range [begin, end) into chunks of
+ * grainSize elements and invokes the body once per chunk. Every thread starts
+ * with a contiguous share of the chunks, which it processes front to back.
+ * Threads that run out of work steal chunks from the back of the shares of the
+ * other threads, so that uneven work per element does not leave threads idle.
+ * The calling thread takes part and returns once all chunks are done.
+ * @param begin Start of the range.
+ * @param end End of the range (exclusive).
+ * @param grainSize The number of elements per chunk.
+ * @param body Function invoked with the start and end of a chunk.
+ * @param numThreads The maximum number of threads to use.
+ */
+void parallelForStealing(int begin, int end, int grainSize,
+                         const std::function<void(int, int)>& body,
+                         int numThreads) {
+    int count = end - begin;
+    if (count <= 0) {
+        return;
+    }
+    grainSize = qMax(1, grainSize);
+    int numChunks = int((qint64(count) + grainSize - 1) / grainSize);
+    numThreads = qBound(1, numThreads, numChunks);
+    if (numThreads == 1) {
+        body(begin, end);
+        return;
+    }
+
+    std::vector<std::atomic<quint64>> shares(numThreads);
+    for (int t = 0; t < numThreads; t++) {
+        quint64 first = quint64(qint64(numChunks) * t / numThreads);
+        quint64 last = quint64(qint64(numChunks) * (t + 1) / numThreads);
+        shares[t].store((last << 32) | first);
+    }
+
+    auto runChunk = [&](int chunk) {
+        int chunkBegin = begin + int(qint64(chunk) * grainSize);
+        body(chunkBegin, qMin(end, chunkBegin + grainSize));
+    };
+    auto work = [&](int t) {
+        int chunk;
+        while ((chunk = popFront(shares[t])) >= 0) {
+            runChunk(chunk);
+        }
+        for (int i = 1; i < numThreads; i++) {
+            std::atomic<quint64>& victim = shares[(t + i) % numThreads];
+            while ((chunk = popBack(victim)) >= 0) {
+                runChunk(chunk);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(numThreads - 1);
+    for (int t = 1; t < numThreads; t++) {
+        workers.emplace_back(work, t);
+    }
+    work(0);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+/**
+ * @brief parallelExclusiveScan Replaces every value by the sum of all values
+ * before it. The range is split into blocks that are summed concurrently,
+ * after which every block is scanned concurrently starting from the sum of the
+ * blocks before it.
+ * @param values The values to scan.
+ * @param count The number of values.
+ * @param numThreads The maximum number of threads to use.
+ * @return The sum of all values.
+ */
+int parallelExclusiveScan(int* values, int count, int numThreads) {
+    if (count <= 0) {
+        return 0;
+    }
+    int numBlocks = qBound(1, numThreads, count);
+    std::vector<int> blockSums(numBlocks + 1, 0);
+    auto blockBegin = [&](int b) {
+        return int(qint64(count) * b / numBlocks);
+    };
+
+    parallelFor(
+        0, numBlocks,
+        [&](int first, int last) {
+            for (int b = first; b < last; b++) {
+                int sum = 0;
+                for (int i = blockBegin(b); i < blockBegin(b + 1); i++) {
+                    sum += values[i];
+                }
+                blockSums[b + 1] = sum;
+            }
+        },
+        numBlocks);
+    for (int b = 1; b <= numBlocks; b++) {
+        blockSums[b] += blockSums[b - 1];
+    }
+    parallelFor(
+        0, numBlocks,
+        [&](int first, int last) {
+            for (int b = first; b < last; b++) {
+                int sum = blockSums[b];
+                for (int i = blockBegin(b); i < blockBegin(b + 1); i++) {
+                    int value = values[i];
+                    values[i] = sum;
+                    sum += value;
+                }
+            }
+        },
+        numBlocks);
+    return blockSums[numBlocks];
+}
@@ -0,0 +1,71 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <QVector>
+#include <algorithm>
+#include <functional>
+
+void parallelFor(int begin, int end,
+                 const std::function<void(int, int)>& body, int numThreads);
+void parallelForStealing(int begin, int end, int grainSize,
+                         const std::function<void(int, int)>& body,
+                         int numThreads);
+int parallelExclusiveScan(int* values, int count, int numThreads);
+
+/**
+ * @brief parallelSort Sorts the values. Contiguous blocks are sorted
+ * concurrently, after which they are merged pairwise, again concurrently.
+ * @param values The values to sort.
+ * @param less Comparison function defining a strict weak ordering.
+ * @param numThreads The maximum number of threads to use.
+ */
+template <typename T, typename Compare>
+void parallelSort(QVector<T>& values, Compare less, int numThreads) {
+  int count = values.size();
+  // Blocks smaller than this are not worth the merging
+  int numBlocks = qBound(1, numThreads, qMax(1, count / 4096));
+  if (numBlocks == 1) {
+    std::sort(values.begin(), values.end(), less);
+    return;
+  }
+
+  QVector<int> bounds(numBlocks + 1);
+  for (int b = 0; b <= numBlocks; b++) {
+    bounds[b] = int(qint64(count) * b / numBlocks);
+  }
+  QVector<T> buffer(count);
+  T* source = values.data();
+  T* target = buffer.data();
+
+  parallelFor(
+      0, numBlocks,
+      [&](int first, int last) {
+        for (int b = first; b < last; b++) {
+          std::sort(source + bounds[b], source + bounds[b + 1], less);
+        }
+      },
+      numBlocks);
+
+  for (int width = 1; width < numBlocks; width *= 2) {
+    int numMerges = (numBlocks + 2 * width - 1) / (2 * width);
+    parallelFor(
+        0, numMerges,
+        [&](int first, int last) {
+          for (int m = first; m < last; m++) {
+            int lo = bounds[2 * m * width];
+            int mid = bounds[qMin(2 * m * width + width, numBlocks)];
+            int hi = bounds[qMin(2 * m * width + 2 * width, numBlocks)];
+            std::merge(source + lo, source + mid, source + mid, source + hi,
+                       target + lo, less);
+          }
+        },
+        numMerges);
+    std::swap(source, target);
+  }
+
+  if (source != values.constData()) {
+    values.swap(buffer);
+  }
+}
+
+#endif  // PARALLEL_H